@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+
+# Decoder for EXI trace dumps written by the KunaiLoader menu
+# (the raw stream received from a USB Gecko, saved to a file)
+
+import struct
+import sys
+
+MAGIC = 0x45585452
+
+OPS = ["lock", "unlock", "select", "deselect", "read", "write", "dma_read", "dma_write"]
+SPEEDS = ["1MHz", "2MHz", "4MHz", "8MHz", "16MHz", "32MHz"]
+
+# first byte written after selecting the CPLD/flash
+COMMANDS = {
+    0x02: "PAGE_PROG",
+    0x03: "READ_DATA",
+    0x04: "WRITE_DISABLE",
+    0x05: "READ_STAT1",
+    0x06: "WRITE_ENABLE",
+    0x0B: "READ_FAST",
+    0x20: "ERASE_4K",
+    0x4B: "READ_UNIQUE_ID",
+    0x52: "ERASE_32K",
+    0x60: "CHIP_ERASE",
+    0x80: "PASSTHROUGH",
+    0x90: "READ_MAN_DEV_ID",
+    0x9F: "READ_JEDEC_ID",
+    0xC0: "CPLD_CONTROL",
+    0xC7: "CHIP_ERASE",
+    0xD8: "ERASE_64K",
+}
+
+def parse(data):
+    magic, version, entry_size, count, tb_clock = struct.unpack(">IHHII", data[:16])
+    if magic != MAGIC:
+        raise ValueError("not an EXI trace dump")
+    if version != 1 or entry_size != 16:
+        raise ValueError(f"unsupported dump version {version}, entry size {entry_size}")
+
+    entries = []
+    last = None
+    base = 0
+    for i in range(count):
+        tb, chan, dev, speed, op, length, result, payload = \
+            struct.unpack(">IBBBBHhI", data[16 + i * 16:32 + i * 16])
+        # the timebase is stored as its lower 32 bits, unwrap it
+        if last is not None and tb < last:
+            base += 1 << 32
+        last = tb
+        entries.append({
+            "t": (base + tb) / tb_clock,
+            "chan": chan, "dev": dev, "speed": speed, "op": op,
+            "len": length, "result": result, "data": payload,
+        })
+    return entries
+
+def transactions(entries):
+    # group everything between select and deselect on the same channel
+    open_tx = {}
+    for e in entries:
+        name = OPS[e["op"]] if e["op"] < len(OPS) else "?"
+        if name == "select":
+            open_tx[e["chan"]] = {"start": e["t"], "cmd": None, "passthrough": False,
+                                  "bytes": 0, "errors": 0}
+            continue
+        tx = open_tx.get(e["chan"])
+        if tx is None:
+            continue
+        if name in ("read", "write", "dma_read", "dma_write"):
+            if tx["cmd"] is None and name in ("write", "dma_write"):
+                cmd = e["data"] >> 24
+                # the CPLD passthrough header is followed by the real flash command
+                if cmd == 0x80 and e["len"] == 4 and not tx["passthrough"]:
+                    tx["passthrough"] = True
+                else:
+                    tx["cmd"] = cmd
+            tx["bytes"] += e["len"]
+            if e["result"] <= 0:
+                tx["errors"] += 1
+        elif name == "deselect":
+            tx["end"] = e["t"]
+            del open_tx[e["chan"]]
+            yield tx
+
+def main():
+    if len(sys.argv) != 2:
+        print(f"Usage: {sys.argv[0]} <exitrace.bin>")
+        return -1
+
+    with open(sys.argv[1], "rb") as f:
+        entries = parse(f.read())
+
+    if not entries:
+        print("Trace is empty")
+        return 0
+
+    t0 = entries[0]["t"]
+    print("Timeline:")
+    for e in entries:
+        op = OPS[e["op"]] if e["op"] < len(OPS) else f"op{e['op']}"
+        speed = SPEEDS[e["speed"]] if e["speed"] < len(SPEEDS) else "?"
+        line = f"{(e['t'] - t0) * 1e6:12.1f}us  ch{e['chan']} dev{e['dev']} {speed:>5}  {op:<8}"
+        if op in ("read", "write", "dma_read", "dma_write"):
+            line += f" {e['len']:5}B  data=0x{e['data']:08X}"
+        line += f"  ret={e['result']}"
+        print(line)
+
+    stats = {}
+    for tx in transactions(entries):
+        cmd = tx["cmd"]
+        if cmd is None:
+            name = "PASSTHROUGH" if tx["passthrough"] else "none"
+        else:
+            name = COMMANDS.get(cmd, f"0x{cmd:02X}")
+        s = stats.setdefault(name, {"count": 0, "bytes": 0, "time": 0.0, "max": 0.0, "errors": 0})
+        duration = tx["end"] - tx["start"]
+        s["count"] += 1
+        s["bytes"] += tx["bytes"]
+        s["time"] += duration
+        s["max"] = max(s["max"], duration)
+        s["errors"] += tx["errors"]
+
+    print()
+    print(f"{'command':<16}{'count':>8}{'bytes':>10}{'total ms':>10}{'avg us':>10}{'max us':>10}{'errors':>8}")
+    for name, s in sorted(stats.items(), key=lambda kv: -kv[1]["time"]):
+        print(f"{name:<16}{s['count']:>8}{s['bytes']:>10}{s['time'] * 1e3:>10.2f}"
+              f"{s['time'] / s['count'] * 1e6:>10.1f}{s['max'] * 1e6:>10.1f}{s['errors']:>8}")
+
+if __name__ == "__main__":
+    sys.exit(main())
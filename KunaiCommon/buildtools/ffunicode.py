@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+
+# Emits FatFs' ffunicode.c for the single code page ffconf.h selects. The
+# conversion tables of the other code pages are dropped, and the up-case
+# table covering all of Unicode is replaced by one covering only the
+# characters of that code page, worked out from the full table so both
+# agree on every one of them. Anything else is returned unchanged by
+# ff_wtoupper(), which is enough for the ASCII paths the loaders look up.
+#
+# DBCS and dynamic (FF_CODE_PAGE 0) configurations are copied unchanged.
+
+import re
+import sys
+
+def config(ffconf):
+    values = {}
+    for line in ffconf.splitlines():
+        m = re.match(r"\s*#define\s+(FF_CODE_PAGE|FF_USE_LFN)\s+(\d+)", line)
+        if m:
+            values[m.group(1)] = int(m.group(2))
+    if len(values) != 2:
+        raise ValueError("FF_CODE_PAGE or FF_USE_LFN not found in ffconf.h")
+    return values
+
+def evaluate(expr, values):
+    # only the plain comparisons ffunicode.c uses on FF_CODE_PAGE
+    expr = expr.split("/*")[0].strip()
+    if not re.fullmatch(r"[\sA-Z_0-9=!<>|&]+", expr) or "FF_CODE_PAGE" not in expr:
+        return None
+    for name, value in values.items():
+        expr = expr.replace(name, str(value))
+    if re.search(r"[A-Z_]", expr):
+        return None
+    return eval(expr.replace("||", " or ").replace("&&", " and "))
+
+def trim(source, values):
+    out = []
+    stack = []		# None for blocks passed through, else whether the block is kept
+    for line in source.splitlines(keepends=True):
+        directive = line.strip()
+        keep = all(s is not False for s in stack)
+
+        if directive.startswith("#if"):
+            cond = evaluate(directive[3:], values) if directive.startswith("#if ") else None
+            stack.append(cond)
+            if cond is not None:
+                continue
+        elif directive.startswith(("#elif", "#else")):
+            if stack and stack[-1] is not None:
+                raise ValueError(f"unsupported directive in a code page block: {directive}")
+        elif directive.startswith("#endif"):
+            if stack.pop() is not None:
+                continue
+
+        if keep:
+            out.append(line)
+
+    if stack:
+        raise ValueError("unbalanced #if/#endif")
+    return "".join(out)
+
+def words(source, name):
+    m = re.search(r"static const (?:WORD|WCHAR) " + name + r"\[\] = \{(.*?)\};", source, re.S)
+    if not m:
+        raise ValueError(f"{name} not found in ffunicode.c")
+    body = re.sub(r"/\*.*?\*/", "", m.group(1), flags=re.S)
+    return [int(w, 16) for w in re.findall(r"0x[0-9A-Fa-f]+", body)]
+
+def wtoupper(uc, cvt1, cvt2):
+    # ff_wtoupper() of the full table, step by step
+    p = cvt1 if uc < 0x1000 else cvt2
+    i = 0
+    while True:
+        bc = p[i]
+        i += 1
+        if bc == 0 or uc < bc:
+            return uc
+        nc = p[i]
+        i += 1
+        cmd, nc = nc >> 8, nc & 0xFF
+        if uc < bc + nc:
+            if cmd == 0:
+                return p[i + uc - bc]
+            shift = { 1: (uc - bc) & 1, 2: 16, 3: 32, 4: 48, 5: 26, 6: -8, 7: 80, 8: 0x1C60 }
+            return (uc - shift[cmd]) & 0xFFFF
+        if cmd == 0:
+            i += nc
+
+UPPER_START = "/*------------------------------------------------------------------------*/\n/* Unicode up-case conversion"
+UPPER_END = "#endif /* #if FF_USE_LFN */"
+
+UPPER_FUNC = """/*------------------------------------------------------------------------*/
+@TITLE@
+/*------------------------------------------------------------------------*/
+/* Generated by ffunicode.py from the full table. Characters outside of
+/  CP@CP@ are returned unchanged. */
+
+DWORD ff_wtoupper (	/* Returns up-converted code point */
+	DWORD uni		/* Unicode code point to be up-converted */
+)
+{
+	static const WORD cvt[] = {	/* Lower case and upper case, by lower case */
+@ROWS@
+		0x0000	/* EOT */
+	};
+	const WORD *p;
+
+
+	if (uni >= 0x61 && uni <= 0x7A) return uni - 0x20;	/* Basic Latin */
+	for (p = cvt; *p && *p <= uni; p += 2) {
+		if (*p == uni) return p[1];
+	}
+
+	return uni;
+}
+
+
+"""
+
+def upcase(source, cp):
+    cvt1, cvt2 = words(source, "cvt1"), words(source, "cvt2")
+    chars = list(range(0x80)) + words(source, f"uc{cp}")
+    pairs = sorted({ (c, wtoupper(c, cvt1, cvt2)) for c in chars
+                     if not 0x61 <= c <= 0x7A and wtoupper(c, cvt1, cvt2) != c })
+
+    # a-z are not in the table, the function checks them first
+    for c in range(0x61, 0x7B):
+        if wtoupper(c, cvt1, cvt2) != c - 0x20:
+            raise ValueError("the full table doesn't map a-z to A-Z")
+
+    rows = []
+    for i in range(0, len(pairs), 4):
+        rows.append("\t\t" + " ".join(f"0x{lo:04X},0x{up:04X}," for lo, up in pairs[i:i + 4]))
+
+    title = f"/* Unicode up-case conversion, CP{cp} characters only".ljust(74) + "*/"
+    return (UPPER_FUNC.replace("@TITLE@", title).replace("@CP@", str(cp))
+            .replace("@ROWS@", "\n".join(rows))), len(pairs)
+
+def main():
+    if len(sys.argv) != 4:
+        print(f"Usage: {sys.argv[0]} <ffconf.h> <ffunicode.c.in> <output>")
+        return -1
+
+    with open(sys.argv[1], newline="") as f:
+        values = config(f.read())
+    with open(sys.argv[2], newline="") as f:
+        source = f.read()
+    cp = values["FF_CODE_PAGE"]
+
+    if not values["FF_USE_LFN"]:
+        # ffunicode.c is blanked without LFN anyway
+        out = '#include "ff.h"\n'
+        what = "no LFN, empty"
+    elif cp == 0 or cp >= 900:
+        out = source
+        what = "copied unchanged"
+    else:
+        # in the line endings of the vendored file
+        nl = "\r\n" if "\r\n" in source else "\n"
+        out = trim(source, values)
+        start, end = out.index(UPPER_START.replace("\n", nl)), out.index(UPPER_END)
+        table, count = upcase(source, cp)
+        out = out[:start] + table.replace("\n", nl) + out[end:]
+        what = f"{count} up-case pairs"
+
+    with open(sys.argv[3], "w", newline="") as f:
+        f.write(out)
+
+    print(f"CP{cp}, LFN {values['FF_USE_LFN']}: {source.count(chr(10))} -> "
+          f"{out.count(chr(10))} lines, {what}")
+
+if __name__ == "__main__":
+    sys.exit(main())
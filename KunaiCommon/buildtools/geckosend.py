@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+
+# Sends a file to the KunaiGC loaders over a USB Gecko with the framed
+# protocol (source/geckolink/geckolink.h). Frames are streamed ahead of the
+# acks up to the console's window, so the Gecko FIFO never runs dry, and
+# only frames the console reports missing are sent again. With --codec the
+# file is packed like kpack.py does and unpacked on the console as the
+# frames come in.
+
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import zlib
+
+import kpack
+
+PC_FRAMED = 0x82
+GC_READY = 0x88
+
+FRAME_MAGIC = b"KG"
+ACK_MAGIC = b"KA"
+XFER_MAGIC = 0x4B475458
+
+FRAME_DATA = 1
+FLAG_LAST = 0x01
+
+ACK_READY = 1
+ACK = 2
+NAK = 3
+ACK_SIZE = 20
+
+MODE_BOOT = 0
+MODE_INSTALL = 1
+
+# resend what isn't acked after this long without progress
+RESEND_TIMEOUT = 1.0
+# and give up after this long, the console stopped listening
+GIVE_UP = 10.0
+
+class Gecko:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        attr = termios.tcgetattr(self.fd)
+        attr[0] = 0					# iflag
+        attr[1] = 0					# oflag
+        attr[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attr[3] = 0					# lflag, raw
+        attr[6][termios.VMIN] = 0
+        attr[6][termios.VTIME] = 0
+        termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.rx = bytearray()
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            select.select([], [self.fd], [])
+            view = view[os.write(self.fd, view):]
+
+    def read(self, timeout):
+        if select.select([self.fd], [], [], timeout)[0]:
+            self.rx += os.read(self.fd, 4096)
+
+    def ack(self, timeout):
+        # returns (type, window, next, have, frame_max) or None
+        deadline = time.monotonic() + timeout
+        while True:
+            start = self.rx.find(ACK_MAGIC)
+            if start < 0:
+                del self.rx[:max(len(self.rx) - 1, 0)]
+            else:
+                del self.rx[:start]
+                if len(self.rx) >= ACK_SIZE:
+                    ack = bytes(self.rx[:ACK_SIZE])
+                    if zlib.crc32(ack[:16]) == struct.unpack(">I", ack[16:])[0]:
+                        del self.rx[:ACK_SIZE]
+                        return struct.unpack(">xxBBIIH2x", ack[:16])
+                    del self.rx[:2]
+                    continue
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self.read(left)
+
+def frame(seq, data, last):
+    hdr = struct.pack(">2sBBII", FRAME_MAGIC, FRAME_DATA, FLAG_LAST if last else 0, seq, len(data))
+    return hdr + struct.pack(">I", zlib.crc32(hdr + data)) + data
+
+def connect(dev):
+    print("Waiting for the console...")
+    while True:
+        dev.read(1.0)
+        if GC_READY in dev.rx:
+            break
+        del dev.rx[:]
+    del dev.rx[:]
+    dev.write(bytes([PC_FRAMED]))
+
+    ack = dev.ack(5.0)
+    if not ack or ack[0] != ACK_READY:
+        raise RuntimeError("console didn't answer the framed handshake, is it running usb-load mode?")
+    return ack
+
+def send(dev, stream, window, frame_size):
+    chunks = [stream[i:i + frame_size] for i in range(0, len(stream), frame_size)]
+    total = len(chunks)
+    base = sent = 0
+    have = 0
+    resent = 0
+    progress = heard = time.monotonic()
+
+    while base < total:
+        limit = min(base + window, total)
+        while sent < limit:
+            dev.write(frame(sent, chunks[sent], sent == total - 1))
+            sent += 1
+
+        ack = dev.ack(RESEND_TIMEOUT)
+        now = time.monotonic()
+        if ack is not None:
+            heard = now
+        elif now - heard > GIVE_UP:
+            raise RuntimeError(f"no answer from the console for {GIVE_UP:.0f} s, {base} of {total} frames acked")
+        if ack is None:
+            if now - progress < RESEND_TIMEOUT:
+                continue
+            # nothing heard, resend all that isn't known to be buffered
+            gaps = [s for s in range(base, sent) if not have >> (s - base) & 1]
+            progress = now
+        else:
+            kind, _, nxt, have, _ = ack
+            if nxt > base:
+                base = nxt
+                progress = now
+            if kind != NAK:
+                continue
+            # everything missing before the newest buffered frame was lost
+            gaps = [s for s in range(base, min(base + have.bit_length(), sent))
+                    if not have >> (s - base) & 1] or [base]
+
+        for s in gaps:
+            if s < sent:
+                dev.write(frame(s, chunks[s], s == total - 1))
+                resent += 1
+
+    return total, resent
+
+def main():
+    parser = argparse.ArgumentParser(description="Send a file to a KunaiGC loader over a USB Gecko")
+    parser.add_argument("file")
+    parser.add_argument("-d", "--device", default="/dev/ttyUSB0")
+    parser.add_argument("-w", "--window", type=int, default=32,
+                        help="frames in flight, capped by the console")
+    parser.add_argument("-f", "--frame-size", type=int, default=4096,
+                        help="payload bytes per frame, capped by the console")
+    parser.add_argument("-c", "--codec", choices=kpack.CODECS,
+                        help="pack the file first, xz needs a loader built with KUNAI_PAYLOAD_XZ")
+    parser.add_argument("-i", "--install", metavar="NAME", nargs="?", const="",
+                        help="install into the KunaiGC flash as NAME (default: the file name) "
+                             "instead of booting, pick it in the loader menu")
+    args = parser.parse_args()
+
+    name = args.install or os.path.basename(args.file)
+    if len(name.encode()) > 47 or "/" in name or name.startswith("."):
+        print(f"Bad file name {name!r}")
+        return -1
+
+    with open(args.file, "rb") as f:
+        raw = f.read()
+
+    data = kpack.pack(raw, args.codec, kpack.CHUNK_MAX) if args.codec else raw
+
+    dev = Gecko(args.device)
+    _, window, _, _, frame_max = connect(dev)
+    window = max(1, min(args.window, window))
+    frame_size = max(1, min(args.frame_size, frame_max))
+
+    mode = MODE_BOOT if args.install is None else MODE_INSTALL
+    xfer = struct.pack(">IIII48s", XFER_MAGIC, len(data), mode, zlib.crc32(data), name.encode())
+
+    start = time.monotonic()
+    frames, resent = send(dev, xfer + data, window, frame_size)
+    took = time.monotonic() - start
+
+    print(f"Sent {len(data)} bytes in {frames} frames ({resent} resent), window {window}, "
+          f"{took:.2f} s, {len(data) / max(took, 1e-6) / 1024:.1f} KiB/s on the wire")
+    if args.codec:
+        print(f"{args.codec}: {len(raw)} bytes unpacked, "
+              f"{len(raw) / max(took, 1e-6) / 1024:.1f} KiB/s effective")
+
+if __name__ == "__main__":
+    sys.exit(main())
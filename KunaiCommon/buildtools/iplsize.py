@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+
+# Size report for a packed IPL image. The bootrom pulls the image through
+# the descrambler byte by byte, so the load time before our code runs grows
+# linearly with the image size.
+#
+# For the two-stage boot pass the packed stage 2 as well. Stage 1 reads it
+# from the flash with EXI DMA and unpacks it, both are added to the total.
+
+import os
+import struct
+import sys
+
+# bytes per second the bootrom reads the scrambled image at, override with
+# the IPL_LOAD_RATE environment variable once measured on real hardware
+DEFAULT_RATE = 4_000_000	# EXI at 32 MHz, one bit per clock
+
+# stage 1 reads at the same clock, FLASH_READ_RATE overrides it
+DEFAULT_FLASH_RATE = 4_000_000
+
+# output bytes per second of LZ4 plus the CRC, a guess until measured,
+# UNPACK_RATE overrides it
+DEFAULT_UNPACK_RATE = 30_000_000
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(f"Usage: {sys.argv[0]} <image.vgc> [stage 2]")
+        return -1
+
+    rate = int(os.environ.get("IPL_LOAD_RATE", DEFAULT_RATE))
+    size = os.path.getsize(sys.argv[1])
+    load_ms = size * 1000 / rate
+
+    print(f"IPL image:     {size} bytes ({size / 1024:.1f}K)")
+    print(f"Bootrom load:  {load_ms:.1f} ms at {rate} B/s")
+
+    if len(sys.argv) == 3:
+        flash_rate = int(os.environ.get("FLASH_READ_RATE", DEFAULT_FLASH_RATE))
+        unpack_rate = int(os.environ.get("UNPACK_RATE", DEFAULT_UNPACK_RATE))
+
+        with open(sys.argv[2], "rb") as f:
+            data = f.read()
+        # payload_header_t, raw_size follows magic, version, codec
+        raw_size = struct.unpack(">I", data[8:12])[0]
+        read_ms = len(data) * 1000 / flash_rate
+        unpack_ms = raw_size * 1000 / unpack_rate
+
+        print(f"Stage 2:       {len(data)} bytes, {raw_size} unpacked")
+        print(f"Flash read:    {read_ms:.1f} ms at {flash_rate} B/s")
+        print(f"Unpack:        {unpack_ms:.1f} ms at {unpack_rate} B/s")
+        print(f"Projected:     {load_ms + read_ms + unpack_ms:.1f} ms to the loader, "
+              f"about {raw_size * 1000 / rate:.1f} ms as one image")
+
+if __name__ == "__main__":
+    sys.exit(main())
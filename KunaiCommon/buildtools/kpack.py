@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+# Packs a DOL (or any payload) into the container the loaders decode while
+# reading (source/payload/payload.h). LZ4 is the default, it decodes at
+# memcpy speed on the GameCube. xz packs tighter, but needs a loader built
+# with KUNAI_PAYLOAD_XZ.
+
+import argparse
+import lzma
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4B504159
+VERSION = 1
+
+CODECS = {"stored": 0, "lz4": 1, "xz": 2}
+
+CHUNK_MAX = 64 * 1024
+CHUNK_STORED = 0x80000000
+
+# LZ4 block format limits
+MIN_MATCH = 4
+LAST_LITERALS = 5
+MF_LIMIT = 12
+MAX_OFFSET = 65535
+
+def lz4_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+def lz4_sequence(out, literals, offset, match_len):
+    lit = len(literals)
+    token = min(lit, 15) << 4
+    if offset:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        lz4_length(out, lit - 15)
+    out += literals
+    if offset:
+        out += struct.pack("<H", offset)
+        if match_len - MIN_MATCH >= 15:
+            lz4_length(out, match_len - MIN_MATCH - 15)
+
+def lz4_block(data, start, end, table):
+    # greedy single-entry hash matcher, 'table' is shared by all chunks so
+    # matches can reach back into the previous ones
+    out = bytearray()
+    anchor = i = start
+    limit = end - MF_LIMIT
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > MAX_OFFSET:
+            i += 1
+            continue
+
+        max_len = end - LAST_LITERALS - i
+        n = MIN_MATCH
+        # compare in large steps first, python is slow per byte
+        step = 64
+        while step:
+            while n + step <= max_len and data[cand + n:cand + n + step] == data[i + n:i + n + step]:
+                n += step
+            step //= 4
+
+        lz4_sequence(out, data[anchor:i], i - cand, n)
+        table[data[i + n - 2:i + n + 2]] = i + n - 2
+        i += n
+        anchor = i
+
+    lz4_sequence(out, data[anchor:end], 0, 0)
+    return out
+
+def pack_lz4(raw, chunk_size):
+    out = bytearray()
+    table = {}
+    for start in range(0, len(raw), chunk_size):
+        end = min(start + chunk_size, len(raw))
+        block = lz4_block(raw, start, end, table)
+        if len(block) >= end - start:
+            out += struct.pack(">I", CHUNK_STORED | (end - start)) + raw[start:end]
+        else:
+            out += struct.pack(">I", len(block)) + block
+    return out
+
+def pack_xz(raw):
+    # the PowerPC branch filter makes code compress noticeably better,
+    # xz-embedded decodes it with XZ_DEC_POWERPC
+    filters = [
+        {"id": lzma.FILTER_POWERPC},
+        {"id": lzma.FILTER_LZMA2, "preset": 9, "dict_size": 1 << 20},
+    ]
+    return lzma.compress(raw, format=lzma.FORMAT_XZ, check=lzma.CHECK_CRC32, filters=filters)
+
+def pack(raw, codec, chunk_size):
+    # the whole container, header included
+    if codec == "lz4":
+        data = pack_lz4(raw, chunk_size)
+    elif codec == "xz":
+        data = pack_xz(raw)
+    else:
+        data = raw
+
+    header = struct.pack(">IBBHIII12x", MAGIC, VERSION, CODECS[codec], 0, len(raw),
+                         zlib.crc32(raw), chunk_size if codec == "lz4" else 0)
+    return header + data
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack a boot payload for the KunaiGC loaders")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("-c", "--codec", choices=CODECS, default="lz4")
+    parser.add_argument("--chunk-size", type=int, default=CHUNK_MAX,
+                        help="LZ4 chunk size, at most 64 KiB")
+    args = parser.parse_args()
+
+    if not 0 < args.chunk_size <= CHUNK_MAX:
+        print(f"Chunk size must be between 1 and {CHUNK_MAX}")
+        return -1
+
+    with open(args.input, "rb") as f:
+        raw = f.read()
+
+    data = pack(raw, args.codec, args.chunk_size)
+
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+    total = len(data)
+    print(f"{args.codec}: {len(raw)} -> {total} bytes ({total * 100 / max(len(raw), 1):.1f}%)")
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,69 @@
+/*
+ * aramstage.c
+ */
+
+#include <malloc.h>
+#include <ogc/aram.h>
+
+#include "aramstage.h"
+
+#define ALIGN32(x)	(((x) + 31) & ~31)
+
+static aramstage_t stage;
+
+u32 aramstage_alloc(aramstage_t *a, u32 size) {
+    u32 addr = a->next;
+
+    size = ALIGN32(size);
+    if (!size || a->next > a->top || size > a->top - a->next)
+        return 0;
+    a->next += size;
+    return addr;
+}
+
+u32 aramstage_free(void) {
+    if (!stage.top) {
+        stage.base = ALIGN32(AR_Init(NULL, 0));
+        stage.top = AR_GetSize() & ~31;
+        stage.next = stage.base;
+    }
+    return stage.top > stage.next ? stage.top - stage.next : 0;
+}
+
+void aramstage_reset(void) {
+    stage.next = stage.base;
+}
+
+u32 aramstage_park(dolload_read_fn read, void *ctx, u32 ofs, u32 size) {
+    u32 aram = aramstage_alloc(&stage, size);
+    u32 done = 0;
+    int half = 0;
+
+    if (!aram)
+        return 0;
+
+    u8 *bounce = memalign(32, 2 * ARAMSTAGE_CHUNK);
+    if (!bounce)
+        return 0;
+
+    // one half goes out to ARAM while the next chunk is read into the other
+    while (done < size) {
+        u8 *buf = bounce + half * ARAMSTAGE_CHUNK;
+        u32 len = size - done < ARAMSTAGE_CHUNK ? size - done : ARAMSTAGE_CHUNK;
+
+        if (read(ctx, ofs + done, buf, len)) {
+            aram = 0;
+            break;
+        }
+        DCFlushRange(buf, len);
+
+        while (AR_GetDMAStatus());
+        AR_StartDMA(AR_MRAMTOARAM, (u32) buf, aram + done, len);
+        done += len;
+        half ^= 1;
+    }
+
+    while (AR_GetDMAStatus());
+    free(bounce);
+    return aram;
+}
@@ -0,0 +1,42 @@
+/*
+ * aramstage.h
+ *
+ * Parks staged payload data in the 16 MB of auxiliary RAM instead of main
+ * memory. Data is DMA'd to ARAM while the next chunk is read and stays
+ * there until the stub DMAs it to its load address at handoff, see
+ * DOLLOAD_EXTRA_ARAM. Nothing else in the loaders uses ARAM.
+ */
+
+#ifndef ARAMSTAGE_H_
+#define ARAMSTAGE_H_
+
+#include <gccore.h>
+
+#include "dolload/dolload.h"
+
+// each half of the bounce buffer in main memory
+#define ARAMSTAGE_CHUNK		(32 * 1024)
+
+// bump allocator over the ARAM above the part AR_Init keeps for the DSP
+typedef struct {
+    u32 base;
+    u32 top;
+    u32 next;
+} aramstage_t;
+
+// returns the ARAM address of 'size' bytes (rounded up to 32), or 0 if
+// they don't fit. Touches no hardware.
+u32 aramstage_alloc(aramstage_t *a, u32 size);
+
+// ARAM left to park data in, ARAM is set up on the first call
+u32 aramstage_free(void);
+
+// forget everything parked so far
+void aramstage_reset(void);
+
+// Read 'size' bytes (a multiple of 32) at 'ofs' of the file into ARAM.
+// Returns the ARAM address, or 0 if out of ARAM or memory or on a read
+// error.
+u32 aramstage_park(dolload_read_fn read, void *ctx, u32 ofs, u32 size);
+
+#endif /* ARAMSTAGE_H_ */
@@ -0,0 +1,70 @@
+/*
+ * bootlast.c
+ */
+
+#include <string.h>
+
+#include "kunaigc/kunaistorage.h"
+#include "bootprobe.h"
+#include "bootlast.h"
+
+extern lfs_file_t lfs_file;
+
+// What the file held when bootlast_load() read it. bootlast_store() compares
+// against this instead of holding the filesystem again to read it back, so a
+// boot from the same source costs the flash one read and nothing else.
+static bootlast_t stored;
+static int stored_read;		// 'stored' is what the file holds
+static int stored_valid;
+
+int bootlast_load(bootlast_t *b) {
+    if (!stored_read) {
+        lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+        if (!fs)
+            return 0;
+
+        stored_valid = 0;
+        if (lfs_file_open(fs, &lfs_file, BOOTLAST_FILE, LFS_O_RDONLY) == LFS_ERR_OK) {
+            if (lfs_file_read(fs, &lfs_file, &stored, sizeof(stored)) == sizeof(stored) &&
+                stored.magic == BOOTLAST_MAGIC && stored.src < BOOTPROBE_COUNT) {
+                stored.path[BOOTLAST_PATH_MAX - 1] = '\0';
+                stored_valid = 1;
+            }
+            lfs_file_close(fs, &lfs_file);
+        }
+        stored_read = 1;
+
+        kunai_storage_put();
+    }
+
+    if (stored_valid)
+        *b = stored;
+    return stored_valid;
+}
+
+void bootlast_store(const bootlast_t *b) {
+    bootlast_t old;
+
+    // spare the flash a write when booting from the same place again
+    if (bootlast_load(&old) && memcmp(&old, b, sizeof(old)) == 0)
+        return;
+
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+    if (!fs)
+        return;
+
+    if (lfs_file_open(fs, &lfs_file, BOOTLAST_FILE,
+                      LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) == LFS_ERR_OK) {
+        int ok = lfs_file_write(fs, &lfs_file, b, sizeof(*b)) == sizeof(*b);
+        ok = lfs_file_close(fs, &lfs_file) == LFS_ERR_OK && ok;
+        if (ok) {
+            stored = *b;
+            stored_valid = 1;
+        } else {
+            // don't know what made it to the flash, read it again next time
+            stored_read = 0;
+        }
+    }
+
+    kunai_storage_put();
+}
@@ -0,0 +1,36 @@
+/*
+ * bootlast.h
+ *
+ * The source the last boot was loaded from, kept in the "boot_last" file on
+ * the KunaiGC flash. It is tried before any slot is probed. FAT sources are
+ * opened from the recorded location without walking any directories, and
+ * only if the volume and the file's directory entry are unchanged.
+ */
+
+#ifndef BOOTLAST_H_
+#define BOOTLAST_H_
+
+#include <gccore.h>
+
+#include "fatboot/fatboot.h"
+
+#define BOOTLAST_FILE		"boot_last"
+#define BOOTLAST_MAGIC		0x4B424C32	/* "KBL2" */
+#define BOOTLAST_PATH_MAX	64
+
+typedef struct {
+    u32 magic;
+    u8 src;			// enum bootprobe_src
+    u8 reserved[3];
+    fatboot_loc_t loc;		// unused for USB Gecko sources
+    char path[BOOTLAST_PATH_MAX];
+} bootlast_t;
+
+// returns 1 if a valid record was read, the file is only read once per boot
+int bootlast_load(bootlast_t *b);
+
+// writes the record unless the stored one is identical, which needs no
+// flash access after bootlast_load()
+void bootlast_store(const bootlast_t *b);
+
+#endif /* BOOTLAST_H_ */
@@ -0,0 +1,160 @@
+/*
+ * bootprobe.c
+ *
+ * A slot holds either a USB Gecko or an SD adapter, so the per-channel
+ * thread checks for a Gecko first and, if there is none, whether anything
+ * is attached at all. Both only touch their own channel. Bringing up a
+ * card goes through libogc's card_io, whose state is shared by all
+ * channels, so one more thread does that for the candidates one channel at
+ * a time, in boot order, while the slower channels are still detecting.
+ * A card that is found stays started, so load_fat() can mount it without a
+ * second card init. The ones not taken are shut down in bootprobe_finish().
+ */
+
+#include <sdcard/gcsd.h>
+
+#include "bootprobe.h"
+
+struct probe_channel {
+    s32 chan;
+    int usb_src;			// -1 if there is no Gecko slot on this channel
+    int sd_src;
+    const DISC_INTERFACE *sd;
+    lwp_t thread;
+    int joined;				// detection done
+    int attached;			// no Gecko, but something to try a card on
+    int card_up;			// sd started and not taken yet
+};
+
+// in boot order, the card thread brings them up in this order
+static struct probe_channel channels[] = {
+    { EXI_CHANNEL_1, BOOTPROBE_USB_B, BOOTPROBE_SD_B, &__io_gcsdb },
+    { EXI_CHANNEL_0, BOOTPROBE_USB_A, BOOTPROBE_SD_A, &__io_gcsda },
+    { EXI_CHANNEL_2, -1,              BOOTPROBE_SD2,  &__io_gcsd2 },
+};
+#define NUM_CHANNELS (sizeof(channels) / sizeof(channels[0]))
+
+static u8 stacks[NUM_CHANNELS + 1][BOOTPROBE_STACK_SIZE] ATTRIBUTE_ALIGN(32);
+static volatile u8 present[BOOTPROBE_COUNT];
+static lwp_t card_thread;
+static int card_joined;
+static int started;
+
+static void *detect_thread(void *arg) {
+    struct probe_channel *c = arg;
+
+    if (c->usb_src >= 0 && usb_isgeckoalive(c->chan)) {
+        present[c->usb_src] = 1;
+        return NULL;
+    }
+
+    // the EXI's own insert detection, nothing on the bus yet
+    c->attached = EXI_ProbeEx(c->chan) > 0;
+    return NULL;
+}
+
+static void join_detect(struct probe_channel *c) {
+    if (!c->joined) {
+        LWP_JoinThread(c->thread, NULL);
+        c->joined = 1;
+    }
+}
+
+static void *card_thread_fn(void *arg) {
+    (void) arg;
+
+    for (u32 i = 0; i < NUM_CHANNELS; i++) {
+        struct probe_channel *c = &channels[i];
+
+        join_detect(c);
+        if (c->attached && c->sd->startup()) {
+            if (c->sd->isInserted()) {
+                present[c->sd_src] = 1;
+                c->card_up = 1;
+            } else {
+                c->sd->shutdown();
+            }
+        }
+    }
+    return NULL;
+}
+
+void bootprobe_start(void) {
+    for (int i = 0; i < BOOTPROBE_COUNT; i++)
+        present[i] = 0;
+
+    for (u32 i = 0; i < NUM_CHANNELS; i++) {
+        struct probe_channel *c = &channels[i];
+        c->joined = 0;
+        c->attached = 0;
+        c->card_up = 0;
+        if (LWP_CreateThread(&c->thread, detect_thread, c, stacks[i],
+                             BOOTPROBE_STACK_SIZE, BOOTPROBE_PRIO) < 0) {
+            // no thread, detect inline
+            detect_thread(c);
+            c->joined = 1;
+        }
+    }
+
+    // joins the detection threads itself, only it may join them now
+    card_joined = 0;
+    if (LWP_CreateThread(&card_thread, card_thread_fn, NULL, stacks[NUM_CHANNELS],
+                         BOOTPROBE_STACK_SIZE, BOOTPROBE_PRIO) < 0) {
+        card_thread_fn(NULL);
+        card_joined = 1;
+    }
+    started = 1;
+}
+
+static struct probe_channel *channel_of(int src) {
+    for (u32 i = 0; i < NUM_CHANNELS; i++) {
+        if (channels[i].usb_src == src || channels[i].sd_src == src)
+            return &channels[i];
+    }
+    return NULL;
+}
+
+// nothing may be loaded while any probe still runs, the card thread is
+// the last to finish and has joined all the others
+static void join_all(void) {
+    if (!card_joined) {
+        LWP_JoinThread(card_thread, NULL);
+        card_joined = 1;
+    }
+}
+
+int bootprobe_present(int src) {
+    struct probe_channel *c = channel_of(src);
+    if (!started || !c)
+        return 0;
+
+    join_all();
+    return present[src];
+}
+
+int bootprobe_take(const DISC_INTERFACE *sd) {
+    if (!started)
+        return 0;
+
+    for (u32 i = 0; i < NUM_CHANNELS; i++) {
+        if (channels[i].sd == sd && card_joined && channels[i].card_up) {
+            channels[i].card_up = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void bootprobe_finish(void) {
+    if (!started)
+        return;
+
+    join_all();
+    for (u32 i = 0; i < NUM_CHANNELS; i++) {
+        if (channels[i].card_up) {
+            channels[i].sd->shutdown();
+            channels[i].card_up = 0;
+        }
+    }
+    started = 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * bootprobe.h
+ *
+ * Presence detection for the boot sources. The three EXI channels are
+ * independent, so every channel is probed by its own thread and a missing
+ * device only costs its detection timeout once instead of once per source.
+ * SD cards share libogc's card_io and are brought up one after the other.
+ * Loading only starts once all of them are done.
+ */
+
+#ifndef BOOTPROBE_H_
+#define BOOTPROBE_H_
+
+#include <gccore.h>
+#include <ogc/disc_io.h>
+
+// in boot priority order
+enum bootprobe_src {
+    BOOTPROBE_USB_B = 0,
+    BOOTPROBE_SD_B,
+    BOOTPROBE_USB_A,
+    BOOTPROBE_SD_A,
+    BOOTPROBE_SD2,
+    BOOTPROBE_COUNT,
+};
+
+#define BOOTPROBE_PRIO		80	/* above the main thread, so joining just blocks */
+#define BOOTPROBE_STACK_SIZE	8192
+
+// start probing all slots in the background
+void bootprobe_start(void);
+
+// wait for all channels to be probed, returns 1 if a device was found for 'src'
+int bootprobe_present(int src);
+
+// returns 1 and hands over the card if the probe left 'sd' started, the
+// caller shuts it down
+int bootprobe_take(const DISC_INTERFACE *sd);
+
+// wait for all probe threads and shut down the cards nobody took, must be
+// called before the handoff
+void bootprobe_finish(void);
+
+#endif /* BOOTPROBE_H_ */
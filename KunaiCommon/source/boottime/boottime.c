@@ -0,0 +1,83 @@
+/*
+ * boottime.c
+ *
+ * The records are small enough to stay inline in the LittleFS metadata, so
+ * storing one is a metadata commit and rarely needs an erase.
+ */
+
+#include <string.h>
+
+#include "kunaigc/kunaistorage.h"
+#include "boottime.h"
+
+extern lfs_file_t lfs_file;
+
+boottime_rec_t boottime;
+static u64 boot_start;
+
+void boottime_begin(void) {
+    memset(&boottime, 0, sizeof(boottime));
+    boot_start = gettime();
+}
+
+// oldest first, as stored
+static int load_all(lfs_t *fs, boottime_rec_t *recs) {
+    int n = 0;
+
+    if (lfs_file_open(fs, &lfs_file, BOOTTIME_FILE, LFS_O_RDONLY) == LFS_ERR_OK) {
+        lfs_ssize_t len = lfs_file_read(fs, &lfs_file, recs, BOOTTIME_KEEP * sizeof(*recs));
+        if (len > 0)
+            n = len / sizeof(*recs);
+        lfs_file_close(fs, &lfs_file);
+    }
+    return n;
+}
+
+void boottime_finish(u8 src) {
+    boottime.src = src;
+    boottime.total_us = ticks_to_microsecs(gettime() - boot_start);
+
+#ifdef KUNAI_BOOTTIME_SAVE
+    static boottime_rec_t recs[BOOTTIME_KEEP + 1];
+    u64 start = gettime();
+
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+    if (!fs)
+        return;
+
+    int n = load_all(fs, recs);
+    boottime.seq = n ? recs[n - 1].seq + 1 : 1;
+    recs[n++] = boottime;
+    if (n > BOOTTIME_KEEP) {
+        memmove(recs, recs + 1, BOOTTIME_KEEP * sizeof(*recs));
+        n = BOOTTIME_KEEP;
+    }
+
+    if (lfs_file_open(fs, &lfs_file, BOOTTIME_FILE,
+                      LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) == LFS_ERR_OK) {
+        lfs_file_write(fs, &lfs_file, recs, n * sizeof(*recs));
+        lfs_file_close(fs, &lfs_file);
+    }
+
+    kunai_storage_put();
+
+    // can't be part of the record it saves
+    kprintf("Boot times saved in %u ms\n", ticks_to_millisecs(gettime() - start));
+#endif
+}
+
+int boottime_load(boottime_rec_t *recs, int max) {
+    boottime_rec_t all[BOOTTIME_KEEP];
+
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+    if (!fs)
+        return 0;
+
+    int total = load_all(fs, all);
+    kunai_storage_put();
+
+    int n = total < max ? total : max;
+    for (int i = 0; i < n; i++)
+        recs[i] = all[total - 1 - i];
+    return n;
+}
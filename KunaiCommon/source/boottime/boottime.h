@@ -0,0 +1,69 @@
+/*
+ * boottime.h
+ *
+ * Timebase stamps for the stages of a boot, from main() to the handoff.
+ * The record is kept in RAM. Saving it costs flash programs and wear on
+ * every boot, so only builds with -DKUNAI_BOOTTIME_SAVE add it to the last
+ * BOOTTIME_KEEP records in the "boot_times" file, which the menu shows.
+ */
+
+#ifndef BOOTTIME_H_
+#define BOOTTIME_H_
+
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+
+#define BOOTTIME_FILE	"boot_times"
+#define BOOTTIME_KEEP	8
+
+enum boottime_stage {
+    BOOTTIME_DISK_INIT = 0,	// disk_initialize, card startup
+    BOOTTIME_MOUNT,		// f_mount, including disk_initialize
+    BOOTTIME_OPEN,		// f_open, or the last boot's directory entry check
+    BOOTTIME_READ,		// reading (and unpacking) the payload
+    BOOTTIME_ALLOC,		// dol_alloc
+    BOOTTIME_HANDOFF,		// stub copy up to SYS_ResetSystem
+    BOOTTIME_STAGES,
+};
+
+// one boot, all times in microseconds, stages sum up over every attempt
+typedef struct {
+    u32 seq;			// counts up with every recorded boot
+    u8 src;			// enum bootprobe_src, BOOTPROBE_COUNT for flash
+    u8 reserved[3];
+    u32 stage_us[BOOTTIME_STAGES];
+    u32 disk_reads;		// disk_read calls
+    u32 disk_sectors;
+    u32 disk_us;
+    u32 disk_max_us;		// slowest single disk_read
+    u32 total_us;		// main() to the handoff, without saving the record
+} boottime_rec_t;
+
+extern boottime_rec_t boottime;
+
+// start a new record, called first thing in main()
+void boottime_begin(void);
+
+static inline
+void boottime_add(int stage, u64 start) {
+    boottime.stage_us[stage] += ticks_to_microsecs(gettime() - start);
+}
+
+static inline
+void boottime_disk_read(u32 sectors, u64 start) {
+    u32 us = ticks_to_microsecs(gettime() - start);
+    boottime.disk_reads++;
+    boottime.disk_sectors += sectors;
+    boottime.disk_us += us;
+    if (us > boottime.disk_max_us)
+        boottime.disk_max_us = us;
+}
+
+// close the record, with KUNAI_BOOTTIME_SAVE also add it to the ones on
+// flash and print how long that took
+void boottime_finish(u8 src);
+
+// read up to 'max' records, newest first, returns the number read
+int boottime_load(boottime_rec_t *recs, int max);
+
+#endif /* BOOTTIME_H_ */
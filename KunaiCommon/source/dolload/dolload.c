@@ -0,0 +1,296 @@
+/*
+ * dolload.c
+ *
+ * The window for direct placement is the free arena above the heap (plus
+ * DOLLOAD_HEAP_RESERVE for the loader's remaining allocations) up to the
+ * staged image, which is carved from the top of the arena. Whatever falls
+ * outside, usually the start of the first text section over the libogc
+ * workspace and anything above 0x81300000 over the loader, is staged.
+ */
+
+#include <string.h>
+
+#include "dolload.h"
+#include "aramstage/aramstage.h"
+
+#define DOL_MEM_LO	0x80000000
+#define DOL_MEM_HI	0x81800000
+
+#define ALIGN32(x)	(((x) + 31) & ~31)
+
+static int in_mem(u32 addr, u32 size) {
+    return addr >= DOL_MEM_LO && addr <= DOL_MEM_HI && size <= DOL_MEM_HI - addr;
+}
+
+int dolload_check(const dol_header_t *hdr, u32 file_size) {
+    if (file_size < sizeof(*hdr) || !in_mem(hdr->entry, 4))
+        return 0;
+
+    for (int i = 0; i < DOL_SECTIONS; i++) {
+        if (!hdr->size[i])
+            continue;
+        if (hdr->offset[i] < sizeof(*hdr) || hdr->offset[i] > file_size ||
+            hdr->size[i] > file_size - hdr->offset[i] ||
+            !in_mem(hdr->addr[i], hdr->size[i]))
+            return 0;
+    }
+
+    return !hdr->bss_size || in_mem(hdr->bss_addr, hdr->bss_size);
+}
+
+// the unaligned bytes before and after the whole cache lines of a piece
+static u32 head_size(const dolload_piece_t *p) {
+    return ALIGN32(p->addr) - p->addr;
+}
+
+static u32 tail_size(const dolload_piece_t *p) {
+    return (p->size - head_size(p)) & 31;
+}
+
+static void add_piece(dolload_plan_t *plan, const dol_header_t *hdr, int section,
+                      u32 lo, u32 hi, int direct, u32 aram_free) {
+    dolload_piece_t *p;
+    int i;
+
+    if (lo >= hi)
+        return;
+
+    // keep the pieces sorted by file offset, there are only a few
+    u32 file_ofs = hdr->offset[section] + (lo - hdr->addr[section]);
+    for (i = plan->count; i > 0 && plan->piece[i - 1].file_ofs > file_ofs; i--)
+        plan->piece[i] = plan->piece[i - 1];
+
+    p = &plan->piece[i];
+    p->file_ofs = file_ofs;
+    p->addr = lo;
+    p->size = hi - lo;
+    p->section = section;
+    p->direct = direct;
+    p->aram = 0;
+    plan->count++;
+
+    if (direct) {
+        plan->direct_size += p->size;
+        return;
+    }
+
+    u32 head = head_size(p), tail = tail_size(p);
+    u32 middle = p->size - head - tail;
+    if (p->size >= DOLLOAD_ARAM_MIN && middle <= aram_free - plan->aram_size) {
+        p->aram = 1;
+        plan->aram_size += middle;
+        plan->staged_size += ALIGN32(head) + ALIGN32(tail);
+        plan->extra_count += 1 + !!head + !!tail;
+    } else {
+        plan->staged_size += ALIGN32(p->size);
+    }
+}
+
+int dolload_plan(const dol_header_t *hdr, u32 win_lo, u32 win_hi, u32 aram_free,
+                 dolload_plan_t *plan) {
+    int text = 0, data = 0;
+
+    memset(plan, 0, sizeof(*plan));
+
+    for (int i = 0; i < DOL_SECTIONS; i++) {
+        u32 lo = hdr->addr[i];
+        u32 hi = lo + hdr->size[i];
+
+        if (!hdr->size[i])
+            continue;
+
+        u32 in_lo = lo > win_lo ? lo : win_lo;
+        u32 in_hi = hi < win_hi ? hi : win_hi;
+
+        add_piece(plan, hdr, i, lo, hi < win_lo ? hi : win_lo, 0, aram_free);
+        if (in_lo < in_hi)
+            add_piece(plan, hdr, i, in_lo, in_hi, 1, aram_free);
+        add_piece(plan, hdr, i, lo > win_hi ? lo : win_hi, hi, 0, aram_free);
+    }
+
+    // every other staged piece takes a section slot of the staged header
+    for (int i = 0; i < plan->count; i++) {
+        dolload_piece_t *p = &plan->piece[i];
+        if (p->direct || p->aram)
+            continue;
+        if (p->section < DOL_TEXT_MAX)
+            text++;
+        else
+            data++;
+    }
+    if (text > DOL_TEXT_MAX || data > DOL_DATA_MAX)
+        return -1;
+
+    plan->staged_size += sizeof(*hdr) + ALIGN32(plan->extra_count * sizeof(dolload_extra_t));
+
+    for (int i = 1; i < plan->count; i++)
+        if (plan->piece[i].file_ofs < plan->piece[i - 1].file_ofs + plan->piece[i - 1].size)
+            return -1;
+
+    return 0;
+}
+
+int dolload_stream_skip(dolload_stream_t *s, u32 ofs) {
+    static u8 scratch[512] ATTRIBUTE_ALIGN(32);
+
+    if (ofs < s->pos)
+        return -1;
+
+    while (s->pos < ofs) {
+        u32 len = ofs - s->pos < sizeof(scratch) ? ofs - s->pos : sizeof(scratch);
+        int n = s->read(s->ctx, scratch, len);
+        if (n <= 0)
+            return -1;
+        s->pos += n;
+    }
+    return 0;
+}
+
+int dolload_stream_read(void *ctx, u32 ofs, void *buf, u32 len) {
+    dolload_stream_t *s = ctx;
+    u8 *p = buf;
+
+    if (dolload_stream_skip(s, ofs))
+        return -1;
+
+    while (len) {
+        int n = s->read(s->ctx, p, len);
+        if (n <= 0)
+            return -1;
+        s->pos += n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int overlaps(u32 addr, u32 size, u32 lo, u32 hi) {
+    return size && addr < hi && addr + size > lo;
+}
+
+static void add_extra(dolload_extra_t *extra, u32 *count, const dolload_piece_t *p,
+                      u32 dst, u32 src, u32 size, u32 flags) {
+    dolload_extra_t *e = &extra[(*count)++];
+
+    e->dst = dst;
+    e->src = src;
+    e->size = size;
+    e->flags = flags | (p->section < DOL_TEXT_MAX ? DOLLOAD_EXTRA_TEXT : 0);
+}
+
+// the whole cache lines of a piece go to ARAM, its ends into the image
+static int park_piece(const dolload_piece_t *p, dolload_read_fn read, void *ctx,
+                      u8 *image, u32 *pos, dolload_extra_t *extra, u32 *count) {
+    u32 head = head_size(p), tail = tail_size(p);
+    u32 middle = p->size - head - tail;
+
+    if (head) {
+        if (read(ctx, p->file_ofs, image + *pos, head))
+            return -1;
+        add_extra(extra, count, p, p->addr, (u32) image + *pos, head, 0);
+        *pos += ALIGN32(head);
+    }
+
+    u32 aram = aramstage_park(read, ctx, p->file_ofs + head, middle);
+    if (!aram)
+        return -1;
+    add_extra(extra, count, p, p->addr + head, aram, middle, DOLLOAD_EXTRA_ARAM);
+
+    if (tail) {
+        if (read(ctx, p->file_ofs + head + middle, image + *pos, tail))
+            return -1;
+        add_extra(extra, count, p, p->addr + head + middle, (u32) image + *pos, tail, 0);
+        *pos += ALIGN32(tail);
+    }
+    return 0;
+}
+
+u8 *dolload_load(const dol_header_t *hdr, dolload_read_fn read, void *ctx, int flags) {
+    static dolload_plan_t plan;
+    u32 arena_hi = (u32) SYS_GetArenaHi() & ~31;
+    u32 win_lo = ALIGN32((u32) SYS_GetArenaLo() + DOLLOAD_HEAP_RESERVE);
+    u32 win_hi = arena_hi;
+    u32 base = 0;
+
+    // whatever an earlier attempt parked is of no use anymore
+    aramstage_reset();
+    u32 aram_free = aramstage_free();
+
+    // the staged image is carved from the top of the window, which may push
+    // more sections out of it, shrink until both fit
+    for (int tries = 0; tries < 4 && win_lo < win_hi; tries++) {
+        if (dolload_plan(hdr, win_lo, win_hi, aram_free, &plan))
+            return NULL;
+        base = (arena_hi - plan.staged_size) & ~31;
+        if (base >= win_hi)
+            break;
+        win_hi = base;
+    }
+    if (base < win_hi || base < win_lo)
+        return NULL;
+    if (!plan.direct_size && !(flags & DOLLOAD_NO_FALLBACK))
+        return NULL;
+
+    // the stub copies staged pieces forward and clears bss, neither may land
+    // on the staged image itself
+    if (overlaps(hdr->bss_addr, hdr->bss_size, base, arena_hi))
+        return NULL;
+    for (int i = 0; i < plan.count; i++)
+        if (!plan.piece[i].direct &&
+            overlaps(plan.piece[i].addr, plan.piece[i].size, base, arena_hi))
+            return NULL;
+
+    u8 *image = (u8 *) base;
+    dol_header_t *out = (dol_header_t *) image;
+    dolload_extra_t *extra = (dolload_extra_t *) (image + sizeof(*out));
+    u32 pos = sizeof(*out) + ALIGN32(plan.extra_count * sizeof(*extra));
+    int text = 0, data = DOL_TEXT_MAX;
+
+    memset(out, 0, sizeof(*out));
+    out->bss_addr = hdr->bss_addr;
+    out->bss_size = hdr->bss_size;
+    out->entry = hdr->entry;
+    if (plan.extra_count) {
+        out->extra_magic = DOLLOAD_EXTRA_MAGIC;
+        out->extra = (u32) extra;
+    }
+
+    for (int i = 0; i < plan.count; i++) {
+        dolload_piece_t *p = &plan.piece[i];
+        u8 *dst;
+
+        if (p->aram) {
+            if (park_piece(p, read, ctx, image, &pos, extra, &out->extra_count))
+                return NULL;
+            continue;
+        }
+
+        if (p->direct) {
+            dst = (u8 *) p->addr;
+        } else {
+            int slot = p->section < DOL_TEXT_MAX ? text++ : data++;
+            out->offset[slot] = pos;
+            out->addr[slot] = p->addr;
+            out->size[slot] = p->size;
+            dst = image + pos;
+            pos += ALIGN32(p->size);
+        }
+
+        if (read(ctx, p->file_ofs, dst, p->size))
+            return NULL;
+
+        // placed for good, nothing copies it again before it runs
+        if (p->direct) {
+            DCFlushRange(dst, p->size);
+            if (p->section < DOL_TEXT_MAX)
+                ICInvalidateRange(dst, p->size);
+        }
+    }
+
+    kprintf("Placed %uB directly, staged %uB, parked %uB in ARAM\n",
+            plan.direct_size, pos, plan.aram_size);
+
+    // keep the heap below the placed sections from now on
+    SYS_SetArenaHi((void *) win_lo);
+    return image;
+}
@@ -0,0 +1,123 @@
+/*
+ * dolload.h
+ *
+ * Streams a DOL into memory section by section instead of reading the whole
+ * file into one buffer for the stub to copy out. Every section (or the part
+ * of it) that lands in free arena memory is read straight to its load
+ * address. The rest, parts that overlap memory still in use by the loader,
+ * is staged at the top of the arena behind a rewritten DOL header, so the
+ * stub places it at handoff exactly as before.
+ *
+ * Large staged pieces are parked in ARAM instead (aramstage). The header
+ * then points to a table of extra pieces the stub works through after the
+ * sections: the cache line aligned middle of each parked piece, DMA'd from
+ * ARAM, and its unaligned ends, copied from the staged image.
+ */
+
+#ifndef DOLLOAD_H_
+#define DOLLOAD_H_
+
+#include <gccore.h>
+
+#define DOL_TEXT_MAX		7
+#define DOL_DATA_MAX		11
+#define DOL_SECTIONS		(DOL_TEXT_MAX + DOL_DATA_MAX)
+
+// big-endian like the CPU, text sections first, then data
+typedef struct {
+    u32 offset[DOL_SECTIONS];
+    u32 addr[DOL_SECTIONS];
+    u32 size[DOL_SECTIONS];
+    u32 bss_addr;
+    u32 bss_size;
+    u32 entry;
+    u32 extra_magic;		// DOLLOAD_EXTRA_MAGIC if there is a table
+    u32 extra;			// address of the dolload_extra_t table
+    u32 extra_count;
+    u32 pad[4];
+} dol_header_t;
+
+#define DOLLOAD_EXTRA_MAGIC	0x4152414D	/* "ARAM" */
+
+#define DOLLOAD_EXTRA_TEXT	1	// invalidated in the instruction cache
+#define DOLLOAD_EXTRA_ARAM	2	// 'src' is in ARAM, else in main memory
+
+typedef struct {
+    u32 dst;
+    u32 src;
+    u32 size;			// ARAM pieces are whole cache lines at 'dst'
+    u32 flags;
+} dolload_extra_t;
+
+// heap left to the loader below the placed sections
+#define DOLLOAD_HEAP_RESERVE	(128 * 1024)
+
+// a section splits in up to three pieces, below, inside and above the window
+#define DOLLOAD_PIECES_MAX	(DOL_SECTIONS * 3)
+
+// staged pieces from this size on are parked in ARAM, if there is room
+#define DOLLOAD_ARAM_MIN	(16 * 1024)
+
+typedef struct {
+    u32 file_ofs;
+    u32 addr;
+    u32 size;
+    u8 section;			// index into the header
+    u8 direct;			// read to 'addr' now, else staged for the stub
+    u8 aram;			// staged with its middle parked in ARAM
+} dolload_piece_t;
+
+typedef struct {
+    dolload_piece_t piece[DOLLOAD_PIECES_MAX];	// sorted by file offset
+    int count;
+    u32 direct_size;
+    u32 staged_size;		// staged image, header and extra table included
+    u32 aram_size;
+    int extra_count;
+} dolload_plan_t;
+
+// reads exactly 'len' bytes at 'ofs' of the file, returns 0 on success.
+// Called with increasing offsets, ranges never overlap.
+typedef int (*dolload_read_fn)(void *ctx, u32 ofs, void *buf, u32 len);
+
+// Sources that can only be read front to back (the USB Gecko) go through a
+// dolload_stream_t, its read function drops the bytes between the pieces.
+// 'read' returns the number of bytes read (at most 'len') or a negative
+// value on error, 'pos' counts the bytes of the file consumed so far.
+typedef int (*dolload_stream_fn)(void *ctx, void *buf, u32 len);
+
+typedef struct {
+    dolload_stream_fn read;
+    void *ctx;
+    u32 pos;
+} dolload_stream_t;
+
+// a dolload_read_fn, 'ctx' is the dolload_stream_t
+int dolload_stream_read(void *ctx, u32 ofs, void *buf, u32 len);
+
+// read and drop the stream up to 'ofs', returns 0 on success
+int dolload_stream_skip(dolload_stream_t *s, u32 ofs);
+
+// returns 1 if 'hdr' (the first bytes of a file of 'file_size' bytes) looks
+// like a DOL with every section inside the file and main memory
+int dolload_check(const dol_header_t *hdr, u32 file_size);
+
+// Split the sections of 'hdr' into pieces read straight to their address,
+// those inside [win_lo, win_hi), and pieces staged for the stub, of which
+// up to 'aram_free' bytes are parked in ARAM. Returns 0, or -1 if the
+// staged pieces don't fit the slots of a DOL header or two sections share
+// file data.
+int dolload_plan(const dol_header_t *hdr, u32 win_lo, u32 win_hi, u32 aram_free,
+                 dolload_plan_t *plan);
+
+// the caller can't read the file whole, stage it all if nothing can be
+// placed directly
+#define DOLLOAD_NO_FALLBACK	1
+
+// Load the DOL described by 'hdr'. Returns the staged image to hand to the
+// stub, or NULL if the file is better read whole (nothing would be placed
+// directly, the plan failed) or on a read error. On success the arena is
+// shrunk so the heap can't grow into placed sections or the staged image.
+u8 *dolload_load(const dol_header_t *hdr, dolload_read_fn read, void *ctx, int flags);
+
+#endif /* DOLLOAD_H_ */
@@ -0,0 +1,147 @@
+/*
+ * elfload.c
+ *
+ * Physical addresses below 0x01800000 are mapped to cached memory, DOLs
+ * and the stub work with those. The ELF and program headers may sit inside
+ * the first segment, so the bytes the caller already read are served from
+ * its buffer and a stream never has to go back.
+ */
+
+#include <string.h>
+
+#include "elfload.h"
+
+#define ELF_MEM_LO	0x80000000
+#define ELF_MEM_HI	0x81800000
+
+typedef struct {
+    const u8 *head;
+    u32 head_len;
+    dolload_read_fn read;
+    void *ctx;
+} elf_source_t;
+
+static int source_read(void *ctx, u32 ofs, void *buf, u32 len) {
+    elf_source_t *src = ctx;
+    u8 *p = buf;
+
+    if (ofs < src->head_len) {
+        u32 n = src->head_len - ofs < len ? src->head_len - ofs : len;
+        memcpy(p, src->head + ofs, n);
+        ofs += n;
+        p += n;
+        len -= n;
+    }
+    return len ? src->read(src->ctx, ofs, p, len) : 0;
+}
+
+static u32 to_cached(u32 addr) {
+    return addr < ELF_MEM_HI - ELF_MEM_LO ? addr | ELF_MEM_LO : addr;
+}
+
+static int in_mem(u32 addr, u32 size) {
+    return addr >= ELF_MEM_LO && addr <= ELF_MEM_HI && size <= ELF_MEM_HI - addr;
+}
+
+static int overlaps(u32 addr, u32 size, u32 lo, u32 hi) {
+    return size && addr < hi && addr + size > lo;
+}
+
+int elfload_check(const elf32_ehdr_t *ehdr, u32 file_size) {
+    static const u8 ident[] = { 0x7f, 'E', 'L', 'F', 1 /* 32 bit */, 2 /* big-endian */ };
+
+    return file_size >= sizeof(*ehdr) && !memcmp(ehdr->ident, ident, sizeof(ident)) &&
+           ehdr->type == ELF_ET_EXEC && ehdr->machine == ELF_EM_PPC &&
+           ehdr->phentsize == sizeof(elf32_phdr_t) &&
+           ehdr->phnum && ehdr->phnum <= ELFLOAD_PHNUM_MAX &&
+           ehdr->phoff <= file_size &&
+           ehdr->phnum * sizeof(elf32_phdr_t) <= file_size - ehdr->phoff;
+}
+
+// the DOL header for the PT_LOAD segments, text for the executable ones
+static int segments(const elf32_ehdr_t *ehdr, const elf32_phdr_t *ph, u32 file_size,
+                    dol_header_t *hdr) {
+    int text = 0, data = DOL_TEXT_MAX;
+    u32 bss_lo = 0, bss_hi = 0;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->entry = to_cached(ehdr->entry);
+    if (!in_mem(hdr->entry, 4))
+        return ELFLOAD_ERR_SEGMENTS;
+
+    for (int i = 0; i < ehdr->phnum; i++) {
+        const elf32_phdr_t *p = &ph[i];
+        u32 addr = to_cached(p->paddr);
+
+        if (p->type != ELF_PT_LOAD || !p->memsz)
+            continue;
+        if (p->filesz > p->memsz || !in_mem(addr, p->memsz) ||
+            p->offset > file_size || p->filesz > file_size - p->offset)
+            return ELFLOAD_ERR_SEGMENTS;
+
+        if (p->filesz) {
+            int slot;
+            if (p->flags & ELF_PF_X) {
+                if (text == DOL_TEXT_MAX)
+                    return ELFLOAD_ERR_SEGMENTS;
+                slot = text++;
+            } else {
+                if (data == DOL_SECTIONS)
+                    return ELFLOAD_ERR_SEGMENTS;
+                slot = data++;
+            }
+            hdr->offset[slot] = p->offset;
+            hdr->addr[slot] = addr;
+            hdr->size[slot] = p->filesz;
+        }
+
+        if (p->memsz > p->filesz) {
+            u32 lo = addr + p->filesz, hi = addr + p->memsz;
+            if (bss_lo == bss_hi) {
+                bss_lo = lo;
+                bss_hi = hi;
+            } else {
+                bss_lo = lo < bss_lo ? lo : bss_lo;
+                bss_hi = hi > bss_hi ? hi : bss_hi;
+            }
+        }
+    }
+
+    // the stub clears the BSS after placing the sections, no segment data
+    // may be inside it, nor may two segments share memory
+    for (int i = 0; i < DOL_SECTIONS; i++) {
+        if (!hdr->size[i])
+            continue;
+        if (overlaps(hdr->addr[i], hdr->size[i], bss_lo, bss_hi))
+            return ELFLOAD_ERR_BSS;
+        for (int j = i + 1; j < DOL_SECTIONS; j++)
+            if (overlaps(hdr->addr[j], hdr->size[j], hdr->addr[i], hdr->addr[i] + hdr->size[i]))
+                return ELFLOAD_ERR_SEGMENTS;
+    }
+
+    hdr->bss_addr = bss_lo;
+    hdr->bss_size = bss_hi - bss_lo;
+    return ELFLOAD_OK;
+}
+
+u8 *elfload_load(const void *head, u32 head_len, u32 file_size,
+                 dolload_read_fn read, void *ctx, int *err) {
+    const elf32_ehdr_t *ehdr = head;
+    elf_source_t src = { head, head_len, read, ctx };
+    elf32_phdr_t ph[ELFLOAD_PHNUM_MAX];
+    dol_header_t hdr;
+    u8 *image;
+
+    if (source_read(&src, ehdr->phoff, ph, ehdr->phnum * sizeof(*ph))) {
+        *err = ELFLOAD_ERR_READ;
+        return NULL;
+    }
+
+    if ((*err = segments(ehdr, ph, file_size, &hdr)) != ELFLOAD_OK)
+        return NULL;
+
+    image = dolload_load(&hdr, source_read, &src, DOLLOAD_NO_FALLBACK);
+    if (!image)
+        *err = ELFLOAD_ERR_LOAD;
+    return image;
+}
@@ -0,0 +1,75 @@
+/*
+ * elfload.h
+ *
+ * Boots ELF32 big-endian PowerPC executables without converting them to a
+ * DOL first. The PT_LOAD segments are turned into the sections of a DOL
+ * header and go through dolload: segments in free memory are read straight
+ * to their physical address, the parts over the loader are staged for the
+ * stub. The zero-filled tails (p_memsz past p_filesz) become the BSS the
+ * stub clears, so they have to form one range with no segment data in it.
+ */
+
+#ifndef ELFLOAD_H_
+#define ELFLOAD_H_
+
+#include <gccore.h>
+
+#include "dolload/dolload.h"
+
+#define ELFLOAD_PHNUM_MAX	16
+
+// big-endian like the CPU
+typedef struct {
+    u8 ident[16];
+    u16 type;
+    u16 machine;
+    u32 version;
+    u32 entry;
+    u32 phoff;
+    u32 shoff;
+    u32 flags;
+    u16 ehsize;
+    u16 phentsize;
+    u16 phnum;
+    u16 shentsize;
+    u16 shnum;
+    u16 shstrndx;
+} elf32_ehdr_t;
+
+typedef struct {
+    u32 type;
+    u32 offset;
+    u32 vaddr;
+    u32 paddr;
+    u32 filesz;
+    u32 memsz;
+    u32 flags;
+    u32 align;
+} elf32_phdr_t;
+
+#define ELF_ET_EXEC	2
+#define ELF_EM_PPC	20
+#define ELF_PT_LOAD	1
+#define ELF_PF_X	1
+
+enum elfload_err {
+    ELFLOAD_OK = 0,
+    ELFLOAD_ERR_READ = -1,
+    ELFLOAD_ERR_SEGMENTS = -2,	// too many, overlapping or outside main memory
+    ELFLOAD_ERR_BSS = -3,		// zero-filled tails don't form one range
+    ELFLOAD_ERR_LOAD = -4,		// no room for the staged parts, or a read error
+};
+
+// returns 1 if 'ehdr' (the first bytes of a file of 'file_size' bytes) is
+// an ELF32 big-endian PowerPC executable
+int elfload_check(const elf32_ehdr_t *ehdr, u32 file_size);
+
+// Load the ELF whose first 'head_len' bytes are in 'head', the rest is read
+// through 'read' (increasing offsets, from 'head_len' on). Returns the
+// staged image to hand to the stub, or NULL with 'err' set. There is no
+// whole-file fallback for an ELF, everything is staged if nothing can be
+// placed directly.
+u8 *elfload_load(const void *head, u32 head_len, u32 file_size,
+                 dolload_read_fn read, void *ctx, int *err);
+
+#endif /* ELFLOAD_H_ */
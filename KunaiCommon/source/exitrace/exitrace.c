@@ -0,0 +1,110 @@
+/*
+ * exitrace.c
+ *
+ * The write index is only ever advanced with an atomic add, so recording
+ * never blocks and a slot is owned by whoever claimed it. Old entries are
+ * overwritten once the ring wraps.
+ */
+
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+#include <ogc/usbgecko.h>
+
+#include "exitrace.h"
+#include "geckolink/geckolink.h"
+
+#ifndef KUNAI_NO_EXITRACE
+
+static exitrace_entry ring[EXITRACE_ENTRIES];
+static u32 written;
+
+// device and speed of the current selection per EXI channel
+static u8 sel_dev[3];
+static u8 sel_speed[3];
+
+void exitrace_log(u8 chan, u8 op, const void *buf, u32 len, s32 result) {
+	u32 idx = __atomic_fetch_add(&written, 1, __ATOMIC_RELAXED) & (EXITRACE_ENTRIES - 1);
+	exitrace_entry *e = &ring[idx];
+
+	e->tb = (u32) gettime();
+	e->chan = chan;
+	e->dev = sel_dev[chan];
+	e->speed = sel_speed[chan];
+	e->op = op;
+	e->len = len < 0xFFFF ? len : 0xFFFF;
+	e->result = result;
+	e->data = 0;
+	if (buf)
+		memcpy(&e->data, buf, len < 4 ? len : 4);
+}
+
+s32 exitrace_lock(s32 chan, s32 dev) {
+	s32 ret = EXI_Lock(chan, dev, NULL);
+	sel_dev[chan] = dev;
+	exitrace_log(chan, EXITRACE_OP_LOCK, NULL, 0, ret);
+	return ret;
+}
+
+s32 exitrace_unlock(s32 chan) {
+	s32 ret = EXI_Unlock(chan);
+	exitrace_log(chan, EXITRACE_OP_UNLOCK, NULL, 0, ret);
+	return ret;
+}
+
+s32 exitrace_select(s32 chan, s32 dev, s32 speed) {
+	s32 ret = EXI_Select(chan, dev, speed);
+	sel_dev[chan] = dev;
+	sel_speed[chan] = speed;
+	exitrace_log(chan, EXITRACE_OP_SELECT, NULL, 0, ret);
+	return ret;
+}
+
+s32 exitrace_deselect(s32 chan) {
+	s32 ret = EXI_Deselect(chan);
+	exitrace_log(chan, EXITRACE_OP_DESELECT, NULL, 0, ret);
+	return ret;
+}
+
+u32 exitrace_export(exitrace_header *hdr, exitrace_entry *out, u32 first, u32 max) {
+	u32 end = __atomic_load_n(&written, __ATOMIC_RELAXED);
+	u32 count = end < EXITRACE_ENTRIES ? end : EXITRACE_ENTRIES;
+	u32 copied = 0;
+
+	for (u32 i = first; i < count && copied < max; i++)
+		out[copied++] = ring[(end - count + i) & (EXITRACE_ENTRIES - 1)];
+
+	if (hdr) {
+		hdr->magic = EXITRACE_MAGIC;
+		hdr->version = EXITRACE_VERSION;
+		hdr->entry_size = sizeof(exitrace_entry);
+		hdr->count = count;
+		hdr->tb_clock = TB_TIMER_CLOCK * 1000;
+	}
+	return copied;
+}
+
+void exitrace_clear(void) {
+	__atomic_store_n(&written, 0, __ATOMIC_RELAXED);
+}
+
+int exitrace_dump_gecko(s32 chan) {
+	exitrace_entry chunk[64];
+	exitrace_header hdr;
+	u32 first = 0, n;
+
+	if (!usb_isgeckoalive(chan))
+		return 0;
+
+	// without a PC reading, the Gecko stops taking bytes
+	exitrace_export(&hdr, chunk, 0, 0);
+	if (geckolink_send(chan, &hdr, sizeof(hdr), GECKOLINK_IDLE_MS) != GECKOLINK_OK)
+		return 0;
+	while (first < hdr.count && (n = exitrace_export(NULL, chunk, first, 64))) {
+		if (geckolink_send(chan, chunk, n * sizeof(exitrace_entry), GECKOLINK_IDLE_MS) != GECKOLINK_OK)
+			return 0;
+		first += n;
+	}
+	return 1;
+}
+
+#endif /* KUNAI_NO_EXITRACE */
@@ -0,0 +1,146 @@
+/*
+ * exitrace.h
+ *
+ * Fixed-size ring buffer recording every EXI transfer issued by the
+ * KunaiGC flash code. Recording is a handful of stores per transfer and
+ * stays enabled in release builds, build with -DKUNAI_NO_EXITRACE to
+ * compile the wrappers down to the plain libogc calls. Loops of small
+ * transfers go through exitrace_imm_run(), one entry for the whole run,
+ * so they neither pay for an entry per byte nor wrap the ring.
+ */
+
+#ifndef EXITRACE_H_
+#define EXITRACE_H_
+
+#include <gccore.h>
+
+#define EXITRACE_ENTRIES	1024	/* must be a power of two */
+#define EXITRACE_MAGIC		0x45585452	/* "EXTR" */
+#define EXITRACE_VERSION	1
+
+enum exitrace_op {
+	EXITRACE_OP_LOCK = 0,
+	EXITRACE_OP_UNLOCK,
+	EXITRACE_OP_SELECT,
+	EXITRACE_OP_DESELECT,
+	EXITRACE_OP_READ,
+	EXITRACE_OP_WRITE,
+	EXITRACE_OP_DMA_READ,
+	EXITRACE_OP_DMA_WRITE,
+};
+
+// one recorded operation, 16 bytes
+typedef struct {
+	u32 tb;		// lower 32 bits of the timebase after the operation
+	u8 chan;
+	u8 dev;
+	u8 speed;
+	u8 op;		// enum exitrace_op
+	u16 len;	// clipped to 0xFFFF
+	s16 result;	// EXI_Sync/EXI_Select/... return value
+	u32 data;	// first (up to) four bytes transferred
+} exitrace_entry;
+
+// dump header, followed by 'count' entries oldest first (big-endian)
+typedef struct {
+	u32 magic;
+	u16 version;
+	u16 entry_size;
+	u32 count;
+	u32 tb_clock;	// timebase ticks per second
+} exitrace_header;
+
+#ifndef KUNAI_NO_EXITRACE
+
+void exitrace_log(u8 chan, u8 op, const void *buf, u32 len, s32 result);
+
+s32 exitrace_lock(s32 chan, s32 dev);
+s32 exitrace_unlock(s32 chan);
+s32 exitrace_select(s32 chan, s32 dev, s32 speed);
+s32 exitrace_deselect(s32 chan);
+
+// EXI_Imm followed by EXI_Sync, returns the EXI_Sync result
+static inline
+s32 exitrace_imm(s32 chan, void *buf, u32 len, u32 mode) {
+	s32 ret;
+	EXI_Imm(chan, buf, len, mode, NULL);
+	ret = EXI_Sync(chan);
+	exitrace_log(chan, mode == EXI_READ ? EXITRACE_OP_READ : EXITRACE_OP_WRITE, buf, len, ret);
+	return ret;
+}
+
+// EXI_Dma followed by EXI_Sync, cache maintenance is up to the caller
+static inline
+s32 exitrace_dma(s32 chan, void *buf, u32 len, u32 mode) {
+	s32 ret;
+	EXI_Dma(chan, buf, len, mode, NULL);
+	ret = EXI_Sync(chan);
+	exitrace_log(chan, mode == EXI_READ ? EXITRACE_OP_DMA_READ : EXITRACE_OP_DMA_WRITE, buf, len, ret);
+	return ret;
+}
+
+// 'len' bytes in immediate transfers of up to 'step' bytes, logged as one
+// entry with the total length. Stops at the first failing EXI_Sync.
+static inline
+s32 exitrace_imm_run(s32 chan, void *buf, u32 len, u32 step, u32 mode) {
+	u8 *p = buf;
+	s32 ret = 1;
+	for (u32 n; len && ret > 0; p += n, len -= n) {
+		n = len < step ? len : step;
+		EXI_Imm(chan, p, n, mode, NULL);
+		ret = EXI_Sync(chan);
+	}
+	exitrace_log(chan, mode == EXI_READ ? EXITRACE_OP_READ : EXITRACE_OP_WRITE, buf, p - (u8 *) buf, ret);
+	return ret;
+}
+
+// copy up to 'max' entries starting at the 'first' oldest one, fills 'hdr'
+// (if given) for the whole buffer and returns the number of entries copied
+u32 exitrace_export(exitrace_header *hdr, exitrace_entry *out, u32 first, u32 max);
+void exitrace_clear(void);
+
+// stream header and entries to a USB Gecko, returns 0 if none is present
+// or nothing reads from it for GECKOLINK_IDLE_MS
+int exitrace_dump_gecko(s32 chan);
+
+#else
+
+#define exitrace_lock(chan, dev)		EXI_Lock(chan, dev, NULL)
+#define exitrace_unlock(chan)			EXI_Unlock(chan)
+#define exitrace_select(chan, dev, speed)	EXI_Select(chan, dev, speed)
+#define exitrace_deselect(chan)			EXI_Deselect(chan)
+
+static inline
+s32 exitrace_imm(s32 chan, void *buf, u32 len, u32 mode) {
+	EXI_Imm(chan, buf, len, mode, NULL);
+	return EXI_Sync(chan);
+}
+
+static inline
+s32 exitrace_dma(s32 chan, void *buf, u32 len, u32 mode) {
+	EXI_Dma(chan, buf, len, mode, NULL);
+	return EXI_Sync(chan);
+}
+
+static inline
+s32 exitrace_imm_run(s32 chan, void *buf, u32 len, u32 step, u32 mode) {
+	u8 *p = buf;
+	s32 ret = 1;
+	for (u32 n; len && ret > 0; p += n, len -= n) {
+		n = len < step ? len : step;
+		EXI_Imm(chan, p, n, mode, NULL);
+		ret = EXI_Sync(chan);
+	}
+	return ret;
+}
+
+static inline
+u32 exitrace_export(exitrace_header *hdr, exitrace_entry *out, u32 first, u32 max) { return 0; }
+static inline
+void exitrace_clear(void) { }
+static inline
+int exitrace_dump_gecko(s32 chan) { return 0; }
+
+#endif /* KUNAI_NO_EXITRACE */
+
+#endif /* EXITRACE_H_ */
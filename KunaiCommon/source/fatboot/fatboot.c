@@ -0,0 +1,224 @@
+/*
+ * fatboot.c
+ *
+ * f_read() stops every multi-sector read at a cluster boundary and walks the
+ * FAT through its one sector window to find the next cluster. For a boot
+ * file that is read once from start to end, build the fast seek link map
+ * (CLMT) up front instead and read each fragment in one go.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "fatboot.h"
+#include "fatfs/diskio.h"
+#include "lfs/lfs_util.h"
+
+static DWORD clmt[FATBOOT_CLMT_SIZE];
+
+// file fatboot_pread() can map without FatFs, and whether it is a contiguous
+// exFAT file that needs no link map
+static FIL *mapped;
+static int contiguous;
+
+// Read 'size' bytes from the physically contiguous sectors at 'sect' with a
+// single disk_read, the buffer has room for the rest of the last sector
+static FRESULT read_run(FATFS *fs, LBA_t sect, BYTE *p, UINT size)
+{
+    UINT count = (size + FF_MAX_SS - 1) / FF_MAX_SS;
+
+    if (count && disk_read(fs->pdrv, p, sect, count) != RES_OK)
+        return FR_DISK_ERR;
+    return FR_OK;
+}
+
+FRESULT fatboot_map(FIL *fp)
+{
+    FATFS *fs = fp->obj.fs;
+
+    mapped = NULL;
+    contiguous = 0;
+
+#if FF_FS_EXFAT
+    // exFAT flags files stored in one piece (NoFatChain), there is no chain
+    // to map, the start cluster alone gives the location of the whole file
+    if (fs->fs_type == FS_EXFAT && (fp->obj.stat & 3) == 2 && fp->obj.sclust >= 2)
+    {
+        contiguous = 1;
+        mapped = fp;
+        return FR_OK;
+    }
+#else
+    (void) fs;
+#endif
+
+    clmt[0] = FATBOOT_CLMT_SIZE;
+    fp->cltbl = clmt;
+    FRESULT res = f_lseek(fp, CREATE_LINKMAP);
+    fp->cltbl = NULL;
+    if (res == FR_OK)
+        mapped = fp;
+    return res;
+}
+
+// Sector holding byte 'ofs' of the mapped file, '*avail' is set to the number
+// of physically contiguous sectors from there on. Returns 0 past the map.
+static LBA_t map_sector(FIL *fp, FSIZE_t ofs, DWORD *avail)
+{
+    FATFS *fs = fp->obj.fs;
+    DWORD cl = (DWORD) (ofs / ((DWORD) fs->csize * FF_MAX_SS));
+    DWORD sect = (DWORD) (ofs / FF_MAX_SS) & (fs->csize - 1);
+
+    if (contiguous)
+    {
+        *avail = ~(DWORD) 0;
+        return fs->database + (LBA_t) fs->csize * (fp->obj.sclust - 2 + cl) + sect;
+    }
+
+    // clmt[1..]: pairs of (fragment length in clusters, first cluster)
+    for (DWORD *frag = &clmt[1]; frag[0]; frag += 2)
+    {
+        if (cl < frag[0])
+        {
+            *avail = (frag[0] - cl) * fs->csize - sect;
+            return fs->database + (LBA_t) fs->csize * (frag[1] - 2 + cl) + sect;
+        }
+        cl -= frag[0];
+    }
+    return 0;
+}
+
+FRESULT fatboot_pread(FIL *fp, FSIZE_t ofs, void *buf, UINT size)
+{
+    static BYTE bounce[FF_MAX_SS] __attribute__((aligned(32)));
+    FATFS *fs = fp->obj.fs;
+    BYTE *p = buf;
+
+    if (fp != mapped)
+    {
+        UINT got;
+        FRESULT res = f_lseek(fp, ofs);
+        if (res == FR_OK)
+            res = f_read(fp, buf, size, &got);
+        if (res == FR_OK && got != size)
+            res = FR_INT_ERR;
+        return res;
+    }
+
+    while (size)
+    {
+        DWORD avail;
+        LBA_t sect = map_sector(fp, ofs, &avail);
+        UINT skip = (UINT) (ofs % FF_MAX_SS);
+        UINT n;
+
+        if (!sect)
+            return FR_INT_ERR;
+
+        if (skip || size < FF_MAX_SS)
+        {
+            // partial sector, single sector reads go through the disk cache,
+            // so a sector shared by two ranges is only read once
+            n = FF_MAX_SS - skip;
+            if (n > size)
+                n = size;
+            if (disk_read(fs->pdrv, bounce, sect, 1) != RES_OK)
+                return FR_DISK_ERR;
+            memcpy(p, bounce + skip, n);
+        }
+        else
+        {
+            DWORD count = size / FF_MAX_SS;
+            if (count > avail)
+                count = avail;
+            n = count * FF_MAX_SS;
+            if (disk_read(fs->pdrv, p, sect, count) != RES_OK)
+                return FR_DISK_ERR;
+        }
+
+        p += n;
+        ofs += n;
+        size -= n;
+    }
+
+    return FR_OK;
+}
+
+FRESULT fatboot_read(FIL *fp, void *buf, UINT size)
+{
+    FATFS *fs = fp->obj.fs;
+    BYTE *p = buf;
+    UINT _;
+
+    if (fp->fptr != 0 || fatboot_map(fp) != FR_OK)
+        return f_read(fp, buf, size, &_);
+
+    if (contiguous)
+    {
+        if (size > fp->obj.objsize)
+            return f_read(fp, buf, size, &_);
+        return read_run(fs, fs->database + (LBA_t) fs->csize * (fp->obj.sclust - 2), p, size);
+    }
+
+    UINT csize = (UINT) fs->csize * FF_MAX_SS;
+    for (DWORD *frag = &clmt[1]; size && frag[0]; frag += 2)
+    {
+        LBA_t sect = fs->database + (LBA_t) fs->csize * (frag[1] - 2);
+        UINT run = frag[0] * csize;
+        if (run > size)
+            run = size;
+
+        FRESULT res = read_run(fs, sect, p, run);
+        if (res != FR_OK)
+            return res;
+        p += run;
+        size -= run;
+    }
+
+    return size ? FR_INT_ERR : FR_OK;
+}
+
+FRESULT fatboot_locate(FIL *fp, fatboot_loc_t *loc)
+{
+    FATFS *fs = fp->obj.fs;
+
+    // f_open() leaves the window on the sector the entry was found in
+    if (fs->winsect > 0xFFFFFFFF || fp->obj.objsize > 0xFFFFFFFF)
+        return FR_INVALID_PARAMETER;
+    loc->dir_sect = fs->winsect;
+    loc->dir_crc = lfs_crc(0xFFFFFFFF, fs->win, FF_MAX_SS);
+    loc->sclust = fp->obj.sclust;
+    loc->size = fp->obj.objsize;
+    loc->stat = fp->obj.stat;
+
+    // only reads the boot sector, no search for the label entry
+    return f_getlabel("", NULL, &loc->vsn);
+}
+
+FRESULT fatboot_reopen(FATFS *fs, FIL *fp, const fatboot_loc_t *loc)
+{
+    BYTE sect[FF_MAX_SS];
+    DWORD vsn;
+
+    FRESULT res = f_getlabel("", NULL, &vsn);
+    if (res != FR_OK)
+        return res;
+    if (vsn != loc->vsn)
+        return FR_NO_FILE;
+
+    if (disk_read(fs->pdrv, sect, loc->dir_sect, 1) != RES_OK)
+        return FR_DISK_ERR;
+    if (lfs_crc(0xFFFFFFFF, sect, FF_MAX_SS) != loc->dir_crc)
+        return FR_NO_FILE;
+
+    // what f_open(FA_READ) would have set up
+    memset(fp, 0, sizeof(*fp));
+    fp->obj.fs = fs;
+    fp->obj.id = fs->id;
+    fp->obj.sclust = loc->sclust;
+    fp->obj.objsize = loc->size;
+    fp->obj.stat = loc->stat;
+    fp->flag = FA_READ;
+
+    return FR_OK;
+}
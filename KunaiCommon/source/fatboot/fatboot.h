@@ -0,0 +1,55 @@
+/*
+ * fatboot.h
+ *
+ * Bulk file reads for booting from FAT/exFAT volumes.
+ */
+
+#ifndef FATBOOT_H_
+#define FATBOOT_H_
+
+#include "fatfs/ff.h"
+
+// buffer size needed to read 'size' bytes, reads end on a sector boundary
+#define FATBOOT_BUF_SIZE(size) (((size) + FF_MAX_SS - 1) & ~(FF_MAX_SS - 1))
+
+// link map entries, enough for FATBOOT_CLMT_SIZE/2 - 1 fragments
+#define FATBOOT_CLMT_SIZE 256
+
+// Where a file was found, enough to open it again without a directory walk
+typedef struct {
+    DWORD vsn;          // volume serial number
+    DWORD dir_sect;     // sector holding the file's directory entry
+    DWORD dir_crc;      // CRC32 of that sector
+    DWORD sclust;       // first cluster
+    DWORD size;
+    BYTE stat;          // exFAT allocation status, 2 if contiguous
+} fatboot_loc_t;
+
+// Fill 'loc' for a file f_open() just returned, before anything else moves
+// the FatFs sector window off its directory entry.
+FRESULT fatboot_locate(FIL *fp, fatboot_loc_t *loc);
+
+// Open the file 'loc' describes for reading. Only the boot sector and the
+// directory entry sector are read: if the volume serial number differs or
+// anything in that sector changed (the entry holds size, first cluster and
+// timestamps), FR_NO_FILE is returned and the file has to be opened by path.
+FRESULT fatboot_reopen(FATFS *fs, FIL *fp, const fatboot_loc_t *loc);
+
+// Read the first 'size' bytes of an opened file into 'buf'. Every run of
+// physically contiguous clusters is fetched with a single disk_read straight
+// into 'buf', which must be 32 byte aligned and FATBOOT_BUF_SIZE(size)
+// bytes long. exFAT files flagged contiguous are read without mapping at
+// all. Falls back to f_read if the file is too fragmented for the link map.
+FRESULT fatboot_read(FIL *fp, void *buf, UINT size);
+
+// Map an opened file for fatboot_pread(), returns FR_NOT_ENOUGH_CORE if it is
+// too fragmented for the link map. Only the last mapped file is remembered.
+FRESULT fatboot_map(FIL *fp);
+
+// Read 'size' bytes at offset 'ofs' into 'buf', which needs no alignment and
+// no slack: whole sectors are read straight into it, the partial ones at
+// either end through a bounce sector. Uses f_lseek/f_read for files that
+// weren't mapped.
+FRESULT fatboot_pread(FIL *fp, FSIZE_t ofs, void *buf, UINT size);
+
+#endif /* FATBOOT_H_ */
@@ -0,0 +1,356 @@
+/*
+ * geckolink.c
+ *
+ * Frames are received straight into their window slot and only marked
+ * valid once the CRC matches. A damaged header is found again by scanning
+ * for the frame magic, so a dropped byte costs the frames it hit and not
+ * the transfer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "geckolink.h"
+#include "lfs/lfs_util.h"
+
+#define FRAME_HDR_SIZE	16
+#define ACK_SIZE	20
+
+static u32 get32(const u8 *p) {
+    return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void put32(u8 *p, u32 v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+int geckolink_send(s32 channel, const void *buf, u32 len, u32 idle_ms) {
+    const u8 *p = buf;
+    u64 last = gettime();
+
+    while (len) {
+        int n = usb_sendbuffer_safe_ex(channel, p, len, GECKOLINK_POLL_RETRIES);
+        if (n > 0) {
+            p += n;
+            len -= n;
+            last = gettime();
+        } else if (ticks_to_millisecs(gettime() - last) >= idle_ms) {
+            return GECKOLINK_ERR_TIMEOUT;
+        }
+    }
+
+    return GECKOLINK_OK;
+}
+
+static int send_ack(geckolink_t *gl, int type) {
+    u8 ack[ACK_SIZE];
+    int err;
+
+    ack[0] = GECKOLINK_ACK_MAGIC >> 8;
+    ack[1] = GECKOLINK_ACK_MAGIC & 0xff;
+    ack[2] = type;
+    ack[3] = GECKOLINK_WINDOW;
+    put32(ack + 4, gl->next);
+    put32(ack + 8, gl->have);
+    ack[12] = GECKOLINK_FRAME_MAX >> 8;
+    ack[13] = GECKOLINK_FRAME_MAX & 0xff;
+    ack[14] = 0;
+    ack[15] = 0;
+    put32(ack + 16, ~lfs_crc(0xffffffff, ack, 16));
+
+    if ((err = geckolink_send(gl->channel, ack, sizeof(ack), GECKOLINK_IDLE_MS)) != GECKOLINK_OK)
+        return err;
+    gl->acked = gl->next;
+    gl->ack_time = gettime();
+    return GECKOLINK_OK;
+}
+
+// one NAK per missing frame, if the resend is lost too the link goes quiet
+// and gets nudged
+static int send_nak(geckolink_t *gl) {
+    if (gl->nak != gl->next + 1) {
+        gl->nak = gl->next + 1;
+        return send_ack(gl, GECKOLINK_NAK);
+    }
+    return GECKOLINK_OK;
+}
+
+// the PC may have missed the READY ack or a NAK, repeat the one that applies
+static int nudge(geckolink_t *gl) {
+    return send_ack(gl, gl->next || gl->have ? GECKOLINK_NAK : GECKOLINK_ACK_READY);
+}
+
+// Receive 'len' bytes, fails after 'idle_ms' without a byte arriving
+static int recv_idle(geckolink_t *gl, u8 *p, u32 len, u32 idle_ms) {
+    u64 last = gettime();
+
+    while (len) {
+        int n = usb_recvbuffer_safe_ex(gl->channel, p, len, GECKOLINK_POLL_RETRIES);
+        if (n > 0) {
+            p += n;
+            len -= n;
+            last = gettime();
+        } else if (ticks_to_millisecs(gettime() - last) >= idle_ms) {
+            return GECKOLINK_ERR_TIMEOUT;
+        }
+    }
+
+    return GECKOLINK_OK;
+}
+
+static int recv_frame(geckolink_t *gl) {
+    u8 hdr[FRAME_HDR_SIZE];
+    u64 quiet = gettime();
+    int got = 0;
+    int err;
+
+    // scan for the frame magic, a lost byte shifts everything after it
+    while (got < 2 || hdr[0] != (GECKOLINK_FRAME_MAGIC >> 8) ||
+           hdr[1] != (GECKOLINK_FRAME_MAGIC & 0xff)) {
+        u8 b;
+        if (recv_idle(gl, &b, 1, GECKOLINK_NUDGE_MS) != GECKOLINK_OK) {
+            if (ticks_to_millisecs(gettime() - quiet) >= GECKOLINK_IDLE_MS)
+                return GECKOLINK_ERR_TIMEOUT;
+            if ((err = nudge(gl)) != GECKOLINK_OK)
+                return err;
+            continue;
+        }
+        hdr[0] = hdr[1];
+        hdr[1] = b;
+        got++;
+        quiet = gettime();
+    }
+    if ((err = recv_idle(gl, hdr + 2, FRAME_HDR_SIZE - 2, GECKOLINK_IDLE_MS)) != GECKOLINK_OK)
+        return err;
+
+    u32 seq = get32(hdr + 4);
+    u32 len = get32(hdr + 8);
+    if (hdr[2] != GECKOLINK_FRAME_DATA || len > GECKOLINK_FRAME_MAX)
+        return send_nak(gl);
+
+    // frames already handed out or beyond the window are read to the
+    // spare slot and dropped
+    u32 ofs = seq - gl->next;
+    int slot = GECKOLINK_WINDOW;
+    if (ofs < GECKOLINK_WINDOW && !(gl->have & (1u << ofs)))
+        slot = seq % GECKOLINK_WINDOW;
+
+    u8 *data = gl->slots + slot * GECKOLINK_FRAME_MAX;
+    if ((err = recv_idle(gl, data, len, GECKOLINK_IDLE_MS)) != GECKOLINK_OK)
+        return err;
+    if (~lfs_crc(lfs_crc(0xffffffff, hdr, 12), data, len) != get32(hdr + 12))
+        return send_nak(gl);
+    if (slot == GECKOLINK_WINDOW)
+        return GECKOLINK_OK;
+
+    gl->have |= 1u << ofs;
+    gl->len[slot] = len;
+    gl->last[slot] = hdr[3] & GECKOLINK_FLAG_LAST;
+
+    // the FIFO keeps the order, anything missing before this one was lost
+    u32 before = (1u << ofs) - 1;
+    if ((gl->have & before) != before)
+        return send_nak(gl);
+    return GECKOLINK_OK;
+}
+
+// hand out the next 'len' bytes of the stream in order
+static int read_stream(geckolink_t *gl, u8 *p, u32 len) {
+    while (len) {
+        int slot = gl->next % GECKOLINK_WINDOW;
+
+        if (!(gl->have & 1)) {
+            int err = recv_frame(gl);
+            if (err != GECKOLINK_OK)
+                return err;
+            continue;
+        }
+
+        u32 n = gl->len[slot] - gl->pos;
+        if (n > len)
+            n = len;
+        memcpy(p, gl->slots + slot * GECKOLINK_FRAME_MAX + gl->pos, n);
+        p += n;
+        len -= n;
+        gl->pos += n;
+
+        if (gl->pos == gl->len[slot]) {
+            int last = gl->last[slot];
+
+            gl->pos = 0;
+            gl->have >>= 1;
+            gl->next++;
+            if (last || gl->next - gl->acked >= GECKOLINK_WINDOW / 2) {
+                int err = send_ack(gl, GECKOLINK_ACK);
+                if (err != GECKOLINK_OK)
+                    return err;
+            }
+            if (last && len)
+                return GECKOLINK_ERR_PROTO;
+        }
+    }
+
+    return GECKOLINK_OK;
+}
+
+int geckolink_connect(geckolink_t *gl, s32 channel) {
+    u64 start = gettime(), sent = start;
+    u8 data;
+
+    memset(gl, 0, sizeof(*gl));
+    gl->channel = channel;
+    gl->pending = -1;
+
+    if (!usb_isgeckoalive(channel))
+        return GECKOLINK_ERR_ABSENT;
+
+    usb_flush(channel);
+
+    kprintf("Sending ready\n");
+    data = GC_READY;
+    if (geckolink_send(channel, &data, 1, GECKOLINK_HANDSHAKE_MS) != GECKOLINK_OK) {
+        gl->state = GECKOLINK_FAILED;
+        return GECKOLINK_ERR_TIMEOUT;
+    }
+    gl->state = GECKOLINK_HELLO;
+
+    kprintf("Waiting for ack...\n");
+    while (gl->state == GECKOLINK_HELLO || gl->state == GECKOLINK_LEGACY_OK) {
+        u64 now = gettime();
+        int got = usb_recvbuffer_safe_ex(channel, &data, 1, GECKOLINK_POLL_RETRIES) == 1;
+
+        if (ticks_to_millisecs(now - start) >= GECKOLINK_HANDSHAKE_MS) {
+            gl->state = GECKOLINK_FAILED;
+            return GECKOLINK_ERR_TIMEOUT;
+        }
+
+        switch (gl->state) {
+        case GECKOLINK_HELLO:
+            if (!got)
+                break;
+            if (data == PC_FRAMED) {
+                gl->state = GECKOLINK_FRAMED;
+            } else if (data == PC_OK) {
+                gl->state = GECKOLINK_LEGACY;
+            } else if (data == PC_READY) {
+                kprintf("Respond with OK\n");
+                data = GC_OK;
+                // bounded, a GC_OK that doesn't go out is repeated below
+                geckolink_send(channel, &data, 1, GECKOLINK_RETRY_MS);
+                sent = now;
+                gl->state = GECKOLINK_LEGACY_OK;
+            }
+            break;
+
+        case GECKOLINK_LEGACY_OK:
+            // the PC sometimes isn't listening yet when GC_OK arrives, send
+            // it again until the size starts coming in
+            if (got) {
+                gl->pending = data;
+                gl->state = GECKOLINK_LEGACY;
+            } else if (ticks_to_millisecs(now - sent) >= GECKOLINK_RETRY_MS) {
+                data = GC_OK;
+                geckolink_send(channel, &data, 1, GECKOLINK_RETRY_MS);
+                sent = now;
+            }
+            break;
+        }
+    }
+
+    return gl->state;
+}
+
+int geckolink_recv(geckolink_t *gl, void *buf, u32 len) {
+    u8 *p = buf;
+    int err;
+
+    if (len && gl->pending >= 0) {
+        *p++ = gl->pending;
+        gl->pending = -1;
+        len--;
+    }
+    if ((err = recv_idle(gl, p, len, GECKOLINK_IDLE_MS)) != GECKOLINK_OK)
+        gl->state = GECKOLINK_FAILED;
+    return err;
+}
+
+int geckolink_begin(geckolink_t *gl) {
+    u8 x[sizeof(geckolink_xfer_t)];
+    int err;
+
+    gl->slots = memalign(32, (GECKOLINK_WINDOW + 1) * GECKOLINK_FRAME_MAX);
+    if (!gl->slots)
+        return GECKOLINK_ERR_NOMEM;
+
+    if ((err = send_ack(gl, GECKOLINK_ACK_READY)) != GECKOLINK_OK ||
+        (err = read_stream(gl, x, sizeof(x))) != GECKOLINK_OK) {
+        gl->state = GECKOLINK_FAILED;
+        return err;
+    }
+
+    gl->xfer.magic = get32(x);
+    gl->xfer.size = get32(x + 4);
+    gl->xfer.mode = get32(x + 8);
+    gl->xfer.crc = get32(x + 12);
+    memcpy(gl->xfer.name, x + 16, sizeof(gl->xfer.name));
+    gl->xfer.name[sizeof(gl->xfer.name) - 1] = '\0';
+
+    if (gl->xfer.magic != GECKOLINK_XFER_MAGIC) {
+        gl->state = GECKOLINK_FAILED;
+        return GECKOLINK_ERR_PROTO;
+    }
+
+    gl->done = 0;
+    gl->crc = 0xffffffff;
+    return GECKOLINK_OK;
+}
+
+int geckolink_read(geckolink_t *gl, void *buf, u32 len) {
+    int err;
+
+    if (len > gl->xfer.size - gl->done)
+        return GECKOLINK_ERR_PROTO;
+    if ((err = read_stream(gl, buf, len)) != GECKOLINK_OK) {
+        gl->state = GECKOLINK_FAILED;
+        return err;
+    }
+
+    gl->crc = lfs_crc(gl->crc, buf, len);
+    gl->done += len;
+    return len;
+}
+
+void geckolink_pump(geckolink_t *gl, u64 until) {
+    u32 full = GECKOLINK_WINDOW >= 32 ? ~0u : (1u << GECKOLINK_WINDOW) - 1;
+
+    if (ticks_to_millisecs(gettime() - gl->ack_time) >= GECKOLINK_NUDGE_MS &&
+        send_ack(gl, GECKOLINK_ACK) != GECKOLINK_OK) {
+        gl->state = GECKOLINK_FAILED;
+        return;
+    }
+
+    // only start on a frame that is already coming in, so a quiet link
+    // never holds the caller much past 'until'
+    while (gettime() < until && (gl->have & full) != full) {
+        if (usb_checkrecv(gl->channel) && recv_frame(gl) != GECKOLINK_OK)
+            break;
+    }
+}
+
+int geckolink_end(geckolink_t *gl) {
+    free(gl->slots);
+    gl->slots = NULL;
+
+    if (gl->state == GECKOLINK_FAILED)
+        return GECKOLINK_ERR_PROTO;
+    if (gl->done != gl->xfer.size || ~gl->crc != gl->xfer.crc) {
+        gl->state = GECKOLINK_FAILED;
+        return GECKOLINK_ERR_CRC;
+    }
+    gl->state = GECKOLINK_DONE;
+    return GECKOLINK_OK;
+}
@@ -0,0 +1,140 @@
+/*
+ * geckolink.h
+ *
+ * Framed transfers over a USB Gecko, sent by buildtools/geckosend.py.
+ * The console announces itself with GC_READY. usb-load answers PC_READY or
+ * PC_OK and gets the old raw stream. geckosend.py answers PC_FRAMED and
+ * the console replies with a READY ack that names its window. From then on
+ * the PC streams frames without waiting for each one:
+ *
+ *   frame  "KG" type flags seq len crc     followed by 'len' data bytes
+ *   ack    "KA" type window next have frame_max reserved crc
+ *
+ * 'crc' is a zlib CRC32 over the frame header before it plus the data, or
+ * over the ack before it. 'seq' counts frames from 0. The console buffers
+ * up to 'window' frames from 'next' on and hands them out in order. 'have'
+ * has bit i set for frame next + i already buffered, so the PC only resends
+ * the gaps. Acks go out every window / 2 frames consumed, after the last
+ * frame, and right away (as a NAK) on a bad CRC or a gap.
+ *
+ * The frames carry one stream: a geckolink_xfer_t, then 'size' bytes of
+ * file. All fields are big-endian.
+ *
+ * Nothing waits without a deadline. The PC has GECKOLINK_HANDSHAKE_MS to
+ * answer GC_READY, so a Gecko without a sender costs that much boot time.
+ * Once a transfer runs, GECKOLINK_IDLE_MS of silence ends it, and so does
+ * an ack the Gecko won't take for as long, with no PC reading. Lost bytes
+ * are recovered by resynchronising instead of sleeping: GC_OK is sent
+ * again while the PC stays quiet after it, and a quiet framed link is
+ * nudged with a READY or NAK every GECKOLINK_NUDGE_MS.
+ */
+
+#ifndef GECKOLINK_H_
+#define GECKOLINK_H_
+
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+
+#define PC_READY	0x80
+#define PC_OK		0x81
+#define PC_FRAMED	0x82
+#define GC_READY	0x88
+#define GC_OK		0x89
+
+#define GECKOLINK_FRAME_MAGIC	0x4B47	/* "KG" */
+#define GECKOLINK_ACK_MAGIC	0x4B41	/* "KA" */
+#define GECKOLINK_XFER_MAGIC	0x4B475458	/* "KGTX" */
+
+#ifndef GECKOLINK_WINDOW
+#define GECKOLINK_WINDOW	16	/* frames, at most 32 */
+#endif
+#define GECKOLINK_FRAME_MAX	4096
+
+#define GECKOLINK_HANDSHAKE_MS	500
+#define GECKOLINK_RETRY_MS	50	/* GC_OK repeat interval */
+#define GECKOLINK_IDLE_MS	2000
+#define GECKOLINK_NUDGE_MS	250
+#define GECKOLINK_POLL_RETRIES	1000	/* byte polls per usb_recvbuffer_safe_ex */
+
+#define GECKOLINK_FRAME_DATA	1
+#define GECKOLINK_FLAG_LAST	0x01
+
+#define GECKOLINK_ACK_READY	1
+#define GECKOLINK_ACK		2
+#define GECKOLINK_NAK		3
+
+#define GECKOLINK_MODE_BOOT	0
+#define GECKOLINK_MODE_INSTALL	1	/* into LittleFS as 'name' */
+
+typedef struct {
+    u32 magic;
+    u32 size;			// file bytes after this header
+    u32 mode;
+    u32 crc;			// zlib CRC32 of the file
+    char name[48];		// file name for GECKOLINK_MODE_INSTALL
+} geckolink_xfer_t;
+
+enum geckolink_state {
+    GECKOLINK_IDLE = 0,
+    GECKOLINK_HELLO,		// GC_READY sent, waiting for the PC
+    GECKOLINK_LEGACY_OK,	// GC_OK sent, waiting for the size
+    GECKOLINK_LEGACY,		// usb-load, a u32 size and the raw file follow
+    GECKOLINK_FRAMED,		// geckosend.py, frames follow
+    GECKOLINK_DONE,
+    GECKOLINK_FAILED,
+};
+
+typedef struct {
+    s32 channel;
+    int state;			// enum geckolink_state
+    int pending;		// first size byte, read in GECKOLINK_LEGACY_OK, or -1
+    u32 next;			// sequence of the next frame to hand out
+    u32 acked;			// 'next' of the last ack sent
+    u32 have;			// bit i: frame next + i is buffered
+    u32 nak;			// 'next' a NAK was last sent for, + 1
+    u64 ack_time;		// when the last ack went out
+    u8 *slots;			// GECKOLINK_WINDOW + 1 frames, the last one for discards
+    u16 len[GECKOLINK_WINDOW];
+    u8 last[GECKOLINK_WINDOW];
+    u32 pos;			// read position in frame 'next'
+    geckolink_xfer_t xfer;
+    u32 done;			// file bytes read
+    u32 crc;
+} geckolink_t;
+
+enum geckolink_err {
+    GECKOLINK_OK = 0,
+    GECKOLINK_ERR_ABSENT = -1,
+    GECKOLINK_ERR_PROTO = -2,
+    GECKOLINK_ERR_NOMEM = -3,
+    GECKOLINK_ERR_CRC = -4,
+    GECKOLINK_ERR_TIMEOUT = -5,
+};
+
+// Send 'len' bytes on 'channel', GECKOLINK_ERR_TIMEOUT after 'idle_ms'
+// without the Gecko taking a byte
+int geckolink_send(s32 channel, const void *buf, u32 len, u32 idle_ms);
+
+// Handshake with the PC on 'channel', returns GECKOLINK_LEGACY,
+// GECKOLINK_FRAMED or an error within GECKOLINK_HANDSHAKE_MS
+int geckolink_connect(geckolink_t *gl, s32 channel);
+
+// read 'len' raw bytes of a GECKOLINK_LEGACY transfer
+int geckolink_recv(geckolink_t *gl, void *buf, u32 len);
+
+// start a framed transfer, fills gl->xfer
+int geckolink_begin(geckolink_t *gl);
+
+// read the next 'len' bytes of the file, returns 'len' or an error
+int geckolink_read(geckolink_t *gl, void *buf, u32 len);
+
+// Receive frames ahead into the window until 'until', for time the caller
+// would otherwise spend waiting on something else. Acks the PC every
+// GECKOLINK_NUDGE_MS meanwhile, so a slow consumer isn't taken for a
+// dead one.
+void geckolink_pump(geckolink_t *gl, u64 until);
+
+// check the whole file arrived intact and release the frame buffers
+int geckolink_end(geckolink_t *gl);
+
+#endif /* GECKOLINK_H_ */
@@ -0,0 +1,258 @@
+/*
+ * kunaigc.c
+ *
+ *  Created on: Jul 11, 2022
+ *      Author: mancloud
+ */
+
+
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "kunaigc.h"
+
+// variables used by the filesystem
+lfs_t lfs;
+lfs_file_t lfs_file;
+
+// inline files are stored up to block_size/8 and must fit into the cache
+#define KUNAI_CACHE_MIN (KUNAI_BLOCK_SIZE / 8)
+
+// configuration of the filesystem, filled in by kunai_lfs_config()
+struct lfs_config cfg;
+
+// Build the LittleFS configuration for the detected chip. Block and program
+// sizes are fixed by the on-flash format, cache and lookahead only affect
+// RAM use and speed and are picked per profile:
+//  - BOOT:    smallest cache that still holds an inline file (block_size/8),
+//             the payload read bypasses the cache anyway
+//  - DEFAULT: eight pages, what the menu and small files use
+//  - BULK:    a whole block of cache and a lookahead bitmap covering the
+//             entire chip, so installs never rescan for free blocks
+// The cache is halved until everything fits into a sixteenth of the arena.
+int kunai_lfs_config(struct lfs_config *c, uint32_t jedec_id, int profile) {
+    uint8_t capacity = jedec_id & 0xFF;
+
+    // W25Q 0x14 (1MiB) up to 0x19 (32MiB), everything else is a bad read
+    if (capacity < 0x14 || capacity > 0x19)
+        return LFS_ERR_INVAL;
+
+    memset(c, 0, sizeof(*c));
+
+    // block device operations
+    c->read  = kunai_read;
+    c->prog  = kunai_write;
+    c->erase = kunai_erase;
+    c->sync  = kunai_sync;
+
+    // block device configuration
+    c->read_size = 4;
+    c->prog_size = W25Q80BV_PAGE_SIZE;
+    c->block_size = KUNAI_BLOCK_SIZE;
+    c->block_count = ((1UL << capacity) - KUNAI_OFFS) / KUNAI_BLOCK_SIZE;
+    c->block_cycles = 500;
+
+    switch (profile) {
+    case KUNAI_LFS_PROFILE_BOOT:
+        c->cache_size = KUNAI_CACHE_MIN;
+        c->lookahead_size = 16;
+        break;
+    case KUNAI_LFS_PROFILE_BULK:
+        c->cache_size = KUNAI_BLOCK_SIZE;
+        c->lookahead_size = ((c->block_count + 63) / 64) * 8;
+        break;
+    case KUNAI_LFS_PROFILE_DEFAULT:
+    default:
+        c->cache_size = W25Q80BV_PAGE_SIZE * 8;
+        c->lookahead_size = 16;
+        break;
+    }
+
+    // read and prog cache plus one open file
+    uint32_t budget = (SYS_GetArenaHi() - SYS_GetArenaLo()) / 16;
+    while (c->cache_size > KUNAI_CACHE_MIN && 3 * c->cache_size + c->lookahead_size > budget)
+        c->cache_size /= 2;
+
+    return LFS_ERR_OK;
+}
+
+int kunai_load_payload(u32 addr, size_t size){
+    kprintf("Trying loading from internal Memory");
+    int res = 1;
+    addr <<= 6;
+
+    exitrace_lock(EXI_CHANNEL_0, EXI_DEVICE_1);
+    exitrace_select(EXI_CHANNEL_0, EXI_DEVICE_1, EXI_SPEED16MHZ);
+    exitrace_imm(EXI_CHANNEL_0, &addr, 4, EXI_WRITE);
+    exitrace_imm(EXI_CHANNEL_0, &size, 4, EXI_READ);
+    dol_alloc(size);
+    if(!dol)
+    {
+        res = 0;
+        goto end;
+    }
+    kprintf("Receiving file...\n");
+    // byte by byte, but one trace entry for all of it
+    exitrace_imm_run(EXI_CHANNEL_0, dol, size, 1, EXI_READ);
+    end:
+    exitrace_deselect(EXI_CHANNEL_0);
+    exitrace_unlock(EXI_CHANNEL_0);
+    return res;
+}
+
+static kunai_wait_hook_t wait_hook;
+static void *wait_ctx;
+
+void kunai_set_wait_hook(kunai_wait_hook_t hook, void *ctx) {
+    wait_hook = hook;
+    wait_ctx = ctx;
+}
+
+//wait for "WIP" flag being unset
+void kunai_wait() {
+        u64 until = gettime() + microsecs_to_ticks(150000);
+        if (wait_hook)
+            wait_hook(wait_ctx, until);
+        u64 now = gettime();
+        if (now < until)
+            usleep(ticks_to_microsecs(until - now));
+        kunai_enable_passthrough();
+        spiflash_wait();
+        kunai_disable_passthrough();
+}
+
+void kunai_disable_passthrough(void) {
+    exitrace_deselect(EXI_CHANNEL_0);
+    exitrace_unlock(EXI_CHANNEL_0);
+//  usleep(75000);
+}
+
+void kunai_enable_passthrough(void) {
+    s32 retVal = 0;
+    uint8_t repetitions = 3;
+    do {
+        u32 addr = 0x80000000; //for passthrough we need to send one '1' and 31 '0' and afterwards whatever we want
+        exitrace_lock(EXI_CHANNEL_0, EXI_DEVICE_1);
+        exitrace_select(EXI_CHANNEL_0, EXI_DEVICE_1, EXI_SPEED32MHZ);
+        retVal = exitrace_imm(EXI_CHANNEL_0, &addr, 4, EXI_WRITE);
+    } while(retVal <= 0 && --repetitions);
+}
+
+
+
+uint32_t kunai_get_jedecID(void) {
+    uint32_t jedecID = 0;
+    kunai_hold();
+    kunai_enable_passthrough();
+    jedecID = spiflash_jedec_id();
+    kunai_disable_passthrough();
+    kunai_release();
+    return jedecID;
+}
+
+int kunai_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
+    int retVal = 0;
+    if(size) {
+        kunai_hold();
+        kunai_enable_passthrough();
+        spiflash_read_start_fast((block * c->block_size) + off + KUNAI_OFFS);
+        spiflash_read_bulk(buffer, size);
+        kunai_disable_passthrough();
+        kunai_release();
+    } else {
+        retVal = LFS_ERR_IO;
+    }
+
+    return retVal;
+}
+
+int kunai_write(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
+    int retVal = 0;
+    if(size) {
+        uint32_t * p_data = (uint32_t *) buffer;
+        kunai_hold();
+
+        for(lfs_size_t i = size; i > 0; i -= c->prog_size) {
+
+            kunai_enable_passthrough();
+            spiflash_write_enable();
+            kunai_disable_passthrough();
+
+            kunai_enable_passthrough();
+            spiflash_cmd_addr_start(W25Q80BV_CMD_PAGE_PROG, (block * c->block_size) + KUNAI_OFFS + off);
+            for(uint8_t ii = 0; ii < (W25Q80BV_PAGE_SIZE/4); ii++) {
+                spiflash_write_uint32(*p_data);
+                p_data++;
+            }
+            kunai_disable_passthrough();
+            kunai_wait();
+            off += c->prog_size;
+        }
+        kunai_release();
+    } else {
+        retVal = LFS_ERR_IO;
+    }
+    return retVal;
+}
+
+int kunai_erase(const struct lfs_config *c, lfs_block_t block) {
+    int retVal = 0;
+    kunai_hold();
+    kunai_sector_erase(block * c->block_size + KUNAI_OFFS);
+    kunai_release();
+    return retVal;
+}
+
+int kunai_sync(const struct lfs_config *c) { return 0;}
+
+// Keep the KunaiGC enabled across several flash accesses. Holds nest, every
+// one makes sure the chip is enabled and the last one puts it back the way
+// kunai_disable()/kunai_reenable() last asked for, so a menu action taken
+// while the filesystem is held neither breaks the flash accesses that
+// follow nor gets overridden when they are done.
+static int kunai_holds;
+static int kunai_enabled;    // what the CPLD was last told
+static int kunai_requested;  // what kunai_disable()/kunai_reenable() asked for
+
+static void kunai_cpld(u32 data) {
+    u32 addr = 0xc0000000;
+    exitrace_lock(EXI_CHANNEL_0, EXI_DEVICE_1);
+    exitrace_select(EXI_CHANNEL_0, EXI_DEVICE_1, EXI_SPEED8MHZ);
+    exitrace_imm(EXI_CHANNEL_0, &addr, 4, EXI_WRITE);
+    exitrace_imm(EXI_CHANNEL_0, &data, 4, EXI_WRITE);
+    exitrace_deselect(EXI_CHANNEL_0);
+    exitrace_unlock(EXI_CHANNEL_0);
+    kunai_enabled = data == 1 << 24;
+}
+
+void kunai_hold(void) {
+    kunai_holds++;
+    if (!kunai_enabled)
+        kunai_cpld(1 << 24);
+}
+
+void kunai_release(void) {
+    if (kunai_holds && !--kunai_holds && !kunai_requested)
+        kunai_cpld(6 << 24);
+}
+
+void kunai_disable(void) {
+    kunai_requested = 0;
+    kunai_cpld(6 << 24);
+}
+
+void kunai_reenable(void) {
+    kunai_requested = 1;
+    kunai_cpld(1 << 24);
+}
+
+void kunai_sector_erase(uint32_t addr) {
+    kunai_enable_passthrough();
+    spiflash_write_enable();
+    kunai_disable_passthrough();
+    kunai_enable_passthrough();
+    spiflash_cmd_addr_start(W25Q80BV_CMD_ERASE_4K, addr);
+    kunai_disable_passthrough();
+    kunai_wait();
+}
+
@@ -12,14 +12,23 @@
 #include <unistd.h>
 
 
-#include "../spiflash/spiflash.h"
-#include "../lfs/lfs.h"
+#include "spiflash/spiflash.h"
+#include "lfs/lfs.h"
 
 extern u8 *dol;
 
 extern void dol_alloc(int size);
 
 #define KUNAI_OFFS (256*1024) //first 512KiB are reserver for loader + recovery
+#define KUNAI_BLOCK_SIZE 4096
+
+#define KUNAI_LFS_PROFILE_DEFAULT 0
+#define KUNAI_LFS_PROFILE_BOOT    1 //small footprint, for loading a payload
+#define KUNAI_LFS_PROFILE_BULK    2 //large cache and lookahead, for installs
+
+extern struct lfs_config cfg;
+
+int kunai_lfs_config(struct lfs_config *c, uint32_t jedec_id, int profile);
 
 void kunai_sector_erase(uint32_t addr);
 int kunai_load_payload(u32 addr, size_t size);
@@ -37,5 +46,13 @@ void kunai_write_32bit(uint32_t data, uint32_t addr);
 int8_t kunai_write_page(uint32_t * data, uint32_t addr, bool verify);
 void kunai_disable(void);
 void kunai_reenable(void);
+void kunai_hold(void);
+void kunai_release(void);
+
+// Called by kunai_wait() while the flash programs or erases and the bus is
+// free, 'until' is the timebase value the fixed delay ends at. Lets other
+// EXI work fill the delay instead of sleeping through it.
+typedef void (*kunai_wait_hook_t)(void *ctx, u64 until);
+void kunai_set_wait_hook(kunai_wait_hook_t hook, void *ctx);
 
 #endif /* KUNAIGC_H_ */
@@ -0,0 +1,97 @@
+/*
+ * kunaiinstall.c
+ *
+ * Every page program and sector erase ends in kunai_wait(), which has the
+ * bus to itself for a fixed delay. The install hooks that delay to pull the
+ * next frames out of the Gecko, so by the time LittleFS wants more data it
+ * is usually already in the window.
+ */
+
+#include <string.h>
+
+#include "kunaiinstall.h"
+#include "kunaiscrub.h"
+#include "geckolink/geckolink.h"
+
+static uint8_t chunk[KUNAI_INSTALL_CHUNK] ATTRIBUTE_ALIGN(32);
+
+static void kunai_install_pump(void *ctx, u64 until) {
+    geckolink_pump(ctx, until);
+}
+
+static int kunai_install_name_ok(const char *name) {
+    return name[0] && name[0] != '.' && !strchr(name, '/');
+}
+
+// CRC of the file as the flash reads it back
+static int kunai_install_verify(lfs_t *lfs, uint32_t expect) {
+    lfs_file_t file;
+    uint32_t crc = 0xFFFFFFFF;
+    lfs_ssize_t n;
+
+    if (lfs_file_open(lfs, &file, KUNAI_INSTALL_TMP, LFS_O_RDONLY) != LFS_ERR_OK)
+        return KUNAI_INSTALL_ERR_FS;
+    while ((n = lfs_file_read(lfs, &file, chunk, sizeof(chunk))) > 0)
+        crc = lfs_crc(crc, chunk, n);
+    lfs_file_close(lfs, &file);
+
+    if (n < 0)
+        return KUNAI_INSTALL_ERR_FS;
+    return ~crc == expect ? KUNAI_INSTALL_OK : KUNAI_INSTALL_ERR_CRC;
+}
+
+int kunai_install_gecko(lfs_t *lfs, s32 channel, char *name) {
+    geckolink_t link;
+    lfs_file_t file;
+    int err = KUNAI_INSTALL_OK;
+
+    name[0] = '\0';
+    if (geckolink_connect(&link, channel) != GECKOLINK_FRAMED)
+        return KUNAI_INSTALL_ERR_GECKO;
+    if (geckolink_begin(&link) != GECKOLINK_OK || link.xfer.mode != GECKOLINK_MODE_INSTALL) {
+        geckolink_end(&link);
+        return KUNAI_INSTALL_ERR_GECKO;
+    }
+
+    strcpy(name, link.xfer.name);
+    if (!kunai_install_name_ok(name)) {
+        geckolink_end(&link);
+        return KUNAI_INSTALL_ERR_NAME;
+    }
+
+    lfs_remove(lfs, KUNAI_INSTALL_TMP);
+    if (lfs_file_open(lfs, &file, KUNAI_INSTALL_TMP, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+        geckolink_end(&link);
+        return KUNAI_INSTALL_ERR_FS;
+    }
+
+    kprintf("Installing %s, %u bytes\n", name, link.xfer.size);
+    kunai_set_wait_hook(kunai_install_pump, &link);
+
+    for (uint32_t left = link.xfer.size; left && err == KUNAI_INSTALL_OK; ) {
+        uint32_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+        if (geckolink_read(&link, chunk, n) < 0)
+            err = KUNAI_INSTALL_ERR_GECKO;
+        else if (lfs_file_write(lfs, &file, chunk, n) != (lfs_ssize_t) n)
+            err = KUNAI_INSTALL_ERR_FS;
+        left -= n;
+    }
+
+    // closing flushes the last pages, keep pumping until then
+    if (lfs_file_close(lfs, &file) != LFS_ERR_OK && err == KUNAI_INSTALL_OK)
+        err = KUNAI_INSTALL_ERR_FS;
+    kunai_set_wait_hook(NULL, NULL);
+    if (geckolink_end(&link) != GECKOLINK_OK && err == KUNAI_INSTALL_OK)
+        err = KUNAI_INSTALL_ERR_CRC;
+
+    if (err == KUNAI_INSTALL_OK)
+        err = kunai_install_verify(lfs, link.xfer.crc);
+    if (err == KUNAI_INSTALL_OK &&
+        (lfs_setattr(lfs, KUNAI_INSTALL_TMP, KUNAI_ATTR_CRC, &link.xfer.crc, sizeof(link.xfer.crc)) != LFS_ERR_OK ||
+         lfs_rename(lfs, KUNAI_INSTALL_TMP, name) != LFS_ERR_OK))
+        err = KUNAI_INSTALL_ERR_FS;
+
+    if (err != KUNAI_INSTALL_OK)
+        lfs_remove(lfs, KUNAI_INSTALL_TMP);
+    return err;
+}
@@ -0,0 +1,32 @@
+/*
+ * kunaiinstall.h
+ *
+ * Installs a file sent with buildtools/geckosend.py --install straight into
+ * LittleFS. It is written to KUNAI_INSTALL_TMP, read back against the CRC
+ * of the transfer and only then renamed over the old file, so a failed or
+ * interrupted install leaves the old one in place. Frames are received
+ * ahead while the flash programs and erases.
+ */
+
+#ifndef KUNAIINSTALL_H_
+#define KUNAIINSTALL_H_
+
+#include "kunaigc.h"
+
+#define KUNAI_INSTALL_TMP	".install.tmp"
+#define KUNAI_INSTALL_CHUNK	4096
+
+enum kunai_install_err {
+    KUNAI_INSTALL_OK = 0,
+    KUNAI_INSTALL_ERR_GECKO = -1,	// no framed install transfer or it broke off
+    KUNAI_INSTALL_ERR_NAME = -2,
+    KUNAI_INSTALL_ERR_FS = -3,
+    KUNAI_INSTALL_ERR_CRC = -4,		// received or read back wrong
+};
+
+// Receive a file over the Gecko on 'channel' into 'lfs', preferably mounted
+// with KUNAI_LFS_PROFILE_BULK. The name it was installed as is copied to
+// 'name', which has room for LFS_NAME_MAX + 1 bytes.
+int kunai_install_gecko(lfs_t *lfs, s32 channel, char *name);
+
+#endif /* KUNAIINSTALL_H_ */
@@ -0,0 +1,92 @@
+/*
+ * kunaiprefetch.c
+ *
+ * The buffer is allocated for the whole file up front, a step only fills
+ * it and the caller can keep it as the boot image as is.
+ */
+
+#include <string.h>
+#include <malloc.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "kunaiprefetch.h"
+
+#define ALIGN32(x)	(((x) + 31) & ~31)
+
+void kunai_prefetch_start(kunai_prefetch_t *p, lfs_t *lfs, const char *path, uint32_t budget_us) {
+    memset(p, 0, sizeof(*p));
+    p->lfs = lfs;
+    p->budget_us = budget_us ? budget_us : KUNAI_PREFETCH_BUDGET_US;
+    p->state = KUNAI_PREFETCH_FAILED;
+
+    if (lfs_file_open(lfs, &p->file, path, LFS_O_RDONLY) != LFS_ERR_OK)
+        return;
+
+    lfs_soff_t size = lfs_file_size(lfs, &p->file);
+    if (size > 0)
+        p->buf = memalign(32, ALIGN32(size));
+    if (!p->buf) {
+        lfs_file_close(lfs, &p->file);
+        return;
+    }
+    p->size = size;
+    p->state = KUNAI_PREFETCH_READ;
+}
+
+static void kunai_prefetch_read(kunai_prefetch_t *p) {
+    uint32_t len = p->size - p->done < KUNAI_PREFETCH_CHUNK ? p->size - p->done : KUNAI_PREFETCH_CHUNK;
+    lfs_ssize_t n = lfs_file_read(p->lfs, &p->file, p->buf + p->done, len);
+
+    if (n <= 0) {
+        lfs_file_close(p->lfs, &p->file);
+        free(p->buf);
+        p->buf = NULL;
+        p->state = KUNAI_PREFETCH_FAILED;
+        return;
+    }
+
+    p->done += n;
+    if (p->done == p->size) {
+        lfs_file_close(p->lfs, &p->file);
+        p->state = KUNAI_PREFETCH_DONE;
+    }
+}
+
+int kunai_prefetch_step(kunai_prefetch_t *p) {
+    u64 start = gettime();
+
+    if (p->state != KUNAI_PREFETCH_READ)
+        return 0;
+
+    do {
+        kunai_prefetch_read(p);
+    } while (p->state == KUNAI_PREFETCH_READ && diff_usec(start, gettime()) < p->budget_us);
+
+    return p->state == KUNAI_PREFETCH_READ;
+}
+
+uint8_t *kunai_prefetch_take(kunai_prefetch_t *p, uint32_t *size) {
+    uint8_t *buf;
+
+    while (p->state == KUNAI_PREFETCH_READ)
+        kunai_prefetch_read(p);
+
+    if (p->state != KUNAI_PREFETCH_DONE) {
+        p->state = KUNAI_PREFETCH_IDLE;
+        return NULL;
+    }
+
+    buf = p->buf;
+    *size = p->size;
+    p->buf = NULL;
+    p->state = KUNAI_PREFETCH_IDLE;
+    return buf;
+}
+
+void kunai_prefetch_cancel(kunai_prefetch_t *p) {
+    if (p->state == KUNAI_PREFETCH_READ)
+        lfs_file_close(p->lfs, &p->file);
+    free(p->buf);
+    p->buf = NULL;
+    p->state = KUNAI_PREFETCH_IDLE;
+}
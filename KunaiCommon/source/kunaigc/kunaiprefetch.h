@@ -0,0 +1,45 @@
+/*
+ * kunaiprefetch.h
+ *
+ * Reads the payload of the highlighted menu entry from LittleFS into memory
+ * ahead of time. It is stepped from menu idle time like the scrubber, at
+ * most 'budget_us' per step, so once the entry is confirmed only the rest
+ * of the file has to be read. Moving off the entry cancels it.
+ */
+
+#ifndef KUNAIPREFETCH_H_
+#define KUNAIPREFETCH_H_
+
+#include "kunaigc.h"
+
+#define KUNAI_PREFETCH_BUDGET_US	8000	/* default bus time per frame */
+#define KUNAI_PREFETCH_CHUNK		4096
+
+enum kunai_prefetch_state {
+    KUNAI_PREFETCH_IDLE = 0,
+    KUNAI_PREFETCH_READ,
+    KUNAI_PREFETCH_DONE,	// all of it is in 'buf', the file is closed
+    KUNAI_PREFETCH_FAILED,
+};
+
+typedef struct {
+    lfs_t *lfs;
+    int state;
+    uint32_t budget_us;
+
+    lfs_file_t file;
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t done;
+} kunai_prefetch_t;
+
+// open 'path' and allocate room for all of it, nothing is read yet
+void kunai_prefetch_start(kunai_prefetch_t *p, lfs_t *lfs, const char *path, uint32_t budget_us);
+// returns 1 as long as there is work left
+int kunai_prefetch_step(kunai_prefetch_t *p);
+// Read what is left without a budget and hand the buffer over, the caller
+// frees it. Returns NULL if nothing was started or reading failed.
+uint8_t *kunai_prefetch_take(kunai_prefetch_t *p, uint32_t *size);
+void kunai_prefetch_cancel(kunai_prefetch_t *p);
+
+#endif /* KUNAIPREFETCH_H_ */
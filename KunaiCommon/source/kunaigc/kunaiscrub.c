@@ -0,0 +1,208 @@
+/*
+ * kunaiscrub.c
+ *
+ * lfs_fs_traverse() walks all metadata and every CTZ list in one call, which
+ * can't be paused. The walk is done one directory entry per iteration
+ * instead: lfs_dir_read() fetches and CRC-checks each metadata pair of the
+ * root directory as it gets to it, and reading a file follows its CTZ list.
+ *
+ * A file that reads back wrong once but matches on the retry is treated as
+ * weak and queued for a rewrite: LittleFS is copy-on-write, so copying it
+ * to a fresh file and renaming that over the original moves it to newly
+ * programmed blocks. The copy is only kept if its CRC matches the stored
+ * one.
+ */
+
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "kunaiscrub.h"
+#include "kunaiinstall.h"
+
+static uint8_t chunk[KUNAI_SCRUB_CHUNK] ATTRIBUTE_ALIGN(32);
+
+void kunai_scrub_start(kunai_scrub_t *s, lfs_t *lfs, uint32_t budget_us) {
+    memset(s, 0, sizeof(*s));
+    s->lfs = lfs;
+    s->budget_us = budget_us ? budget_us : KUNAI_SCRUB_BUDGET_US;
+    s->state = KUNAI_SCRUB_META;
+}
+
+void kunai_scrub_stop(kunai_scrub_t *s) {
+    if (s->state == KUNAI_SCRUB_IDLE)
+        return;
+
+    switch (s->state) {
+    case KUNAI_SCRUB_VERIFY:
+        lfs_file_close(s->lfs, &s->file);
+        // fall through
+    case KUNAI_SCRUB_NEXT:
+        lfs_dir_close(s->lfs, &s->dir);
+        break;
+    default:
+        break;
+    }
+    s->state = KUNAI_SCRUB_DONE;
+}
+
+// full queues are not an error, the next scrub finds the rest
+static void kunai_scrub_queue(kunai_scrub_t *s, int op, uint32_t crc) {
+    if (s->fix_count == KUNAI_SCRUB_QUEUE)
+        return;
+
+    kunai_scrub_fix_t *f = &s->fixes[s->fix_count++];
+    f->op = op;
+    f->crc = crc;
+    strcpy(f->name, s->info.name);
+}
+
+static void kunai_scrub_verified(kunai_scrub_t *s) {
+    uint32_t crc = ~s->crc;
+    lfs_ssize_t len = lfs_getattr(s->lfs, s->info.name, KUNAI_ATTR_CRC, &s->stored_crc, sizeof(s->stored_crc));
+
+    s->state = KUNAI_SCRUB_NEXT;
+
+    if (len != sizeof(s->stored_crc)) {
+        // first time we see this file, remember what it reads as now
+        kunai_scrub_queue(s, KUNAI_SCRUB_FIX_SIGN, crc);
+        s->files_unsigned++;
+    } else if (crc == s->stored_crc) {
+        if (s->retries) {
+            kunai_scrub_queue(s, KUNAI_SCRUB_FIX_REWRITE, crc);
+            s->files_weak++;
+        } else {
+            s->files_ok++;
+        }
+    } else if (!s->retries++) {
+        // read it once more before calling it bad
+        if (lfs_file_open(s->lfs, &s->file, s->info.name, LFS_O_RDONLY) == LFS_ERR_OK) {
+            s->crc = 0xFFFFFFFF;
+            s->state = KUNAI_SCRUB_VERIFY;
+            return;
+        }
+        s->files_bad++;
+    } else {
+        kprintf("Scrub: %s CRC %08X, expected %08X\n", s->info.name, crc, s->stored_crc);
+        strcpy(s->last_bad, s->info.name);
+        s->files_bad++;
+    }
+}
+
+int kunai_scrub_step(kunai_scrub_t *s) {
+    u64 start = gettime();
+    lfs_ssize_t n;
+    int err;
+
+    // every iteration is a bounded amount of reading: one metadata pair,
+    // a file open or KUNAI_SCRUB_CHUNK bytes
+    do {
+        switch (s->state) {
+        case KUNAI_SCRUB_META:
+            if ((s->meta_err = lfs_dir_open(s->lfs, &s->dir, "/")) != LFS_ERR_OK) {
+                kprintf("Scrub: metadata error %d\n", s->meta_err);
+                s->state = KUNAI_SCRUB_DONE;
+                break;
+            }
+            s->state = KUNAI_SCRUB_NEXT;
+            break;
+
+        case KUNAI_SCRUB_NEXT:
+            if ((err = lfs_dir_read(s->lfs, &s->dir, &s->info)) <= 0) {
+                if (err < 0) {
+                    s->meta_err = err;
+                    kprintf("Scrub: metadata error %d\n", err);
+                }
+                lfs_dir_close(s->lfs, &s->dir);
+                s->state = KUNAI_SCRUB_DONE;
+                break;
+            }
+            if (s->info.type != LFS_TYPE_REG || !strcmp(s->info.name, KUNAI_SCRUB_TMP) ||
+                !strcmp(s->info.name, KUNAI_INSTALL_TMP))
+                break;
+            if (lfs_file_open(s->lfs, &s->file, s->info.name, LFS_O_RDONLY) != LFS_ERR_OK) {
+                s->files_bad++;
+                break;
+            }
+            s->crc = 0xFFFFFFFF;
+            s->retries = 0;
+            s->state = KUNAI_SCRUB_VERIFY;
+            break;
+
+        case KUNAI_SCRUB_VERIFY:
+            n = lfs_file_read(s->lfs, &s->file, chunk, sizeof(chunk));
+            if (n > 0) {
+                s->crc = lfs_crc(s->crc, chunk, n);
+                break;
+            }
+            lfs_file_close(s->lfs, &s->file);
+            if (n < 0) {
+                strcpy(s->last_bad, s->info.name);
+                s->files_bad++;
+                s->state = KUNAI_SCRUB_NEXT;
+                break;
+            }
+            kunai_scrub_verified(s);
+            break;
+
+        default:
+            return 0;
+        }
+    } while (diff_usec(start, gettime()) < s->budget_us);
+
+    return s->state != KUNAI_SCRUB_DONE;
+}
+
+// copy to KUNAI_SCRUB_TMP and rename that over the original
+static int kunai_scrub_rewrite(lfs_t *lfs, const kunai_scrub_fix_t *f) {
+    lfs_file_t file, copy;
+    uint32_t crc = 0xFFFFFFFF;
+    lfs_ssize_t n;
+
+    if (lfs_file_open(lfs, &file, f->name, LFS_O_RDONLY) != LFS_ERR_OK)
+        return -1;
+    if (lfs_file_open(lfs, &copy, KUNAI_SCRUB_TMP, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+        lfs_file_close(lfs, &file);
+        return -1;
+    }
+
+    while ((n = lfs_file_read(lfs, &file, chunk, sizeof(chunk))) > 0) {
+        crc = lfs_crc(crc, chunk, n);
+        if (lfs_file_write(lfs, &copy, chunk, n) != n) {
+            n = -1;
+            break;
+        }
+    }
+    crc = ~crc;
+
+    lfs_file_close(lfs, &file);
+    if (lfs_file_close(lfs, &copy) == LFS_ERR_OK && n == 0 && crc == f->crc &&
+        lfs_setattr(lfs, KUNAI_SCRUB_TMP, KUNAI_ATTR_CRC, &crc, sizeof(crc)) == LFS_ERR_OK &&
+        lfs_rename(lfs, KUNAI_SCRUB_TMP, f->name) == LFS_ERR_OK)
+        return 0;
+
+    lfs_remove(lfs, KUNAI_SCRUB_TMP);
+    return -1;
+}
+
+int kunai_scrub_apply(kunai_scrub_t *s) {
+    int failed = 0;
+
+    kunai_scrub_stop(s);
+
+    for (uint32_t i = 0; i < s->fix_count; i++) {
+        kunai_scrub_fix_t *f = &s->fixes[i];
+
+        if (f->op == KUNAI_SCRUB_FIX_SIGN &&
+            lfs_setattr(s->lfs, f->name, KUNAI_ATTR_CRC, &f->crc, sizeof(f->crc)) == LFS_ERR_OK) {
+            s->files_signed++;
+        } else if (f->op == KUNAI_SCRUB_FIX_REWRITE && kunai_scrub_rewrite(s->lfs, f) == 0) {
+            s->files_rewritten++;
+        } else {
+            strcpy(s->last_bad, f->name);
+            failed++;
+        }
+    }
+    s->fix_count = 0;
+
+    return failed;
+}
@@ -0,0 +1,80 @@
+/*
+ * kunaiscrub.h
+ *
+ * Background scrubber for the payloads stored in LittleFS. It is stepped
+ * from menu idle time and re-reads every file against the CRC stored in
+ * its KUNAI_ATTR_CRC attribute, spending at most 'budget_us' per step.
+ *
+ * Stepping only reads. Programming a page blocks for far longer than a
+ * frame, so storing a first CRC or rewriting a weak file is queued and
+ * only done by kunai_scrub_apply(), on request.
+ */
+
+#ifndef KUNAISCRUB_H_
+#define KUNAISCRUB_H_
+
+#include "kunaigc.h"
+
+#define KUNAI_ATTR_CRC		0x43	/* 'C', zlib compatible CRC32 of the file contents */
+#define KUNAI_SCRUB_BUDGET_US	2000	/* default bus time per frame */
+#define KUNAI_SCRUB_CHUNK	1024
+#define KUNAI_SCRUB_TMP		".scrub.tmp"
+#define KUNAI_SCRUB_QUEUE	8	/* fixes kept for kunai_scrub_apply() */
+
+enum kunai_scrub_state {
+    KUNAI_SCRUB_IDLE = 0,
+    KUNAI_SCRUB_META,	// open the root directory
+    KUNAI_SCRUB_NEXT,	// read the next entry, fetching its metadata pair
+    KUNAI_SCRUB_VERIFY,	// read the file and compare its CRC
+    KUNAI_SCRUB_DONE,
+};
+
+enum kunai_scrub_fix_op {
+    KUNAI_SCRUB_FIX_SIGN = 1,	// store 'crc' as the file's first CRC
+    KUNAI_SCRUB_FIX_REWRITE,	// read back wrong once, copy it to fresh blocks
+};
+
+typedef struct {
+    uint8_t op;			// enum kunai_scrub_fix_op
+    uint32_t crc;
+    char name[LFS_NAME_MAX + 1];
+} kunai_scrub_fix_t;
+
+typedef struct {
+    lfs_t *lfs;
+    int state;
+    uint32_t budget_us;
+
+    lfs_dir_t dir;
+    lfs_file_t file;
+    struct lfs_info info;
+    uint32_t crc;
+    uint32_t stored_crc;
+    uint8_t retries;
+
+    kunai_scrub_fix_t fixes[KUNAI_SCRUB_QUEUE];
+    uint32_t fix_count;
+
+    // results
+    int meta_err;			// from lfs_dir_read, a metadata pair failed
+    uint32_t files_ok;
+    uint32_t files_unsigned;	// had no CRC yet, queued for signing
+    uint32_t files_weak;		// read back wrong once, queued for a rewrite
+    uint32_t files_bad;		// CRC mismatch on every read
+    char last_bad[LFS_NAME_MAX + 1];
+
+    // from kunai_scrub_apply()
+    uint32_t files_signed;
+    uint32_t files_rewritten;
+} kunai_scrub_t;
+
+void kunai_scrub_start(kunai_scrub_t *s, lfs_t *lfs, uint32_t budget_us);
+// returns 1 as long as there is work left
+int kunai_scrub_step(kunai_scrub_t *s);
+void kunai_scrub_stop(kunai_scrub_t *s);
+
+// stop the scrub and program the queued fixes, blocks for as long as that
+// takes, returns the number of fixes that failed
+int kunai_scrub_apply(kunai_scrub_t *s);
+
+#endif /* KUNAISCRUB_H_ */
@@ -0,0 +1,72 @@
+/*
+ * kunaistorage.c
+ *
+ * While there are users the KunaiGC is held enabled, so a run of LittleFS
+ * accesses doesn't pay for a CPLD enable/disable cycle per block.
+ */
+
+#include "kunaistorage.h"
+
+extern lfs_t lfs;
+
+static uint32_t jedec_id;
+static int mounted;
+static int mounted_profile;
+static int users;
+
+uint32_t kunai_storage_jedec(void) {
+    if (!jedec_id)
+        jedec_id = kunai_get_jedecID();
+    return jedec_id;
+}
+
+lfs_t *kunai_storage_get(int profile, int flags) {
+    // the caches are allocated at mount time, nothing to write back
+    if (mounted && !users && (flags & KUNAI_STORAGE_PROFILE) && profile != mounted_profile) {
+        lfs_unmount(&lfs);
+        mounted = 0;
+    }
+
+    if (!mounted) {
+        if (kunai_lfs_config(&cfg, kunai_storage_jedec(), profile) != LFS_ERR_OK) {
+            // don't keep a bad ID read around
+            jedec_id = 0;
+            return NULL;
+        }
+
+        kunai_hold();
+        int err = lfs_mount(&lfs, &cfg);
+        if (err && (flags & KUNAI_STORAGE_FORMAT)) {
+            lfs_format(&lfs, &cfg);
+            err = lfs_mount(&lfs, &cfg);
+        }
+        if (err) {
+            kunai_release();
+            return NULL;
+        }
+        mounted = 1;
+        mounted_profile = profile;
+    } else if (!users) {
+        kunai_hold();
+    }
+
+    users++;
+    return &lfs;
+}
+
+void kunai_storage_put(void) {
+    if (users && !--users)
+        kunai_release();
+}
+
+void kunai_storage_shutdown(void) {
+    if (!mounted)
+        return;
+
+    if (users) {
+        users = 0;
+        kunai_release();
+    }
+    lfs_unmount(&lfs);
+    mounted = 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * kunaistorage.h
+ *
+ * LittleFS on the KunaiGC flash, mounted once per boot on first use and
+ * shared by the menu and the boot paths. Every kunai_storage_get() must be
+ * paired with a kunai_storage_put(), the filesystem stays mounted until
+ * kunai_storage_shutdown() right before handing off to the payload.
+ */
+
+#ifndef KUNAISTORAGE_H_
+#define KUNAISTORAGE_H_
+
+#include "kunaigc.h"
+
+#define KUNAI_STORAGE_FORMAT  1 //format if the filesystem doesn't mount
+#define KUNAI_STORAGE_PROFILE 2 //remount with 'profile' if mounted with another one and unused
+
+// JEDEC ID of the flash, read once and cached
+uint32_t kunai_storage_jedec(void);
+
+// mount with the given KUNAI_LFS_PROFILE_* if not mounted yet, returns NULL
+// if the flash is unknown or the filesystem can't be mounted. An existing
+// mount is shared whatever its profile, unless KUNAI_STORAGE_PROFILE is
+// given and nobody holds it.
+lfs_t *kunai_storage_get(int profile, int flags);
+void kunai_storage_put(void);
+
+void kunai_storage_shutdown(void);
+
+#endif /* KUNAISTORAGE_H_ */
@@ -0,0 +1,67 @@
+/*
+ * lz4block.c
+ */
+
+#include <string.h>
+
+#include "lz4block.h"
+
+int lz4_decode_block(const u8 *ip, u32 in_len, u8 *base, u8 *op, u8 *oend) {
+    const u8 *iend = ip + in_len;
+
+    while (ip < iend) {
+        u32 token = *ip++;
+        u32 len = token >> 4;
+        u8 b;
+
+        if (len == 15) {
+            do {
+                if (ip >= iend)
+                    return PAYLOAD_ERR_CORRUPT;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if (len > (u32)(iend - ip) || len > (u32)(oend - op))
+            return PAYLOAD_ERR_CORRUPT;
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+
+        // the last sequence has literals only
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return PAYLOAD_ERR_CORRUPT;
+        u32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (!offset || offset > (u32)(op - base))
+            return PAYLOAD_ERR_CORRUPT;
+
+        len = token & 15;
+        if (len == 15) {
+            do {
+                if (ip >= iend)
+                    return PAYLOAD_ERR_CORRUPT;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += 4;
+        if (len > (u32)(oend - op))
+            return PAYLOAD_ERR_CORRUPT;
+
+        // overlapping copies repeat the last 'offset' bytes
+        const u8 *match = op - offset;
+        if (offset >= len) {
+            memcpy(op, match, len);
+            op += len;
+        } else {
+            while (len--)
+                *op++ = *match++;
+        }
+    }
+
+    return op == oend ? PAYLOAD_OK : PAYLOAD_ERR_CORRUPT;
+}
@@ -0,0 +1,18 @@
+/*
+ * lz4block.h
+ *
+ * The LZ4 block decoder of the payload container, on its own so the stage 1
+ * IPL can unpack the loader without the rest of payload.c.
+ */
+
+#ifndef LZ4BLOCK_H_
+#define LZ4BLOCK_H_
+
+#include "payload.h"
+
+// Decode one LZ4 block to [op, oend). Matches may reach back to 'base', the
+// start of the payload, as chunks are compressed against the ones before.
+// Returns PAYLOAD_OK or PAYLOAD_ERR_CORRUPT.
+int lz4_decode_block(const u8 *ip, u32 in_len, u8 *base, u8 *op, u8 *oend);
+
+#endif /* LZ4BLOCK_H_ */
@@ -0,0 +1,187 @@
+/*
+ * payload.c
+ *
+ * The payload is decoded chunk by chunk as it comes in, straight into the
+ * final buffer, so there is never a second copy of the whole file in RAM.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "payload.h"
+#include "lz4block.h"
+#include "lfs/lfs_util.h"
+
+#ifdef KUNAI_PAYLOAD_XZ
+#include <xz.h>
+#define PAYLOAD_XZ_DICT_MAX	(8 * 1024 * 1024)
+#endif
+
+const char *payload_codec_name(int codec) {
+    switch (codec) {
+    case PAYLOAD_CODEC_STORED: return "stored";
+    case PAYLOAD_CODEC_LZ4:    return "lz4";
+    case PAYLOAD_CODEC_XZ:     return "xz";
+    default:                   return "unknown";
+    }
+}
+
+int payload_check(const payload_header_t *hdr, u32 file_size) {
+    if (file_size < sizeof(*hdr) || hdr->magic != PAYLOAD_MAGIC ||
+        hdr->version != PAYLOAD_VERSION || !hdr->raw_size)
+        return 0;
+
+    switch (hdr->codec) {
+    case PAYLOAD_CODEC_STORED:
+        return file_size - sizeof(*hdr) >= hdr->raw_size;
+    case PAYLOAD_CODEC_LZ4:
+        return hdr->chunk_size && hdr->chunk_size <= PAYLOAD_CHUNK_MAX;
+#ifdef KUNAI_PAYLOAD_XZ
+    case PAYLOAD_CODEC_XZ:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static int read_full(payload_read_fn read, void *ctx, void *buf, u32 len) {
+    u8 *p = buf;
+    while (len) {
+        int n = read(ctx, p, len);
+        if (n <= 0)
+            return PAYLOAD_ERR_READ;
+        p += n;
+        len -= n;
+    }
+    return PAYLOAD_OK;
+}
+
+// Unlike stage 1, nothing is decoded while the next chunk is read. Every
+// 'read' returns with the data in place: LittleFS, FatFs on libogc's SD
+// driver and the USB Gecko all wait out each transfer in EXI_Sync, so
+// there is no DMA left running to decode under.
+static int load_lz4(const payload_header_t *hdr, payload_read_fn read, void *ctx,
+                    u8 *dst, u32 *crc) {
+    u8 *in = memalign(32, hdr->chunk_size);
+    u32 pos = 0;
+    int err = PAYLOAD_OK;
+
+    if (!in)
+        return PAYLOAD_ERR_NOMEM;
+
+    while (pos < hdr->raw_size && err == PAYLOAD_OK) {
+        u32 out_len = hdr->raw_size - pos;
+        u8 len_be[4];
+        u32 in_len;
+
+        if (out_len > hdr->chunk_size)
+            out_len = hdr->chunk_size;
+
+        if ((err = read_full(read, ctx, len_be, sizeof(len_be))) != PAYLOAD_OK)
+            break;
+        in_len = len_be[0] << 24 | len_be[1] << 16 | len_be[2] << 8 | len_be[3];
+
+        if (in_len & PAYLOAD_CHUNK_STORED) {
+            if ((in_len & ~PAYLOAD_CHUNK_STORED) != out_len) {
+                err = PAYLOAD_ERR_CORRUPT;
+                break;
+            }
+            err = read_full(read, ctx, dst + pos, out_len);
+        } else {
+            if (in_len > hdr->chunk_size) {
+                err = PAYLOAD_ERR_CORRUPT;
+                break;
+            }
+            err = read_full(read, ctx, in, in_len);
+            if (err == PAYLOAD_OK)
+                err = lz4_decode_block(in, in_len, dst, dst + pos, dst + pos + out_len);
+        }
+
+        if (err == PAYLOAD_OK)
+            *crc = lfs_crc(*crc, dst + pos, out_len);
+        pos += out_len;
+    }
+
+    free(in);
+    return err;
+}
+
+#ifdef KUNAI_PAYLOAD_XZ
+static int load_xz(const payload_header_t *hdr, payload_read_fn read, void *ctx,
+                   u8 *dst, u32 *crc) {
+    u8 *in = memalign(32, PAYLOAD_CHUNK_MAX);
+    struct xz_dec *dec;
+    struct xz_buf b;
+    enum xz_ret ret = XZ_OK;
+    int err = PAYLOAD_OK;
+
+    if (!in)
+        return PAYLOAD_ERR_NOMEM;
+
+    xz_crc32_init();
+    dec = xz_dec_init(XZ_DYNALLOC, PAYLOAD_XZ_DICT_MAX);
+    if (!dec) {
+        free(in);
+        return PAYLOAD_ERR_NOMEM;
+    }
+
+    b.in = in;
+    b.in_pos = 0;
+    b.in_size = 0;
+    b.out = dst;
+    b.out_pos = 0;
+    b.out_size = hdr->raw_size;
+
+    while (ret == XZ_OK) {
+        if (b.in_pos == b.in_size) {
+            int n = read(ctx, in, PAYLOAD_CHUNK_MAX);
+            if (n <= 0) {
+                err = PAYLOAD_ERR_READ;
+                break;
+            }
+            b.in_pos = 0;
+            b.in_size = n;
+        }
+
+        size_t out_start = b.out_pos;
+        ret = xz_dec_run(dec, &b);
+        *crc = lfs_crc(*crc, dst + out_start, b.out_pos - out_start);
+    }
+
+    if (err == PAYLOAD_OK && (ret != XZ_STREAM_END || b.out_pos != hdr->raw_size))
+        err = ret == XZ_MEM_ERROR ? PAYLOAD_ERR_NOMEM : PAYLOAD_ERR_CORRUPT;
+
+    xz_dec_end(dec);
+    free(in);
+    return err;
+}
+#endif
+
+int payload_load(const payload_header_t *hdr, payload_read_fn read, void *ctx, u8 *dst) {
+    u32 crc = 0xffffffff;
+    int err;
+
+    switch (hdr->codec) {
+    case PAYLOAD_CODEC_STORED:
+        err = read_full(read, ctx, dst, hdr->raw_size);
+        if (err == PAYLOAD_OK)
+            crc = lfs_crc(crc, dst, hdr->raw_size);
+        break;
+    case PAYLOAD_CODEC_LZ4:
+        err = load_lz4(hdr, read, ctx, dst, &crc);
+        break;
+#ifdef KUNAI_PAYLOAD_XZ
+    case PAYLOAD_CODEC_XZ:
+        err = load_xz(hdr, read, ctx, dst, &crc);
+        break;
+#endif
+    default:
+        return PAYLOAD_ERR_CODEC;
+    }
+
+    if (err == PAYLOAD_OK && ~crc != hdr->raw_crc)
+        err = PAYLOAD_ERR_CRC;
+    return err;
+}
@@ -0,0 +1,69 @@
+/*
+ * payload.h
+ *
+ * Container for compressed boot payloads, written by buildtools/kpack.py.
+ * A 32 byte header is followed by the payload data:
+ *
+ *   STORED  the raw payload
+ *   LZ4     chunks of a u32 compressed length and an LZ4 block, each one
+ *           decodes to 'chunk_size' bytes (the last one to the rest). Matches
+ *           may reach back into the previous chunks, so they are decoded in
+ *           place into one buffer. Bit 31 of the length marks a chunk stored
+ *           uncompressed.
+ *   XZ      a single .xz stream, only if built with KUNAI_PAYLOAD_XZ and
+ *           xz-embedded
+ *
+ * All header fields are big-endian.
+ */
+
+#ifndef PAYLOAD_H_
+#define PAYLOAD_H_
+
+#include <gccore.h>
+
+#define PAYLOAD_MAGIC		0x4B504159	/* "KPAY" */
+#define PAYLOAD_VERSION		1
+
+#define PAYLOAD_CODEC_STORED	0
+#define PAYLOAD_CODEC_LZ4	1
+#define PAYLOAD_CODEC_XZ	2
+
+#define PAYLOAD_CHUNK_MAX	(64 * 1024)
+#define PAYLOAD_CHUNK_STORED	0x80000000
+
+typedef struct {
+    u32 magic;
+    u8 version;
+    u8 codec;
+    u16 reserved0;
+    u32 raw_size;
+    u32 raw_crc;		// zlib compatible CRC32 of the decoded payload
+    u32 chunk_size;		// LZ4 only
+    u32 reserved[3];
+} payload_header_t;
+
+enum payload_err {
+    PAYLOAD_OK = 0,
+    PAYLOAD_ERR_READ = -1,
+    PAYLOAD_ERR_CORRUPT = -2,
+    PAYLOAD_ERR_CODEC = -3,		// unknown codec or not built in
+    PAYLOAD_ERR_NOMEM = -4,
+    PAYLOAD_ERR_CRC = -5,
+};
+
+// reads up to 'len' bytes of the file following the header, returns the
+// number of bytes read or a negative value on error
+typedef int (*payload_read_fn)(void *ctx, void *buf, u32 len);
+
+// returns 1 if 'hdr' (the first bytes of a file of 'file_size' bytes) is a
+// payload container this build can decode
+int payload_check(const payload_header_t *hdr, u32 file_size);
+
+// Decode the payload into 'dst' (hdr->raw_size bytes) while it is read.
+// Every chunk is checksummed right after decoding while it is still in the
+// data cache, returns PAYLOAD_OK or one of enum payload_err.
+int payload_load(const payload_header_t *hdr, payload_read_fn read, void *ctx, u8 *dst);
+
+const char *payload_codec_name(int codec);
+
+#endif /* PAYLOAD_H_ */
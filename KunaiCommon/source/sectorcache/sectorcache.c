@@ -0,0 +1,69 @@
+/*
+ * sectorcache.c
+ *
+ * SECTORCACHE_SECTORS slots, the least recently used one is replaced.
+ * Lookups are a linear scan, which is cheap next to any card access.
+ */
+
+#include <string.h>
+
+#include "sectorcache.h"
+
+sectorcache_stats_t sectorcache_stats;
+
+static struct {
+    sec_t sector;
+    u32 used;       // last access, 0 if the slot is empty
+} cache_tags[SECTORCACHE_SECTORS];
+static u8 cache_data[SECTORCACHE_SECTORS][SECTORCACHE_SECTOR_SIZE] ATTRIBUTE_ALIGN(32);
+static u32 cache_clock;
+
+void sectorcache_flush(void)
+{
+    for (int i = 0; i < SECTORCACHE_SECTORS; i++)
+        cache_tags[i].used = 0;
+    cache_clock = 0;
+    memset(&sectorcache_stats, 0, sizeof(sectorcache_stats));
+}
+
+static int cache_find(sec_t sector)
+{
+    for (int i = 0; i < SECTORCACHE_SECTORS; i++)
+        if (cache_tags[i].used && cache_tags[i].sector == sector)
+            return i;
+    return -1;
+}
+
+bool sectorcache_read(const DISC_INTERFACE *disc, sec_t sector, sec_t count, void *buff)
+{
+    if (count != 1)
+    {
+        sectorcache_stats.bypassed++;
+        return disc->readSectors(sector, count, buff);
+    }
+
+    int slot = cache_find(sector);
+
+    if (slot >= 0)
+    {
+        sectorcache_stats.hits++;
+    }
+    else
+    {
+        // empty slots have the oldest timestamp of all
+        slot = 0;
+        for (int i = 1; i < SECTORCACHE_SECTORS; i++)
+            if (cache_tags[i].used < cache_tags[slot].used)
+                slot = i;
+
+        sectorcache_stats.misses++;
+        cache_tags[slot].used = 0;
+        if (!disc->readSectors(sector, 1, cache_data[slot]))
+            return false;
+        cache_tags[slot].sector = sector;
+    }
+
+    cache_tags[slot].used = ++cache_clock;
+    memcpy(buff, cache_data[slot], SECTORCACHE_SECTOR_SIZE);
+    return true;
+}
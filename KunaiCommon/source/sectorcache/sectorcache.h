@@ -0,0 +1,33 @@
+/*
+ * sectorcache.h
+ *
+ * LRU cache for single sector reads from a DISC_INTERFACE. FatFs pulls FAT
+ * and directory sectors through its one sector window and keeps re-reading
+ * the same ones.
+ */
+
+#ifndef SECTORCACHE_H_
+#define SECTORCACHE_H_
+
+#include <gccore.h>
+#include <ogc/disc_io.h>
+
+#define SECTORCACHE_SECTORS	8
+#define SECTORCACHE_SECTOR_SIZE	512
+
+typedef struct {
+    u32 hits;
+    u32 misses;
+    u32 bypassed;   // multi sector reads, passed straight to the card
+} sectorcache_stats_t;
+
+extern sectorcache_stats_t sectorcache_stats;
+
+// drops all cached sectors and resets the statistics, done on every mount
+void sectorcache_flush(void);
+
+// 'count' sectors from 'disc' into 'buff', single sectors through the cache.
+// The cache doesn't know which device it holds, flush it on every switch.
+bool sectorcache_read(const DISC_INTERFACE *disc, sec_t sector, sec_t count, void *buff);
+
+#endif
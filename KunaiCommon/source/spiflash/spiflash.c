@@ -5,12 +5,16 @@
 uint8_t spiflash_is_busy(void) {
 	uint8_t res;
 	spiflash_write(W25Q80BV_CMD_READ_STAT1);
-	res = (spiflash_read_uint8() & W25Q80BV_MASK_STAT_BUSY);
-	return res;
+	res = spiflash_read_uint8();
+	SPIFLASH_TRACE("SPI status Register is %d\n", res);
+	return res & W25Q80BV_MASK_STAT_BUSY;
 }
 
 
 // Wait until not busy
+// The status register is clocked out continuously for as long as CS stays
+// asserted, so issue 0x05 once and keep reading instead of restarting the
+// command on every poll.
 void spiflash_wait(void) {
 	spiflash_write(W25Q80BV_CMD_READ_STAT1);
 	// ToDo: Timeout?
@@ -18,9 +22,9 @@ void spiflash_wait(void) {
 }
 
 void spiflash_cmd_addr_start(uint8_t cmd, uint32_t addr) {
-	uint32_t buff = (cmd << 24) | addr;
-	EXI_Imm(EXI_CHANNEL_0, &buff, 4, EXI_WRITE, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	uint32_t buff = ((uint32_t) cmd << 24) | addr;
+	SPIFLASH_TRACE("\tCommand is %x, Adress: %04x\n", cmd, buff);
+	exitrace_imm(EXI_CHANNEL_0, &buff, 4, EXI_WRITE);
 }
 
 
@@ -35,39 +39,73 @@ void spiflash_write_disable(void) {
 
 void spiflash_write_start(uint32_t addr) {
 	spiflash_write_enable();
+	SPIFLASH_TRACE("Write start %04x\n", addr);
 	spiflash_cmd_addr_start(W25Q80BV_CMD_PAGE_PROG, addr);
 }
 
 
 void spiflash_read_start(uint32_t addr) {
+	SPIFLASH_TRACE("Read start %04x\n", addr);
 	spiflash_cmd_addr_start(W25Q80BV_CMD_READ_DATA, addr);
 }
 
 void spiflash_read_start_fast(uint32_t addr) {
+	SPIFLASH_TRACE("Read start fast %04x\n", addr);
 	spiflash_cmd_addr_start(W25Q80BV_CMD_READ_FAST, addr);
 	spiflash_read_uint8();
 }
 
+// Read 'size' bytes of an already started read command into 'buf'. EXI DMA
+// needs 32 byte aligned address and length, so only the aligned middle part
+// goes by DMA, head and tail are read with immediate transfers.
+void spiflash_read_bulk(void *buf, uint32_t size) {
+	uint8_t *p = buf;
+	uint32_t head = (-(uintptr_t)p) & 31;
+	uint32_t len;
+
+	if (head > size)
+		head = size;
+	size -= head;
+	for (; head; head -= len, p += len) {
+		len = head < 4 ? head : 4;
+		exitrace_imm(EXI_CHANNEL_0, p, len, EXI_READ);
+	}
+
+	len = size & ~31;
+	if (len) {
+		SPIFLASH_TRACE("Read bulk %d\n", len);
+		DCInvalidateRange(p, len);
+		exitrace_dma(EXI_CHANNEL_0, p, len, EXI_READ);
+		p += len;
+		size -= len;
+	}
+
+	for (; size; size -= len, p += len) {
+		len = size < 4 ? size : 4;
+		exitrace_imm(EXI_CHANNEL_0, p, len, EXI_READ);
+	}
+}
+
 uint8_t spiflash_read_uint8(void) {
 	uint8_t val = 0;
-	EXI_Imm(EXI_CHANNEL_0, &val, 1, EXI_READ, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	exitrace_imm(EXI_CHANNEL_0, &val, 1, EXI_READ);
+	SPIFLASH_TRACE("Read u8 %01x\n", val);
 	return val;
 }
 
 
 uint16_t spiflash_read_uint16(void) {
 	uint16_t val = 0;
-	EXI_Imm(EXI_CHANNEL_0, &val, 2, EXI_READ, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	exitrace_imm(EXI_CHANNEL_0, &val, 2, EXI_READ);
+	SPIFLASH_TRACE("Read u16 %02x\n", val);
 	return val;
 }
 
 
 uint32_t spiflash_read_uint32(void) {
 	uint32_t val = 0;
-	EXI_Imm(EXI_CHANNEL_0, &val, 4, EXI_READ, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	exitrace_imm(EXI_CHANNEL_0, &val, 4, EXI_READ);
+	SPIFLASH_TRACE("Read u32 %04x\n", val);
 	return val;
 }
 
@@ -83,14 +121,14 @@ uint32_t spiflash_read_uint32_le(void) {
 
 
 void spiflash_write_uint16(uint16_t val) {
-	EXI_Imm(EXI_CHANNEL_0, &val, 2, EXI_WRITE, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	SPIFLASH_TRACE("Write u16 : %02xl\n", val);
+	exitrace_imm(EXI_CHANNEL_0, &val, 2, EXI_WRITE);
 }
 
 
 void spiflash_write_uint32(uint32_t val) {
-	EXI_Imm(EXI_CHANNEL_0, &val, 4, EXI_WRITE, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	SPIFLASH_TRACE("Write u32 : %04xl\n", val);
+	exitrace_imm(EXI_CHANNEL_0, &val, 4, EXI_WRITE);
 }
 
 
@@ -108,18 +146,21 @@ void spiflash_write_uint32_le(uint32_t val) {
 
 void spiflash_erase4k(uint32_t addr) {
 	spiflash_write_enable();
+	SPIFLASH_TRACE("Erase 4k\n");
 	spiflash_cmd_addr_start(W25Q80BV_CMD_ERASE_4K, addr);
 }
 
 
 void spiflash_erase32k(uint32_t addr) {
 	spiflash_write_enable();
+	SPIFLASH_TRACE("Erase 32k\n");
 	spiflash_cmd_addr_start(W25Q80BV_CMD_ERASE_32K, addr);
 }
 
 
 void spiflash_erase64k(uint32_t addr) {
 	spiflash_write_enable();
+	SPIFLASH_TRACE("Erase 64k\n");
 	spiflash_cmd_addr_start(W25Q80BV_CMD_ERASE_64K, addr);
 }
 
@@ -132,6 +173,7 @@ void spiflash_chip_erase(void) {
 
 uint16_t spiflash_device_id(void) {
 	uint16_t id;
+	SPIFLASH_TRACE("Dev ID\n");
 	spiflash_cmd_addr_start(W25Q80BV_CMD_READ_MAN_DEV_ID, 0x0000);
 	id = spiflash_read_uint16();
 	return id;
@@ -140,14 +182,14 @@ uint16_t spiflash_device_id(void) {
 uint32_t spiflash_jedec_id(void) {
 	uint32_t id;
 	uint8_t cmd = W25Q80BV_CMD_READ_JEDEC_ID;
-	EXI_Imm(EXI_CHANNEL_0, &cmd, 1, EXI_WRITE, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	exitrace_imm(EXI_CHANNEL_0, &cmd, 1, EXI_WRITE);
 	id = spiflash_read_uint32() >> 8;
 	return id;
 }
 
 uint64_t spiflash_unique_id(void) {
 	uint64_t id;
+	SPIFLASH_TRACE("Unique ID\n");
 	spiflash_cmd_addr_start(W25Q80BV_CMD_READ_UNIQUE_ID, 0x0000);
 	spiflash_read();
 	id = (uint64_t)spiflash_read_uint32() << 32;
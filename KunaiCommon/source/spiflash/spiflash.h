@@ -5,6 +5,8 @@
 #include <inttypes.h>
 #include <gccore.h>
 
+#include "exitrace/exitrace.h"
+
 #ifdef __cplusplus
 #define _spiflash_h_ {
 extern "C" _spiflash_h_
@@ -30,6 +32,15 @@ extern "C" _spiflash_h_
 
 #define SPIFLASH_PAGE_SIZE	W25Q80BV_PAGE_SIZE
 
+/*
+ * Tracing, build with -DSPI_DBG to get every transfer on the console
+ */
+#ifdef SPI_DBG
+#define SPIFLASH_TRACE(...)	kprintf(__VA_ARGS__)
+#else
+#define SPIFLASH_TRACE(...)	do { } while (0)
+#endif
+
 /*
  * Generic commands
  */
@@ -49,8 +60,7 @@ void spiflash_write_start(uint32_t addr);
 
 static inline
 void spiflash_write_uint8(uint8_t val) {
-	EXI_Imm(EXI_CHANNEL_0, &val, 1, EXI_WRITE, NULL);
-	EXI_Sync(EXI_CHANNEL_0);
+	exitrace_imm(EXI_CHANNEL_0, &val, 1, EXI_WRITE);
 }
 
 
@@ -80,6 +90,8 @@ void spiflash_write_end(void) {
 void spiflash_read_start(uint32_t addr);
 void spiflash_read_start_fast(uint32_t addr);
 
+void spiflash_read_bulk(void *buf, uint32_t size);
+
 uint8_t spiflash_read_uint8(void);
 uint16_t spiflash_read_uint16(void);
 uint32_t spiflash_read_uint32(void);
@@ -0,0 +1,31 @@
+/*
+ * stub.h
+ *
+ * The handoff stub, copied to STUB_ADDR and entered through SYS_SwitchFiber
+ * with the DOL image in r3. It moves the sections of the image to their
+ * load addresses, clears the BSS and jumps to the entry point. stub.S is
+ * position independent and never returns.
+ *
+ * Sections are moved a 32 byte cache line at a time. The source line is
+ * loaded into registers, the destination line is claimed with dcbz instead
+ * of being read from memory, then stored and written back with dcbst right
+ * away. Only the lines a section touches are written back, and only those
+ * of text sections are invalidated in the instruction cache.
+ *
+ * The extra pieces of the header's table follow the sections, see
+ * dolload.h. Those parked in ARAM are DMA'd straight to their address,
+ * their lines are dropped from the data cache before.
+ *
+ * KunaiCommon/test/stub/stub_ref.c is the same algorithm in portable C,
+ * for checking staged images and the cache maintenance on the host.
+ */
+
+#ifndef STUB_H_
+#define STUB_H_
+
+#include <gccore.h>
+
+extern const unsigned char stub[];
+extern const int stub_size;
+
+#endif /* STUB_H_ */
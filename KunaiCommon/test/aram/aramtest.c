@@ -0,0 +1,241 @@
+/*
+ * aramtest.c
+ *
+ * aramstage_alloc() against a model of the bump allocator it is meant to
+ * be, on random sequences and at the edges of the 32 bit range, then
+ * aramstage_park() on the ARAM in gcmem: the data at the address it
+ * returns, DMAs only of flushed whole cache lines and the bounce buffer
+ * given back.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "aramstage/aramstage.h"
+
+#include "host.h"
+#include "gcmem.h"
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+static u32 rng = 1;
+
+static u32 next_rand(void)
+{
+    rng = rng * 1103515245 + 12345;
+    return rng >> 8;
+}
+
+// what aramstage_alloc() has to return, 'next' advanced on success
+static u32 model_alloc(u64 *next, u64 top, u64 size)
+{
+    u64 addr = *next;
+
+    size = (size + 31) & ~(u64) 31;
+    if (!size || size > 0xFFFFFFFF || addr + size > top)
+        return 0;
+    *next += size;
+    return addr;
+}
+
+static void alloc_random(u32 base, u32 top)
+{
+    aramstage_t a = { base, top, base };
+    u64 next = base;
+    u32 prev_end = base;
+
+    for (int i = 0; i < 4000; i++)
+    {
+        u32 size;
+
+        switch (next_rand() % 4)
+        {
+        case 0:
+            size = next_rand() % 64;
+            break;
+        case 1:
+            size = next_rand() % (64 * 1024);
+            break;
+        case 2:
+            size = (top - base) / 8 + next_rand() % 4096;
+            break;
+        default:
+            size = top - (u32) next + next_rand() % 64 - 32;
+            break;
+        }
+
+        u32 want = model_alloc(&next, top, size);
+        u32 got = aramstage_alloc(&a, size);
+        if (!HOST_CHECK(got == want))
+        {
+            fprintf(stderr, "  %u bytes at %08X: got %08X, want %08X\n", size, prev_end, got, want);
+            return;
+        }
+        HOST_CHECK(a.next == next && a.base == base && a.top == top);
+        if (got)
+        {
+            // aligned, inside the ARAM, right after the previous one
+            HOST_CHECK(!(got & 31) && got == prev_end && a.next <= top);
+            prev_end = a.next;
+        }
+
+        // start over now and then, as aramstage_reset() does
+        if (next_rand() % 64 == 0)
+            a.next = prev_end = next = base;
+    }
+}
+
+static void alloc_edges(void)
+{
+    aramstage_t a;
+
+    printf("alloc edges\n");
+
+    a = (aramstage_t) { 0x4000, 0x1000000, 0x4000 };
+    HOST_CHECK(aramstage_alloc(&a, 0) == 0 && a.next == 0x4000);
+    HOST_CHECK(aramstage_alloc(&a, 1) == 0x4000 && a.next == 0x4020);
+    HOST_CHECK(aramstage_alloc(&a, 32) == 0x4020 && a.next == 0x4040);
+    HOST_CHECK(aramstage_alloc(&a, 33) == 0x4040 && a.next == 0x4080);
+
+    // exactly full, then nothing more
+    HOST_CHECK(aramstage_alloc(&a, 0x1000000 - 0x4080) == 0x4080 && a.next == 0x1000000);
+    HOST_CHECK(aramstage_alloc(&a, 1) == 0 && a.next == 0x1000000);
+
+    // one byte too many rounds up past the top
+    a = (aramstage_t) { 0x4000, 0x1000000, 0x4000 };
+    HOST_CHECK(aramstage_alloc(&a, 0x1000000 - 0x4000 - 31) == 0x4000);
+    a = (aramstage_t) { 0x4000, 0x1000000, 0x4000 };
+    HOST_CHECK(aramstage_alloc(&a, 0x1000000 - 0x4000 + 1) == 0 && a.next == 0x4000);
+
+    // sizes that wrap when rounded, or that wrap 'next'
+    HOST_CHECK(aramstage_alloc(&a, 0xFFFFFFF0) == 0 && a.next == 0x4000);
+    HOST_CHECK(aramstage_alloc(&a, 0xFFFFC000) == 0 && a.next == 0x4000);
+    a = (aramstage_t) { 0x20, 0xFFFFFFE0, 0xFFFFFF00 };
+    HOST_CHECK(aramstage_alloc(&a, 0x100) == 0 && a.next == 0xFFFFFF00);
+    HOST_CHECK(aramstage_alloc(&a, 0xE0) == 0xFFFFFF00 && a.next == 0xFFFFFFE0);
+
+    // an allocator that was never set up has nothing to give
+    a = (aramstage_t) { 0, 0, 0 };
+    HOST_CHECK(aramstage_alloc(&a, 32) == 0);
+
+    // 'next' past 'top' is full, not a huge free range
+    a = (aramstage_t) { 0x4000, 0x8000, 0x8020 };
+    HOST_CHECK(aramstage_alloc(&a, 32) == 0);
+}
+
+typedef struct {
+    u32 size;
+    u32 next;			// reads must not go back before this
+    u32 fail_at;		// fail the read covering this offset, if set
+} file_t;
+
+static u8 file_byte(u32 ofs)
+{
+    return (ofs * 2654435761u) >> 24 ^ ofs >> 13;
+}
+
+static int file_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    file_t *f = ctx;
+    u8 *p = buf;
+
+    HOST_CHECK(ofs >= f->next);
+    if (ofs > f->size || len > f->size - ofs)
+        return -1;
+    if (f->fail_at && f->fail_at >= ofs && f->fail_at < ofs + len)
+        return -1;
+    for (u32 i = 0; i < len; i++)
+        p[i] = file_byte(ofs + i);
+    f->next = ofs + len;
+
+    // what was just read is in the data cache, not in memory yet
+    for (u32 a = (u32) (uintptr_t) buf & ~31; a < (u32) (uintptr_t) buf + len; a += 32)
+        *gcmem_line(a) &= ~GCMEM_DC_FLUSHED;
+    return 0;
+}
+
+// the heap is where it was, the bounce buffer was freed
+static u32 heap_top(void)
+{
+    void *p = memalign(32, 32);
+    free(p);
+    return (u32) (uintptr_t) p;
+}
+
+static void park(void)
+{
+    static const u32 sizes[] = {
+        32, ARAMSTAGE_CHUNK - 32, ARAMSTAGE_CHUNK, ARAMSTAGE_CHUNK + 32,
+        3 * ARAMSTAGE_CHUNK, 1024 * 1024 + 96,
+    };
+    file_t file = { 4 * 1024 * 1024, 0, 0 };
+    u32 ofs = 0x120, prev_end;
+
+    printf("park\n");
+    gcmem_reset(ARENA_LO, ARENA_HI, 0xAA);
+    aramstage_reset();
+
+    u32 free0 = aramstage_free();
+    HOST_CHECK(free0 == GCMEM_ARAM_SIZE - GCMEM_ARAM_BASE);
+    u32 heap = heap_top();
+    prev_end = GCMEM_ARAM_BASE;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        u32 size = sizes[i];
+        u32 aram = aramstage_park(file_read, &file, ofs, size);
+
+        if (!HOST_CHECK(aram == prev_end))
+            return;
+        HOST_CHECK(file.next == ofs + size);
+        for (u32 k = 0; k < size; k++)
+            if (gcmem_aram[aram + k] != file_byte(ofs + k))
+            {
+                HOST_CHECK(!"parked data");
+                fprintf(stderr, "  %u bytes at %08X, byte %u\n", size, aram, k);
+                break;
+            }
+        prev_end = aram + size;
+        ofs += size + 0x40;
+    }
+    HOST_CHECK(aramstage_free() == free0 - (prev_end - GCMEM_ARAM_BASE));
+    HOST_CHECK(heap_top() == heap);
+    HOST_CHECK(gcmem_dma_errors == 0);
+
+    // a read error gives nothing back, but keeps its ARAM
+    file.fail_at = ofs + ARAMSTAGE_CHUNK + 100;
+    HOST_CHECK(aramstage_park(file_read, &file, ofs, 2 * ARAMSTAGE_CHUNK) == 0);
+    HOST_CHECK(heap_top() == heap);
+    file.fail_at = 0;
+    ofs += 2 * ARAMSTAGE_CHUNK;
+
+    // too big for what is left, nothing read or allocated
+    u32 left = aramstage_free();
+    file.next = ofs;
+    HOST_CHECK(aramstage_park(file_read, &file, ofs, left + 32) == 0);
+    HOST_CHECK(file.next == ofs && aramstage_free() == left);
+
+    // no memory for the bounce buffer
+    gcmem_reset(ARENA_LO, ARENA_LO + ARAMSTAGE_CHUNK, 0xAA);
+    HOST_CHECK(aramstage_park(file_read, &file, ofs, 32) == 0);
+
+    // a reset gives all of it back
+    aramstage_reset();
+    HOST_CHECK(aramstage_free() == free0);
+}
+
+int main(void)
+{
+    printf("alloc model\n");
+    alloc_random(GCMEM_ARAM_BASE, GCMEM_ARAM_SIZE);
+    alloc_random(0x20, 0x1000);
+    alloc_random(0x20, 0xFFFFFFE0);
+    alloc_edges();
+    park();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
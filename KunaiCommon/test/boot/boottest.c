@@ -0,0 +1,371 @@
+/*
+ * boottest.c
+ *
+ * bootprobe on real threads: the detection of all three slots overlaps,
+ * the card bring-up doesn't, it goes through the cards in boot order and
+ * never has two of them inside card_io at once. Then the cards handed to
+ * load_fat() and the ones bootprobe_finish() shuts down.
+ *
+ * Then the loader's boot order over several boots, each one a forked child
+ * sharing exiflash with the next: the last source is tried before any
+ * probe, and the record costs one read of the flash per boot and a write
+ * only when the source changed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sdcard/gcsd.h>
+
+#include "bootprobe/bootprobe.h"
+#include "bootprobe/bootlast.h"
+#include "kunaigc/kunaistorage.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "gecko/geckopeer.h"
+#include "kunai/exiflash.h"
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+u8 *dol;
+
+void dol_alloc(int size)
+{
+    (void) size;
+}
+
+//---------------------------------------------------------------------------------
+// LWP threads as pthreads
+//---------------------------------------------------------------------------------
+#define MAX_THREADS	8
+
+static pthread_t threads[MAX_THREADS];
+static u32 thread_count;
+static int lwp_fails;			// LWP_CreateThread() fails when set
+
+s32 LWP_CreateThread(lwp_t *thethread, void *(*entry)(void *), void *arg,
+                     void *stackbase, u32 stack_size, u8 prio)
+{
+    (void) stackbase;
+    (void) stack_size;
+    (void) prio;
+    if (lwp_fails || thread_count == MAX_THREADS)
+        return -1;
+    if (pthread_create(&threads[thread_count], NULL, entry, arg))
+        return -1;
+    *thethread = thread_count++;
+    return 0;
+}
+
+s32 LWP_JoinThread(lwp_t thethread, void **value_ptr)
+{
+    return pthread_join(threads[thethread], value_ptr);
+}
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = { 0, ms * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// the slots, and a log of what happened in them in order
+//---------------------------------------------------------------------------------
+enum event {
+    EV_PROBE_START,
+    EV_PROBE_END,
+    EV_STARTUP_START,
+    EV_STARTUP_END,
+    EV_SHUTDOWN,
+};
+
+typedef struct {
+    int attached;			// EXI_ProbeEx() sees something
+    int card;				// and it is a card that comes up
+    int probe_ms;			// how long the EXI takes to tell
+    int up;				// started and not shut down
+    int startups;
+    int shutdowns;
+} slot_t;
+
+static slot_t slots[3];
+static atomic_int in_card_io;
+static atomic_int card_io_overlaps;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct { enum event ev; s32 chan; } event_log[64];
+static int events;
+
+static void log_event(enum event ev, s32 chan)
+{
+    pthread_mutex_lock(&log_lock);
+    if (events < 64)
+    {
+        event_log[events].ev = ev;
+        event_log[events].chan = chan;
+        events++;
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+// position of the event in the log, -1 if it didn't happen
+static int event_at(enum event ev, s32 chan)
+{
+    for (int i = 0; i < events; i++)
+        if (event_log[i].ev == ev && event_log[i].chan == chan)
+            return i;
+    return -1;
+}
+
+s32 EXI_ProbeEx(s32 chan)
+{
+    log_event(EV_PROBE_START, chan);
+    sleep_ms(slots[chan].probe_ms);
+    log_event(EV_PROBE_END, chan);
+    return slots[chan].attached;
+}
+
+// card_io's state is shared, only one card may be in there at a time
+static bool card_startup(s32 chan)
+{
+    if (atomic_fetch_add(&in_card_io, 1))
+        atomic_fetch_add(&card_io_overlaps, 1);
+    log_event(EV_STARTUP_START, chan);
+    slots[chan].startups++;
+    sleep_ms(5);
+    slots[chan].up = slots[chan].attached;
+    log_event(EV_STARTUP_END, chan);
+    atomic_fetch_sub(&in_card_io, 1);
+    return slots[chan].up;
+}
+
+static bool card_inserted(s32 chan)
+{
+    return slots[chan].up && slots[chan].card;
+}
+
+static bool card_shutdown(s32 chan)
+{
+    log_event(EV_SHUTDOWN, chan);
+    slots[chan].shutdowns++;
+    slots[chan].up = 0;
+    return true;
+}
+
+#define SLOT(name, chan) \
+    static bool slot_##name##_startup(void) { return card_startup(chan); } \
+    static bool slot_##name##_inserted(void) { return card_inserted(chan); } \
+    static bool slot_##name##_shutdown(void) { return card_shutdown(chan); } \
+    const DISC_INTERFACE __io_gcsd##name = { \
+        .startup = slot_##name##_startup, .isInserted = slot_##name##_inserted, \
+        .shutdown = slot_##name##_shutdown, \
+    };
+
+SLOT(a, EXI_CHANNEL_0)
+SLOT(b, EXI_CHANNEL_1)
+SLOT(2, EXI_CHANNEL_2)
+
+static void reset(void)
+{
+    memset(slots, 0, sizeof(slots));
+    events = 0;
+    thread_count = 0;
+    atomic_store(&card_io_overlaps, 0);
+    geckopeer_reset(-1);
+}
+
+//---------------------------------------------------------------------------------
+// tests
+//---------------------------------------------------------------------------------
+
+// a card in B and SP2, a Gecko in A, SP2 slow to detect
+static void mixed(void)
+{
+    printf("%s\n", lwp_fails ? "mixed, no threads" : "mixed");
+    reset();
+    slots[EXI_CHANNEL_1] = (slot_t) { .attached = 1, .card = 1 };
+    slots[EXI_CHANNEL_0] = (slot_t) { .attached = 1, .card = 1 };
+    slots[EXI_CHANNEL_2] = (slot_t) { .attached = 1, .card = 1, .probe_ms = 50 };
+    geckopeer_reset(EXI_CHANNEL_0);
+
+    bootprobe_start();
+    HOST_CHECK(!bootprobe_present(BOOTPROBE_USB_B));
+    HOST_CHECK(bootprobe_present(BOOTPROBE_SD_B));
+    HOST_CHECK(bootprobe_present(BOOTPROBE_USB_A));
+    HOST_CHECK(!bootprobe_present(BOOTPROBE_SD_A));
+    HOST_CHECK(bootprobe_present(BOOTPROBE_SD2));
+
+    // one card at a time, in boot order, none behind the Gecko
+    HOST_CHECK(atomic_load(&card_io_overlaps) == 0);
+    HOST_CHECK(slots[EXI_CHANNEL_0].startups == 0 && event_at(EV_PROBE_START, EXI_CHANNEL_0) < 0);
+    HOST_CHECK(event_at(EV_STARTUP_END, EXI_CHANNEL_1) < event_at(EV_STARTUP_START, EXI_CHANNEL_2));
+    HOST_CHECK(event_at(EV_PROBE_END, EXI_CHANNEL_2) < event_at(EV_STARTUP_START, EXI_CHANNEL_2));
+
+    // with threads, B's card comes up while SP2 is still being detected
+    if (!lwp_fails)
+        HOST_CHECK(event_at(EV_STARTUP_START, EXI_CHANNEL_1) < event_at(EV_PROBE_END, EXI_CHANNEL_2));
+
+    // load_fat() takes B's card once, finish shuts down the one nobody took
+    HOST_CHECK(bootprobe_take(&__io_gcsdb));
+    HOST_CHECK(!bootprobe_take(&__io_gcsdb));
+    HOST_CHECK(!bootprobe_take(&__io_gcsda));
+    bootprobe_finish();
+    HOST_CHECK(slots[EXI_CHANNEL_1].shutdowns == 0 && slots[EXI_CHANNEL_1].up);
+    HOST_CHECK(slots[EXI_CHANNEL_2].shutdowns == 1 && !slots[EXI_CHANNEL_2].up);
+
+    // nothing left to take after the finish
+    HOST_CHECK(!bootprobe_take(&__io_gcsd2));
+    HOST_CHECK(!bootprobe_present(BOOTPROBE_SD_B));
+}
+
+// nothing in B, an adapter without a card in A, nothing answering in SP2
+static void empty(void)
+{
+    printf("empty\n");
+    reset();
+    slots[EXI_CHANNEL_0] = (slot_t) { .attached = 1, .card = 0, .probe_ms = 10 };
+
+    bootprobe_start();
+    for (int src = 0; src < BOOTPROBE_COUNT; src++)
+        HOST_CHECK(!bootprobe_present(src));
+
+    // only A got as far as card_io, and was shut down right there
+    HOST_CHECK(slots[EXI_CHANNEL_1].startups == 0 && slots[EXI_CHANNEL_2].startups == 0);
+    HOST_CHECK(slots[EXI_CHANNEL_0].startups == 1 && slots[EXI_CHANNEL_0].shutdowns == 1);
+    HOST_CHECK(event_at(EV_PROBE_END, EXI_CHANNEL_1) >= 0);
+    HOST_CHECK(event_at(EV_PROBE_END, EXI_CHANNEL_2) >= 0);
+    bootprobe_finish();
+    HOST_CHECK(slots[EXI_CHANNEL_0].shutdowns == 1);
+}
+
+// main()'s order: the last source, then the probe, then the record
+static int boot(int *probed)
+{
+    static const struct { int src; s32 chan; } order[] = {
+        { BOOTPROBE_SD_B, EXI_CHANNEL_1 },
+        { BOOTPROBE_SD_A, EXI_CHANNEL_0 },
+        { BOOTPROBE_SD2, EXI_CHANNEL_2 },
+    };
+    bootlast_t last, record;
+    int src = BOOTPROBE_COUNT;
+
+    *probed = 0;
+    if (bootlast_load(&last))
+    {
+        for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+            if (order[i].src == last.src && slots[order[i].chan].card)
+                src = last.src;
+    }
+
+    if (src == BOOTPROBE_COUNT)
+    {
+        *probed = 1;
+        bootprobe_start();
+        for (size_t i = 0; i < sizeof(order) / sizeof(order[0]) && src == BOOTPROBE_COUNT; i++)
+            if (bootprobe_present(order[i].src))
+                src = order[i].src;
+        bootprobe_finish();
+    }
+    if (src == BOOTPROBE_COUNT)
+        return src;
+
+    memset(&record, 0, sizeof(record));
+    record.magic = BOOTLAST_MAGIC;
+    record.src = src;
+    strcpy(record.path, "/KUNAIGC/ipl.dol");
+    bootlast_store(&record);
+    return src;
+}
+
+typedef struct {
+    int want_src;
+    int want_probe;
+    int want_write;
+} boot_t;
+
+static int run_boot(const boot_t *b)
+{
+    int probed;
+
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    kunai_disable();
+    memset(&exiflash_stats, 0, sizeof(exiflash_stats));
+
+    // the menu formats the flash on the very first boot
+    if (kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, KUNAI_STORAGE_FORMAT))
+        kunai_storage_put();
+    u32 programs = exiflash_stats.programs;
+    u32 passthrough = exiflash_stats.passthrough;
+
+    HOST_CHECK(boot(&probed) == b->want_src);
+    HOST_CHECK(probed == b->want_probe);
+    HOST_CHECK((exiflash_stats.programs > programs) == b->want_write);
+
+    // storing what is stored already needs the flash no more
+    bootlast_t last;
+    HOST_CHECK(bootlast_load(&last) && last.src == b->want_src);
+    passthrough = exiflash_stats.passthrough;
+    u32 enables = exiflash_stats.enables;
+    bootlast_store(&last);
+    HOST_CHECK(exiflash_stats.passthrough == passthrough && exiflash_stats.enables == enables);
+
+    kunai_storage_shutdown();
+    HOST_CHECK(exiflash_stats.errors == 0 && exiflash_stats.off_accesses == 0);
+    return host_failures;
+}
+
+// every boot a fresh process on the same flash
+static void reboot(const boot_t *b)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(run_boot(b) != 0);
+
+    int status;
+    HOST_CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void last_source(void)
+{
+    printf("last source\n");
+    reset();
+    exiflash_reset(EXIFLASH_JEDEC);
+    slots[EXI_CHANNEL_1] = (slot_t) { .attached = 1, .card = 1 };
+    slots[EXI_CHANNEL_2] = (slot_t) { .attached = 1, .card = 1 };
+
+    // nothing recorded, probed, B written down
+    reboot(&(boot_t) { BOOTPROBE_SD_B, 1, 1 });
+    // straight to B, no probe and nothing written
+    reboot(&(boot_t) { BOOTPROBE_SD_B, 0, 0 });
+    reboot(&(boot_t) { BOOTPROBE_SD_B, 0, 0 });
+
+    // B's card pulled: probed again, SP2 written down
+    slots[EXI_CHANNEL_1] = (slot_t) { 0 };
+    reboot(&(boot_t) { BOOTPROBE_SD2, 1, 1 });
+    reboot(&(boot_t) { BOOTPROBE_SD2, 0, 0 });
+
+    // B's card back, SP2 still boots first until it goes
+    slots[EXI_CHANNEL_1] = (slot_t) { .attached = 1, .card = 1 };
+    reboot(&(boot_t) { BOOTPROBE_SD2, 0, 0 });
+}
+
+int main(void)
+{
+    mixed();
+    empty();
+    lwp_fails = 1;
+    mixed();
+    lwp_fails = 0;
+    last_source();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * corpus.c
+ *
+ * Section data follows the header in section order, sizes and offsets as
+ * given. Addresses are picked to hit every edge of the placement window.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "corpus.h"
+
+#define HDR	sizeof(dol_header_t)
+
+// everything lands in free memory, nothing is staged
+static const corpus_dol_t window = {
+    "window", {
+        .offset = { HDR, [7] = HDR + 0x10000 },
+        .addr = { 0x80100000, [7] = 0x80200000 },
+        .size = { 0x10000, [7] = 0x4000 },
+        .bss_addr = 0x80300000, .bss_size = 0x8000, .entry = 0x80100000,
+    }, HDR + 0x14000, 1
+};
+
+// text from 0x80003100 like Swiss, the part below the window is big
+// enough for ARAM
+static const corpus_dol_t low_text = {
+    "low_text", {
+        .offset = { HDR, [7] = HDR + 0x200000 },
+        .addr = { 0x80003100, [7] = 0x80203100 },
+        .size = { 0x200000, [7] = 0x20000 },
+        .bss_addr = 0x80223100, .bss_size = 0x40000, .entry = 0x80003100,
+    }, HDR + 0x220000, 1
+};
+
+// sections at and across the loader, staged and moved up by the stub
+static const corpus_dol_t over_loader = {
+    "over_loader", {
+        .offset = { HDR, HDR + 0x1000, [7] = HDR + 0x9000 },
+        .addr = { 0x81300000, 0x81200000, [7] = 0x81700000 },
+        .size = { 0x1000, 0x8000, [7] = 0x2000 },
+        .bss_addr = 0x81702000, .bss_size = 0x1000, .entry = 0x81300000,
+    }, HDR + 0xb000, 1
+};
+
+// odd addresses and sizes below the window, in ARAM and over the loader
+static const corpus_dol_t unaligned = {
+    "unaligned", {
+        .offset = { HDR, HDR + 0x12345, [7] = HDR + 0x12345 + 0x777,
+                    [8] = HDR + 0x12345 + 0x777 + 0x4321 },
+        .addr = { 0x80003105, 0x80400013, [7] = 0x8130fff3, [8] = 0x8007fffd },
+        .size = { 0x12345, 0x777, [7] = 0x4321, [8] = 0x30003 },
+        .bss_addr = 0x80500001, .bss_size = 0x1fff, .entry = 0x80003108,
+    }, HDR + 0x12345 + 0x777 + 0x4321 + 0x30003, 1
+};
+
+// two sections read from the same file data
+static const corpus_dol_t shared_data = {
+    "shared_data", {
+        .offset = { HDR, [7] = HDR + 0x800 },
+        .addr = { 0x80003100, [7] = 0x80200000 },
+        .size = { 0x1000, [7] = 0x1000 },
+        .entry = 0x80003100,
+    }, HDR + 0x1800, 0
+};
+
+// the stub would clear the BSS over the staged image it works from
+static const corpus_dol_t bss_over_stage = {
+    "bss_over_stage", {
+        .offset = { HDR },
+        .addr = { 0x80003100 },
+        .size = { 0x1000 },
+        .bss_addr = 0x81200000, .bss_size = 0x100000, .entry = 0x80003100,
+    }, HDR + 0x1000, 0
+};
+
+const corpus_dol_t *corpus[] = {
+    &window, &low_text, &over_loader, &unaligned, &shared_data, &bss_over_stage,
+};
+const int corpus_count = sizeof(corpus) / sizeof(corpus[0]);
+
+u8 *corpus_file(const corpus_dol_t *c)
+{
+    u8 *file = malloc(c->file_size);
+
+    for (u32 i = HDR; i < c->file_size; i++)
+        file[i] = corpus_byte(i);
+    memcpy(file, &c->hdr, HDR);
+    return file;
+}
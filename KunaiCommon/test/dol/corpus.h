@@ -0,0 +1,36 @@
+/*
+ * corpus.h
+ *
+ * DOL headers for the dolload and stub tests, laid out the way the loader
+ * sees them: the arena runs from CORPUS_ARENA_LO to the loader at
+ * CORPUS_ARENA_HI.
+ */
+
+#ifndef CORPUS_H_
+#define CORPUS_H_
+
+#include "dolload/dolload.h"
+
+#define CORPUS_ARENA_LO		0x80080000
+#define CORPUS_ARENA_HI		0x81300000
+
+typedef struct {
+    const char *name;
+    dol_header_t hdr;
+    u32 file_size;
+    int loads;			// dolload_load() is expected to return an image
+} corpus_dol_t;
+
+extern const corpus_dol_t *corpus[];
+extern const int corpus_count;
+
+// byte 'ofs' of every corpus file, past the header
+static inline u8 corpus_byte(u32 ofs)
+{
+    return (ofs * 2654435761u) >> 24 ^ ofs >> 11;
+}
+
+// the whole file, header included, free() it
+u8 *corpus_file(const corpus_dol_t *c);
+
+#endif /* CORPUS_H_ */
@@ -0,0 +1,170 @@
+/*
+ * dolplantest.c
+ *
+ * dolload_check() and dolload_plan() on the corpus and on headers built to
+ * hit single rules. Every plan is checked against what the pieces have to
+ * add up to, with and without ARAM to park in.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dolload/dolload.h"
+
+#include "host.h"
+#include "dol/corpus.h"
+
+#define WIN_LO		(CORPUS_ARENA_LO + DOLLOAD_HEAP_RESERVE)
+#define WIN_HI		CORPUS_ARENA_HI
+#define ARAM_FREE	(16 * 1024 * 1024 - 0x4000)
+
+#define ALIGN32(x)	(((x) + 31) & ~31)
+
+static int check_plan(const dol_header_t *hdr, u32 win_lo, u32 win_hi, u32 aram_free,
+                      const dolload_plan_t *plan)
+{
+    u32 covered[DOL_SECTIONS] = { 0 };
+    u32 direct = 0, aram = 0, staged = 0;
+    int extra = 0, ok = 1;
+
+    for (int i = 0; i < plan->count; i++)
+    {
+        const dolload_piece_t *p = &plan->piece[i];
+        int s = p->section;
+
+        // sorted by file offset, no two read the same bytes
+        if (i)
+            ok &= HOST_CHECK(p->file_ofs >= plan->piece[i - 1].file_ofs + plan->piece[i - 1].size);
+
+        // a piece of its section, file and memory offsets in step
+        ok &= HOST_CHECK(p->size && p->addr >= hdr->addr[s] &&
+                         p->addr + p->size <= hdr->addr[s] + hdr->size[s]);
+        ok &= HOST_CHECK(p->file_ofs - hdr->offset[s] == p->addr - hdr->addr[s]);
+        covered[s] += p->size;
+
+        if (p->direct)
+        {
+            ok &= HOST_CHECK(!p->aram && p->addr >= win_lo && p->addr + p->size <= win_hi);
+            direct += p->size;
+            continue;
+        }
+
+        ok &= HOST_CHECK(p->addr + p->size <= win_lo || p->addr >= win_hi);
+        u32 head = ALIGN32(p->addr) - p->addr;
+        u32 tail = (p->size - head) & 31;
+        if (p->aram)
+        {
+            ok &= HOST_CHECK(p->size >= DOLLOAD_ARAM_MIN);
+            aram += p->size - head - tail;
+            staged += ALIGN32(head) + ALIGN32(tail);
+            extra += 1 + !!head + !!tail;
+        }
+        else
+        {
+            staged += ALIGN32(p->size);
+        }
+    }
+
+    for (int s = 0; s < DOL_SECTIONS; s++)
+        ok &= HOST_CHECK(covered[s] == hdr->size[s]);
+
+    ok &= HOST_CHECK(plan->direct_size == direct);
+    ok &= HOST_CHECK(plan->aram_size == aram && aram <= aram_free);
+    ok &= HOST_CHECK(plan->extra_count == extra);
+    ok &= HOST_CHECK(plan->staged_size ==
+                     staged + sizeof(*hdr) + ALIGN32(extra * sizeof(dolload_extra_t)));
+    return ok;
+}
+
+static void corpus_plans(void)
+{
+    dolload_plan_t plan;
+
+    for (int i = 0; i < corpus_count; i++)
+    {
+        const corpus_dol_t *c = corpus[i];
+        const dol_header_t *hdr = &c->hdr;
+
+        printf("%s\n", c->name);
+        HOST_CHECK(dolload_check(hdr, c->file_size));
+
+        // a plan can fail on shared file data only, the rest is dolload_load's
+        int shared = !strcmp(c->name, "shared_data");
+        for (u32 aram_free = 0; aram_free <= ARAM_FREE; aram_free += ARAM_FREE)
+        {
+            int res = dolload_plan(hdr, WIN_LO, WIN_HI, aram_free, &plan);
+            if (!HOST_CHECK(res == (shared ? -1 : 0)) || res)
+                continue;
+            check_plan(hdr, WIN_LO, WIN_HI, aram_free, &plan);
+            if (!aram_free)
+                HOST_CHECK(plan.aram_size == 0);
+        }
+
+        // sections over the loader are always staged
+        dolload_plan(hdr, WIN_LO, WIN_HI, ARAM_FREE, &plan);
+        for (int k = 0; k < plan.count; k++)
+            if (plan.piece[k].addr >= CORPUS_ARENA_HI)
+                HOST_CHECK(!plan.piece[k].direct);
+    }
+}
+
+static void check_rules(void)
+{
+    const corpus_dol_t *c = corpus[0];
+    dol_header_t hdr;
+
+    printf("dolload_check\n");
+#define REJECT(field, value) \
+    do { hdr = c->hdr; hdr.field = (value); HOST_CHECK(!dolload_check(&hdr, c->file_size)); } while (0)
+    REJECT(offset[0], 0x80);                    // inside the header
+    REJECT(offset[0], c->file_size);            // past the end of the file
+    REJECT(size[7], c->file_size);              // runs past the end
+    REJECT(addr[0], 0x81800000);                // above main memory
+    REJECT(addr[0], 0x7ffffff0);                // below it
+    REJECT(addr[7], 0x817fffff);                // runs off the top
+    REJECT(entry, 0x90000000);
+    REJECT(bss_addr, 0x817ff000);               // BSS off the top
+#undef REJECT
+    HOST_CHECK(!dolload_check(&c->hdr, sizeof(dol_header_t) - 1));
+
+    // a section straddling both window edges leaves a staged piece on
+    // each side, four text sections need eight of seven text slots. Plans
+    // don't care that they share memory.
+    printf("staged header slots\n");
+    dolload_plan_t plan;
+    memset(&hdr, 0, sizeof(hdr));
+    for (int i = 0; i < 4; i++)
+    {
+        hdr.offset[i] = sizeof(hdr) + i * 0x1000;
+        hdr.addr[i] = 0x80100000 - 0x100;
+        hdr.size[i] = 0x1000;
+    }
+    HOST_CHECK(dolload_plan(&hdr, 0x80100000, 0x80100040, 0, &plan) == -1);
+    // three fit
+    hdr.size[3] = 0;
+    HOST_CHECK(dolload_plan(&hdr, 0x80100000, 0x80100040, 0, &plan) == 0);
+    HOST_CHECK(check_plan(&hdr, 0x80100000, 0x80100040, 0, &plan));
+
+    // parked pieces take no slots
+    hdr.size[3] = DOLLOAD_ARAM_MIN * 2;
+    hdr.addr[3] = 0x80200000;
+    HOST_CHECK(dolload_plan(&hdr, 0x80100000, 0x80100040, ARAM_FREE, &plan) == 0);
+    HOST_CHECK(check_plan(&hdr, 0x80100000, 0x80100040, ARAM_FREE, &plan));
+    HOST_CHECK(plan.aram_size == DOLLOAD_ARAM_MIN * 2);
+
+    // and only as much is parked as there is ARAM, else it takes the last
+    // text slot
+    HOST_CHECK(dolload_plan(&hdr, 0x80100000, 0x80100040, DOLLOAD_ARAM_MIN, &plan) == 0);
+    HOST_CHECK(check_plan(&hdr, 0x80100000, 0x80100040, DOLLOAD_ARAM_MIN, &plan));
+    HOST_CHECK(plan.aram_size == 0);
+}
+
+int main(void)
+{
+    corpus_plans();
+    check_rules();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * elftest.c
+ *
+ * Loads the ELFs in fixtures/, linked from prog.s for the GameCube, with
+ * the real elfload_load() into GameCube memory mapped on the host and runs
+ * stub_ref() on the staged image. What every PT_LOAD segment should look
+ * like is taken from the file as it is on disk.
+ *
+ * The files are big-endian. elfload reads the ELF and program headers in
+ * the CPU's byte order, so the test hands it a copy with those swapped to
+ * the host's; the segment data is bytes and stays as it is.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "elfload/elfload.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "stub_ref.h"
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+typedef struct {
+    const char *name;
+    int err;			// elfload_load()'s error, ELFLOAD_OK if it loads
+} fixture_t;
+
+static const fixture_t fixtures[] = {
+    { "low", ELFLOAD_OK },	// all below the loader heap, staged
+    { "physical", ELFLOAD_OK },	// p_paddr in physical memory
+    { "window", ELFLOAD_OK },	// read straight to its address
+    { "loader", ELFLOAD_OK },	// over the loader, staged
+    { "splitbss", ELFLOAD_ERR_BSS },
+    { "unlinked", ELFLOAD_ERR_SEGMENTS },
+};
+
+typedef struct {
+    const u8 *data;
+    u32 size;
+    u32 next;			// reads must not go back before this
+} file_t;
+
+static int file_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    file_t *f = ctx;
+
+    HOST_CHECK(ofs >= f->next);
+    if (ofs > f->size || len > f->size - ofs)
+        return -1;
+    memcpy(buf, f->data + ofs, len);
+    f->next = ofs + len;
+    return 0;
+}
+
+static u8 *load_file(const char *name, u32 *size)
+{
+    char path[256];
+    FILE *fp;
+    u8 *data = NULL;
+    long n;
+
+    snprintf(path, sizeof(path), "%s/%s.elf", ELF_FIXTURES, name);
+    if (!(fp = fopen(path, "rb")))
+    {
+        perror(path);
+        exit(1);
+    }
+    if (fseek(fp, 0, SEEK_END) || (n = ftell(fp)) < (long) sizeof(elf32_ehdr_t) ||
+        fseek(fp, 0, SEEK_SET) || !(data = malloc(n)) || fread(data, 1, n, fp) != (size_t) n)
+    {
+        fprintf(stderr, "%s: can't read\n", path);
+        exit(1);
+    }
+    fclose(fp);
+    *size = n;
+    return data;
+}
+
+static u32 be32(const u8 *p)
+{
+    return (u32) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static u32 to_cached(u32 addr)
+{
+    return addr < 0x01800000 ? addr | 0x80000000 : addr;
+}
+
+// the ELF and program headers of 'be' in the host's byte order
+static u8 *host_headers(const u8 *be, u32 size)
+{
+    u8 *h = malloc(size);
+    elf32_ehdr_t *e = (elf32_ehdr_t *) h;
+
+    memcpy(h, be, size);
+    e->type = ntohs(e->type);
+    e->machine = ntohs(e->machine);
+    e->version = ntohl(e->version);
+    e->entry = ntohl(e->entry);
+    e->phoff = ntohl(e->phoff);
+    e->shoff = ntohl(e->shoff);
+    e->flags = ntohl(e->flags);
+    e->ehsize = ntohs(e->ehsize);
+    e->phentsize = ntohs(e->phentsize);
+    e->phnum = ntohs(e->phnum);
+    e->shentsize = ntohs(e->shentsize);
+    e->shnum = ntohs(e->shnum);
+    e->shstrndx = ntohs(e->shstrndx);
+
+    for (u32 i = 0; i < e->phnum && e->phoff + (i + 1) * 32 <= size; i++)
+    {
+        u32 *w = (u32 *) (h + e->phoff + i * 32);
+        for (int k = 0; k < 8; k++)
+            w[k] = ntohl(w[k]);
+    }
+    return h;
+}
+
+// every PT_LOAD segment at its address, with its tail cleared
+static void check_segments(const u8 *be, u32 size)
+{
+    static const u8 zero[0x10000];
+    u32 phoff = be32(be + 28);
+    int phnum = be[44] << 8 | be[45];
+
+    for (int i = 0; i < phnum; i++)
+    {
+        const u8 *p = be + phoff + i * 32;
+        u32 offset = be32(p + 4), addr = to_cached(be32(p + 12));
+        u32 filesz = be32(p + 16), memsz = be32(p + 20);
+
+        if (be32(p) != ELF_PT_LOAD)
+            continue;
+        if (!HOST_CHECK(!memcmp(gcmem_at(addr), be + offset, filesz)))
+            fprintf(stderr, "  segment %d at %08X\n", i, addr);
+        for (u32 a = addr + filesz; a < addr + memsz; a += sizeof(zero))
+        {
+            u32 n = addr + memsz - a < sizeof(zero) ? addr + memsz - a : sizeof(zero);
+            if (!HOST_CHECK(!memcmp(gcmem_at(a), zero, n)))
+                fprintf(stderr, "  segment %d BSS at %08X\n", i, a);
+        }
+    }
+}
+
+static void run(const fixture_t *t)
+{
+    u32 size;
+    u8 *be = load_file(t->name, &size);
+    u8 *host = host_headers(be, size);
+    const elf32_ehdr_t *ehdr = (const elf32_ehdr_t *) host;
+    u32 head_len = ehdr->phoff + ehdr->phnum * sizeof(elf32_phdr_t);
+    file_t file = { host, size, head_len };
+    int err = 1;
+
+    printf("%s\n", t->name);
+    gcmem_reset(ARENA_LO, ARENA_HI, 0xAA);
+
+    HOST_CHECK(elfload_check(ehdr, size));
+    u8 *image = elfload_load(host, head_len, size, file_read, &file, &err);
+    if (!HOST_CHECK(err == t->err) || !HOST_CHECK(!image == (t->err != ELFLOAD_OK)) || !image)
+        goto out;
+
+    u32 entry = stub_ref(gcmem_at(GCMEM_BASE), gcmem_aram, (u32) (uintptr_t) image, NULL, NULL);
+    HOST_CHECK(entry == to_cached(be32(be + 24)));
+    check_segments(be, size);
+
+out:
+    free(host);
+    free(be);
+}
+
+// headers elfload_check() has to turn down
+static void rejects(void)
+{
+    u32 size;
+    u8 *be = load_file("low", &size);
+    u8 *host = host_headers(be, size);
+    elf32_ehdr_t *ehdr = (elf32_ehdr_t *) host;
+
+    printf("rejects\n");
+    HOST_CHECK(elfload_check(ehdr, size));
+    // the big-endian headers as they are, read on a little-endian CPU
+    HOST_CHECK(!elfload_check((elf32_ehdr_t *) be, size));
+    HOST_CHECK(!elfload_check(ehdr, ehdr->phoff + sizeof(elf32_phdr_t)));
+
+    ehdr->ident[5] = 1;		// little-endian
+    HOST_CHECK(!elfload_check(ehdr, size));
+    ehdr->ident[5] = 2;
+    ehdr->machine = 3;		// x86
+    HOST_CHECK(!elfload_check(ehdr, size));
+    ehdr->machine = ELF_EM_PPC;
+    ehdr->phnum = ELFLOAD_PHNUM_MAX + 1;
+    HOST_CHECK(!elfload_check(ehdr, size));
+
+    free(host);
+    free(be);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++)
+        run(&fixtures[i]);
+    rejects();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
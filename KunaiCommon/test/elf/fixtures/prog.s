@@ -0,0 +1,20 @@
+# A small program for the elfload fixtures: text, 24 KB of data (enough
+# to be parked in ARAM when staged) and two BSS sections.
+
+	.text
+	.globl	_start
+_start:
+	lis	3, buf@ha
+	addi	3, 3, buf@l
+	b	_start
+	.fill	0x200, 4, 0x60000000
+
+	.data
+	.long	0x12345678, 0x9abcdef0
+	.fill	0x1800, 4, 0xdeadbeef
+
+	.section .sbss, "aw", @nobits
+small:	.space	64
+
+	.bss
+buf:	.space	5000
@@ -0,0 +1,198 @@
+/*
+ * fatbench.c
+ *
+ * Runs the steps load_fat() and load_last() take on a FAT image through the
+ * IPL's own ff.c, ffshim.c and fatboot.c, with the card modelled by
+ * filedisk. Prints one CSV line per image, all times in simulated
+ * microseconds:
+ *
+ *   mount_us   f_mount, including the card startup
+ *   open_us    label lookup, f_open by path and fatboot_locate
+ *   dol_us     DOL header and sections through fatboot_map/fatboot_pread
+ *   read_us    the whole file through fatboot_read
+ *   reopen_us  fatboot_reopen after a fresh mount, as load_last does
+ *   hits       sector cache hits and misses over the mount, the open and
+ *   misses     both reads, what load_fat prints after its read
+ *
+ *   fatbench [-l latency_us] [-t KiB/s] [-s startup_us] image...
+ *
+ * Each image needs a "<image>.path" file holding the DOL's path, which
+ * mkimage prints. Exits non-zero if any read returned the wrong data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "fatfs/ff.h"
+#include "etc/ffshim.h"
+#include "fatboot/fatboot.h"
+#include "boottime/boottime.h"
+
+#include "host.h"
+#include "filedisk.h"
+#include "image.h"
+
+boottime_rec_t boottime;
+
+typedef struct {
+    u32 mount_us;
+    u32 open_us;
+    u32 dol_us;
+    u32 read_us;
+    u32 reopen_us;
+    u32 commands;
+    u32 sectors;
+    u32 hits;
+    u32 misses;
+    int contiguous;
+    int ok;
+} result_t;
+
+static u32 since(u64 start)
+{
+    return ticks_to_microsecs(gettime() - start);
+}
+
+static int mount(FATFS *fs, result_t *r)
+{
+    iface = &filedisk;
+    iface_started = 0;
+    u64 start = gettime();
+    FRESULT res = f_mount(fs, "", 1);
+    r->mount_us = since(start);
+    return res == FR_OK;
+}
+
+// what load_fat does for a DOL, sections are read straight to their place
+static int read_dol(FIL *fp, u8 *buf, const u8 *expect, u32 size)
+{
+    u8 hdr[IMAGE_DOL_HDR];
+
+    fatboot_map(fp);
+    if (fatboot_pread(fp, 0, hdr, sizeof(hdr)) != FR_OK)
+        return 0;
+    for (int i = 0; i < 18; i++)
+    {
+        u32 ofs = image_get_be32(hdr + i * 4);
+        u32 len = image_get_be32(hdr + 0x90 + i * 4);
+
+        if (!len)
+            continue;
+        if (ofs + len > size || fatboot_pread(fp, ofs, buf + ofs, len) != FR_OK ||
+            memcmp(buf + ofs, expect + ofs, len))
+            return 0;
+    }
+    return !memcmp(hdr, expect, sizeof(hdr));
+}
+
+static int bench(const char *image, const char *path, const filedisk_timing_t *t, result_t *r)
+{
+    FATFS fs;
+    FIL fp;
+    fatboot_loc_t loc;
+    char label[64];
+
+    memset(r, 0, sizeof(*r));
+    if (filedisk_open(image, t) != 0)
+        return 0;
+    host_clock_reset();
+    memset(&filedisk_stats, 0, sizeof(filedisk_stats));
+
+    if (!mount(&fs, r))
+        return 0;
+
+    u64 start = gettime();
+    f_getlabel("", label, NULL);
+    if (f_open(&fp, path, FA_READ) != FR_OK || fatboot_locate(&fp, &loc) != FR_OK)
+        return 0;
+    r->open_us = since(start);
+    r->contiguous = fp.obj.stat == 2;
+
+    u32 size = f_size(&fp);
+    u8 *expect = malloc(size);
+    u8 *buf = aligned_alloc(32, FATBOOT_BUF_SIZE(size));
+    image_dol(expect, size);
+
+    start = gettime();
+    r->ok = read_dol(&fp, buf, expect, size);
+    r->dol_us = since(start);
+
+    // a fresh FIL, as load_fat opens one per attempt
+    f_open(&fp, path, FA_READ);
+    memset(buf, 0, size);
+    start = gettime();
+    r->ok &= fatboot_read(&fp, buf, size) == FR_OK && !memcmp(buf, expect, size);
+    r->read_us = since(start);
+    f_unmount("");
+
+    // commands and sectors for the mount, the open and both reads
+    r->commands = filedisk_stats.commands;
+    r->sectors = filedisk_stats.sectors;
+    r->hits = sectorcache_stats.hits;
+    r->misses = sectorcache_stats.misses;
+
+    result_t again;
+    if (!mount(&fs, &again))
+        r->ok = 0;
+    start = gettime();
+    if (fatboot_reopen(&fs, &fp, &loc) != FR_OK)
+        r->ok = 0;
+    r->reopen_us = since(start);
+    memset(buf, 0, size);
+    r->ok &= fatboot_read(&fp, buf, size) == FR_OK && !memcmp(buf, expect, size);
+    f_unmount("");
+
+    free(buf);
+    free(expect);
+    filedisk_close();
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    filedisk_timing_t t = { .latency_us = 250, .kib_per_s = 2048, .startup_us = 20000 };
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "l:t:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l': t.latency_us = strtoul(optarg, NULL, 0); break;
+        case 't': t.kib_per_s = strtoul(optarg, NULL, 0); break;
+        case 's': t.startup_us = strtoul(optarg, NULL, 0); break;
+        case 'v': host_verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: fatbench [-l latency_us] [-t KiB/s] [-s startup_us] image...\n");
+            return 2;
+        }
+    }
+
+    printf("image,latency_us,kib_per_s,contiguous,mount_us,open_us,dol_us,read_us,"
+           "reopen_us,commands,sectors,hits,misses,ok\n");
+    for (int i = optind; i < argc; i++)
+    {
+        char name[1024], path[512] = "";
+        snprintf(name, sizeof(name), "%s.path", argv[i]);
+        FILE *f = fopen(name, "r");
+        if (!f || !fgets(path, sizeof(path), f))
+        {
+            fprintf(stderr, "fatbench: no path for %s\n", argv[i]);
+            failed++;
+            continue;
+        }
+        fclose(f);
+        path[strcspn(path, "\n")] = 0;
+
+        result_t r;
+        if (!bench(argv[i], path, &t, &r))
+            r.ok = 0;
+        failed += !r.ok;
+        printf("%s,%u,%u,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d\n", argv[i], t.latency_us,
+               t.kib_per_s, r.contiguous, r.mount_us, r.open_us, r.dol_us, r.read_us,
+               r.reopen_us, r.commands, r.sectors, r.hits, r.misses, r.ok);
+    }
+
+    return failed != 0;
+}
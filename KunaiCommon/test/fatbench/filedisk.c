@@ -0,0 +1,78 @@
+/*
+ * filedisk.c
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "filedisk.h"
+
+filedisk_stats_t filedisk_stats;
+
+static int fd = -1;
+static filedisk_timing_t timing;
+
+int filedisk_open(const char *image, const filedisk_timing_t *t)
+{
+    filedisk_close();
+    if ((fd = open(image, O_RDONLY)) < 0)
+        return -1;
+    timing = *t;
+    return 0;
+}
+
+void filedisk_close(void)
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+static bool startup(void)
+{
+    filedisk_stats.startups++;
+    host_clock_advance_us(timing.startup_us);
+    return fd >= 0;
+}
+
+static bool is_inserted(void)
+{
+    return fd >= 0;
+}
+
+static bool read_sectors(sec_t sector, sec_t count, void *buf)
+{
+    u64 bytes = (u64) count * 512;
+
+    filedisk_stats.commands++;
+    filedisk_stats.sectors += count;
+    host_clock_advance_us(timing.latency_us);
+    if (timing.kib_per_s)
+        host_clock_advance_us(bytes * 1000000 / ((u64) timing.kib_per_s * 1024));
+
+    return pread(fd, buf, bytes, (off_t) sector * 512) == (ssize_t) bytes;
+}
+
+static bool write_sectors(sec_t sector, sec_t count, const void *buf)
+{
+    (void) sector;
+    (void) count;
+    (void) buf;
+    return false;
+}
+
+static bool no_op(void)
+{
+    return true;
+}
+
+const DISC_INTERFACE filedisk = {
+    .ioType = 0x454c4946,   // "FILE"
+    .startup = startup,
+    .isInserted = is_inserted,
+    .readSectors = read_sectors,
+    .writeSectors = write_sectors,
+    .clearStatus = no_op,
+    .shutdown = no_op,
+};
@@ -0,0 +1,33 @@
+/*
+ * filedisk.h
+ *
+ * A DISC_INTERFACE backed by an image file. Every readSectors call costs
+ * 'latency_us' plus the transfer time at 'kib_per_s' on the simulated
+ * clock, the way an SD card command over EXI does.
+ */
+
+#ifndef FILEDISK_H_
+#define FILEDISK_H_
+
+#include <ogc/disc_io.h>
+
+typedef struct {
+    u32 latency_us;     // per command
+    u32 kib_per_s;      // transfer rate, 0 for free transfers
+    u32 startup_us;     // card initialisation
+} filedisk_timing_t;
+
+typedef struct {
+    u32 commands;
+    u32 sectors;
+    u32 startups;
+} filedisk_stats_t;
+
+extern const DISC_INTERFACE filedisk;
+extern filedisk_stats_t filedisk_stats;
+
+// returns 0 on success, the image is opened read-only
+int filedisk_open(const char *image, const filedisk_timing_t *timing);
+void filedisk_close(void);
+
+#endif /* FILEDISK_H_ */
@@ -0,0 +1,63 @@
+/*
+ * image.h
+ *
+ * Contents of the test DOL, so fatbench can check what it read without
+ * keeping a copy of the file next to the image.
+ */
+
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <string.h>
+#include <gccore.h>
+
+#define IMAGE_DOL_NAME      "kunai_boot_executable.dol"
+#define IMAGE_DIR_NAME      "level_%u_directory_with_a_long_name"
+#define IMAGE_FILLER_NAME   "sibling_file_number_%03u.txt"
+#define IMAGE_SIBLINGS      48  // files in front of each path component
+
+#define IMAGE_DOL_HDR       0x100
+#define IMAGE_DOL_SECTIONS  5   // 2 text, 3 data
+
+static inline void image_put_be32(u8 *p, u32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline u32 image_get_be32(const u8 *p)
+{
+    return (u32) p[0] << 24 | (u32) p[1] << 16 | (u32) p[2] << 8 | p[3];
+}
+
+// A DOL of 'size' bytes: a header with two text and three data sections
+// splitting the rest, the body is a pattern of the file offset
+static inline void image_dol(u8 *buf, u32 size)
+{
+    static const u8 share[IMAGE_DOL_SECTIONS] = { 40, 8, 24, 20, 8 };
+    static const u8 slot[IMAGE_DOL_SECTIONS] = { 0, 1, 7, 8, 9 };
+    u32 ofs = IMAGE_DOL_HDR, body = size - IMAGE_DOL_HDR;
+    u32 addr = 0x80003100;
+
+    memset(buf, 0, IMAGE_DOL_HDR);
+    for (int i = 0; i < IMAGE_DOL_SECTIONS; i++)
+    {
+        u32 len = i == IMAGE_DOL_SECTIONS - 1 ? size - ofs : (body / 100 * share[i]) & ~31;
+
+        image_put_be32(buf + 0x00 + slot[i] * 4, ofs);
+        image_put_be32(buf + 0x48 + slot[i] * 4, addr);
+        image_put_be32(buf + 0x90 + slot[i] * 4, len);
+        ofs += len;
+        addr += (len + 31) & ~31;
+    }
+    image_put_be32(buf + 0xd8, addr);
+    image_put_be32(buf + 0xdc, 0x10000);
+    image_put_be32(buf + 0xe0, 0x80003100);
+
+    for (u32 i = IMAGE_DOL_HDR; i < size; i++)
+        buf[i] = (i * 2654435761u) >> 24 ^ i >> 9;
+}
+
+#endif /* IMAGE_H_ */
@@ -0,0 +1,186 @@
+/*
+ * mkimage.c
+ *
+ * Builds a FAT32 or exFAT test image with FatFs' own f_mkfs, linked against
+ * a writable copy of the IPL's FatFs configuration.
+ *
+ *   mkimage <image> <fat32|exfat> <cluster bytes> <contig|frag> <depth>
+ *           [image MiB] [DOL KiB]
+ *
+ * The DOL sits 'depth' directories down, every directory on the way has
+ * IMAGE_SIBLINGS files in front of the next component so the path walk has
+ * something to search. Fragmented DOLs are written 64 KiB at a time with a
+ * cluster of another file in between. Prints the DOL's path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "image.h"
+
+#define FRAG_CHUNK (64 * 1024)
+
+static int fd = -1;
+static LBA_t sectors;
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    (void) pdrv;
+    return fd < 0 ? STA_NOINIT : 0;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buf, LBA_t sector, UINT count)
+{
+    (void) pdrv;
+    return pread(fd, buf, count * 512, sector * 512) == count * 512 ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buf, LBA_t sector, UINT count)
+{
+    (void) pdrv;
+    return pwrite(fd, buf, count * 512, sector * 512) == count * 512 ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buf)
+{
+    (void) pdrv;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(LBA_t *) buf = sectors;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD *) buf = 1;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+
+static int fail(const char *what, FRESULT res)
+{
+    fprintf(stderr, "mkimage: %s failed (%d)\n", what, res);
+    return 1;
+}
+
+static FRESULT put_file(const char *name, const void *buf, UINT len)
+{
+    FIL fp;
+    UINT written;
+    FRESULT res = f_open(&fp, name, FA_WRITE | FA_CREATE_ALWAYS);
+
+    if (res == FR_OK)
+        res = f_write(&fp, buf, len, &written);
+    if (res == FR_OK && written != len)
+        res = FR_DENIED;
+    f_close(&fp);
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 6)
+    {
+        fprintf(stderr, "usage: mkimage <image> <fat32|exfat> <cluster bytes> "
+                        "<contig|frag> <depth> [image MiB] [DOL KiB]\n");
+        return 2;
+    }
+
+    int exfat = !strcmp(argv[2], "exfat");
+    DWORD cluster = strtoul(argv[3], NULL, 0);
+    int frag = !strcmp(argv[4], "frag");
+    int depth = atoi(argv[5]);
+    u64 image_size = (argc > 6 ? strtoull(argv[6], NULL, 0) : 4096) << 20;
+    UINT dol_size = (argc > 7 ? strtoul(argv[7], NULL, 0) : 4096) << 10;
+
+    // sparse, only what f_mkfs and the files touch takes space
+    fd = open(argv[1], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, image_size) != 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    sectors = image_size / 512;
+
+    static BYTE work[64 * 1024];
+    MKFS_PARM opt = { exfat ? FM_EXFAT : FM_FAT32, 2, 0, 0, cluster };
+    FRESULT res = f_mkfs("", &opt, work, sizeof(work));
+    if (res != FR_OK)
+        return fail("f_mkfs", res);
+
+    FATFS fs;
+    if ((res = f_mount(&fs, "", 1)) != FR_OK)
+        return fail("f_mount", res);
+    f_setlabel("KUNAI");
+
+    char path[512] = "";
+    char name[600];
+    for (int level = 0; level < depth; level++)
+    {
+        for (int i = 0; i < IMAGE_SIBLINGS; i++)
+        {
+            snprintf(name, sizeof(name), "%s/" IMAGE_FILLER_NAME, path, i);
+            if ((res = put_file(name, name, strlen(name))) != FR_OK)
+                return fail(name, res);
+        }
+        if (level == depth - 1)
+            break;
+        size_t n = strlen(path);
+        snprintf(path + n, sizeof(path) - n, "/" IMAGE_DIR_NAME, level + 1);
+        if ((res = f_mkdir(path)) != FR_OK)
+            return fail(path, res);
+    }
+
+    u8 *dol = malloc(dol_size);
+    image_dol(dol, dol_size);
+    snprintf(name, sizeof(name), "%s/" IMAGE_DOL_NAME, path);
+
+    if (!frag)
+    {
+        res = put_file(name, dol, dol_size);
+    }
+    else
+    {
+        FIL fp, gap;
+        UINT written;
+        u8 *filler = calloc(1, cluster);
+
+        res = f_open(&fp, name, FA_WRITE | FA_CREATE_ALWAYS);
+        if (res == FR_OK)
+            res = f_open(&gap, "/fragmentation_filler.bin", FA_WRITE | FA_CREATE_ALWAYS);
+        for (UINT ofs = 0; res == FR_OK && ofs < dol_size; ofs += FRAG_CHUNK)
+        {
+            UINT len = dol_size - ofs < FRAG_CHUNK ? dol_size - ofs : FRAG_CHUNK;
+
+            // every chunk gets its own clusters, then one goes to 'gap'
+            if ((res = f_write(&fp, dol + ofs, len, &written)) == FR_OK)
+                res = f_sync(&fp);
+            if (res == FR_OK && (res = f_write(&gap, filler, cluster, &written)) == FR_OK)
+                res = f_sync(&gap);
+        }
+        f_close(&gap);
+        f_close(&fp);
+        free(filler);
+    }
+    if (res != FR_OK)
+        return fail(name, res);
+
+    f_unmount("");
+    close(fd);
+    free(dol);
+
+    printf("%s\n", name);
+    return 0;
+}
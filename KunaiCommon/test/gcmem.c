@@ -0,0 +1,152 @@
+/*
+ * gcmem.c
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ogc/aram.h>
+
+#include "gcmem.h"
+
+u8 gcmem_lines[GCMEM_LINES];
+u8 gcmem_aram[GCMEM_ARAM_SIZE];
+int gcmem_dma_errors;
+
+static u32 arena_lo, arena_hi;
+static u32 heap_top;
+static int mapped;
+
+void gcmem_reset(u32 lo, u32 hi, u8 fill)
+{
+    if (!mapped)
+    {
+        void *p = mmap((void *) GCMEM_BASE, GCMEM_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != (void *) GCMEM_BASE)
+        {
+            perror("gcmem: can't map main memory at 0x80000000");
+            exit(2);
+        }
+        mapped = 1;
+    }
+
+    memset(gcmem_at(GCMEM_BASE), fill, GCMEM_SIZE);
+    memset(gcmem_aram, 0, sizeof(gcmem_aram));
+    memset(gcmem_lines, 0, sizeof(gcmem_lines));
+    gcmem_dma_errors = 0;
+    arena_lo = heap_top = lo;
+    arena_hi = hi;
+}
+
+void *SYS_GetArenaLo(void)
+{
+    return gcmem_at(arena_lo);
+}
+
+void *SYS_GetArenaHi(void)
+{
+    return gcmem_at(arena_hi);
+}
+
+void SYS_SetArenaLo(void *lo)
+{
+    arena_lo = (u32) (uintptr_t) lo;
+}
+
+void SYS_SetArenaHi(void *hi)
+{
+    arena_hi = (u32) (uintptr_t) hi;
+}
+
+// the loader's heap grows up from the arena, freeing only drops the top
+void *gcmem_memalign(size_t align, size_t size)
+{
+    u32 p = (heap_top + align - 1) & ~(align - 1);
+
+    if (p + size > arena_hi)
+        return NULL;
+    heap_top = p + size;
+    return gcmem_at(p);
+}
+
+// freed lines are of no interest anymore, whatever was logged for them
+void gcmem_free(void *ptr)
+{
+    u32 p = (u32) (uintptr_t) ptr;
+
+    if (!ptr)
+        return;
+    for (u32 a = p & ~31; a < heap_top; a += 32)
+        *gcmem_line(a) = 0;
+    heap_top = p;
+}
+
+// buffers of the host itself, outside main memory, aren't logged
+static void mark(void *start, u32 len, u8 bit)
+{
+    uintptr_t addr = (uintptr_t) start;
+
+    if (!len || addr < GCMEM_BASE || addr + len > GCMEM_BASE + GCMEM_SIZE)
+        return;
+    for (u32 a = addr & ~31; a < addr + len; a += 32)
+        *gcmem_line(a) |= bit;
+}
+
+void DCFlushRange(void *start, u32 len)
+{
+    mark(start, len, GCMEM_DC_FLUSHED);
+}
+
+void DCStoreRange(void *start, u32 len)
+{
+    mark(start, len, GCMEM_DC_FLUSHED);
+}
+
+void DCInvalidateRange(void *start, u32 len)
+{
+    mark(start, len, GCMEM_DC_INVALIDATED);
+}
+
+void ICInvalidateRange(void *start, u32 len)
+{
+    mark(start, len, GCMEM_IC_INVALIDATED);
+}
+
+u32 AR_Init(u32 *stack_index, u32 num_entries)
+{
+    (void) stack_index;
+    (void) num_entries;
+    return GCMEM_ARAM_BASE;
+}
+
+u32 AR_GetSize(void)
+{
+    return GCMEM_ARAM_SIZE;
+}
+
+void AR_StartDMA(u32 dir, u32 memaddr, u32 aramaddr, u32 len)
+{
+    if ((memaddr | aramaddr | len) & 31)
+        gcmem_dma_errors++;
+
+    if (dir == AR_MRAMTOARAM)
+    {
+        for (u32 a = memaddr & ~31; a < memaddr + len; a += 32)
+            if (!(*gcmem_line(a) & GCMEM_DC_FLUSHED))
+            {
+                gcmem_dma_errors++;
+                break;
+            }
+        memcpy(gcmem_aram + aramaddr, gcmem_at(memaddr), len);
+    }
+    else
+        memcpy(gcmem_at(memaddr), gcmem_aram + aramaddr, len);
+}
+
+u32 AR_GetDMAStatus(void)
+{
+    return 0;
+}
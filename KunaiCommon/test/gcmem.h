@@ -0,0 +1,49 @@
+/*
+ * gcmem.h
+ *
+ * GameCube main memory and ARAM for host tests of the loader modules. The
+ * 24 MB of main memory are mapped at 0x80000000 itself, so the modules'
+ * casts between pointers and u32 addresses hold on a 64 bit host too.
+ * Cache maintenance calls are logged per cache line.
+ */
+
+#ifndef GCMEM_H_
+#define GCMEM_H_
+
+#include <gccore.h>
+
+#define GCMEM_BASE	0x80000000
+#define GCMEM_SIZE	(24 * 1024 * 1024)
+#define GCMEM_ARAM_SIZE	(16 * 1024 * 1024)
+// AR_Init() keeps the start of ARAM for the DSP
+#define GCMEM_ARAM_BASE	0x4000
+
+#define GCMEM_LINES	(GCMEM_SIZE / 32)
+
+// bits in gcmem_lines[], one byte per cache line of main memory
+#define GCMEM_DC_FLUSHED	0x01	// DCFlushRange or DCStoreRange
+#define GCMEM_DC_INVALIDATED	0x02
+#define GCMEM_IC_INVALIDATED	0x04
+
+extern u8 gcmem_lines[GCMEM_LINES];
+extern u8 gcmem_aram[GCMEM_ARAM_SIZE];
+
+// ARAM DMAs that weren't whole cache lines, or that went out from main
+// memory not flushed from the data cache first
+extern int gcmem_dma_errors;
+
+// maps main memory on the first call, then fills it with 'fill' and
+// resets the arena, the ARAM and the line log
+void gcmem_reset(u32 arena_lo, u32 arena_hi, u8 fill);
+
+static inline u8 *gcmem_at(u32 addr)
+{
+    return (u8 *) (uintptr_t) addr;
+}
+
+static inline u8 *gcmem_line(u32 addr)
+{
+    return &gcmem_lines[(addr - GCMEM_BASE) / 32];
+}
+
+#endif /* GCMEM_H_ */
@@ -0,0 +1,121 @@
+/*
+ * geckopeer.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "geckopeer.h"
+
+geckopeer_t geckopeer;
+
+void geckopeer_reset(s32 channel)
+{
+    free(geckopeer.in);
+    free(geckopeer.out);
+    memset(&geckopeer, 0, sizeof(geckopeer));
+    geckopeer.channel = channel;
+    geckopeer.alive = channel >= 0;
+}
+
+static void grow(u8 **buf, u32 *cap, u32 need)
+{
+    if (need <= *cap)
+        return;
+    while (*cap < need)
+        *cap = *cap ? *cap * 2 : 4096;
+    *buf = realloc(*buf, *cap);
+}
+
+void geckopeer_push(const void *data, u32 len)
+{
+    // drop what was read already before growing
+    if (geckopeer.in_pos == geckopeer.in_len)
+        geckopeer.in_pos = geckopeer.in_len = 0;
+    grow(&geckopeer.in, &geckopeer.in_cap, geckopeer.in_len + len);
+    memcpy(geckopeer.in + geckopeer.in_len, data, len);
+    geckopeer.in_len += len;
+}
+
+void geckopeer_clear_out(void)
+{
+    geckopeer.out_len = 0;
+}
+
+static int here(s32 chn)
+{
+    return geckopeer.alive && chn == geckopeer.channel;
+}
+
+static void spend_bytes(u32 n)
+{
+    geckopeer.busy_ns += (u64) n * GECKOPEER_BYTE_NS;
+    host_clock_advance_us(geckopeer.busy_ns / 1000);
+    geckopeer.busy_ns %= 1000;
+}
+
+static u32 available(void)
+{
+    if (geckopeer.in_pos == geckopeer.in_len && geckopeer.on_idle)
+        geckopeer.on_idle(&geckopeer);
+    return geckopeer.in_len - geckopeer.in_pos;
+}
+
+int usb_isgeckoalive(s32 chn)
+{
+    return here(chn);
+}
+
+int usb_checkrecv(s32 chn)
+{
+    if (!here(chn))
+        return 0;
+    host_clock_advance_us(GECKOPEER_CHECK_US);
+    return available() != 0;
+}
+
+void usb_flush(s32 chn)
+{
+    if (here(chn))
+        geckopeer.in_pos = geckopeer.in_len = 0;
+}
+
+int usb_recvbuffer_safe_ex(s32 chn, void *buffer, int size, int retries)
+{
+    u32 n;
+
+    (void) retries;
+    if (!here(chn))
+        return 0;
+    if (!(n = available()))
+    {
+        host_clock_advance_us(GECKOPEER_POLL_US);
+        return 0;
+    }
+    if (n > (u32) size)
+        n = size;
+    memcpy(buffer, geckopeer.in + geckopeer.in_pos, n);
+    geckopeer.in_pos += n;
+    spend_bytes(n);
+    return n;
+}
+
+int usb_sendbuffer_safe_ex(s32 chn, const void *buffer, int size, int retries)
+{
+    (void) retries;
+    if (!here(chn))
+        return 0;
+    if (geckopeer.stalled)
+    {
+        host_clock_advance_us(GECKOPEER_POLL_US);
+        return 0;
+    }
+    grow(&geckopeer.out, &geckopeer.out_cap, geckopeer.out_len + size);
+    memcpy(geckopeer.out + geckopeer.out_len, buffer, size);
+    geckopeer.out_len += size;
+    spend_bytes(size);
+    if (geckopeer.on_send)
+        geckopeer.on_send(&geckopeer, buffer, size);
+    return size;
+}
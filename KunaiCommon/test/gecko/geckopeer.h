@@ -0,0 +1,50 @@
+/*
+ * geckopeer.h
+ *
+ * The PC end of a USB Gecko for host tests. What the console sends is
+ * collected in 'out', what it reads comes from 'in'. A test scripts the PC
+ * through the hooks, which run whenever the console sends or finds nothing
+ * to read. Every byte and every empty poll costs simulated time.
+ */
+
+#ifndef GECKOPEER_H_
+#define GECKOPEER_H_
+
+#include <gccore.h>
+
+// the Gecko's FTDI moves about a MB/s
+#define GECKOPEER_BYTE_NS	1000
+// an empty usb_recvbuffer_safe_ex() or a send the FIFO won't take
+#define GECKOPEER_POLL_US	500
+// a usb_checkrecv(), one register read over EXI
+#define GECKOPEER_CHECK_US	10
+
+typedef struct geckopeer geckopeer_t;
+
+struct geckopeer {
+    s32 channel;
+    int alive;
+    int stalled;		// nobody reads on the PC, sends don't go out
+    u8 *in;			// PC to console
+    u32 in_len, in_pos, in_cap;
+    u8 *out;			// console to PC
+    u32 out_len, out_cap;
+    u64 busy_ns;		// byte time not yet on the clock
+    void (*on_send)(geckopeer_t *p, const u8 *data, u32 len);
+    void (*on_idle)(geckopeer_t *p);
+    void *ctx;
+};
+
+extern geckopeer_t geckopeer;
+
+// a Gecko on 'channel' with nothing queued and no hooks, or none at all
+// for a negative channel
+void geckopeer_reset(s32 channel);
+
+// queue bytes for the console to read
+void geckopeer_push(const void *data, u32 len);
+
+// drop what the console sent so far
+void geckopeer_clear_out(void);
+
+#endif /* GECKOPEER_H_ */
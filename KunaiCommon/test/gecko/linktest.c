@@ -0,0 +1,359 @@
+/*
+ * linktest.c
+ *
+ * geckolink's framed transfers against a scripted PC that sends like
+ * buildtools/geckosend.py: frames streamed up to the window, then only the
+ * gaps an ack or NAK reports. A fault script loses, reorders, damages and
+ * duplicates frames on their way to the console, or loses its acks on the
+ * way back, and the file still has to come through whole. A PC that goes
+ * away has to end the transfer within GECKOLINK_IDLE_MS.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "geckolink/geckolink.h"
+#include "lfs/lfs_util.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "geckopeer.h"
+
+#define CHANNEL		EXI_CHANNEL_1
+#define FILE_SIZE	(100 * 1000)
+#define FRAME_SIZE	1024
+#define FRAMES_MAX	128
+#define ACK_SIZE	20
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+enum fault {
+    PASS = 0,
+    DROP,		// the frame never arrives
+    CORRUPT,		// one data byte flipped, the CRC catches it
+    SHORT,		// a header byte lost, the console has to find the magic again
+    HOLD,		// arrives after the frame sent next
+    TWICE,		// arrives twice
+};
+
+// what happens to one sending of a frame, the first sending is 0
+typedef struct {
+    u32 seq;
+    u32 sending;
+    int fault;
+} fault_t;
+
+typedef struct {
+    const char *name;
+    const fault_t *faults;
+    u32 lose_acks;	// acks after READY lost on the way to the PC
+    u32 quit_after;	// the PC is gone after sending this many frames, 0 never
+    u32 max_ms;		// a nudge for every fault a NAK can't cover, and no more
+} script_t;
+
+// the PC's side
+static struct {
+    const script_t *script;
+    u8 stream[sizeof(geckolink_xfer_t) + FILE_SIZE];
+    u32 total;		// frames
+    u32 window;
+    u32 base, sent;	// first frame not acked, first never sent
+    u32 sendings[FRAMES_MAX];
+    u32 resent;
+    u32 framed;		// PC_FRAMED sent
+    u32 acks, naks, acks_lost;
+    u32 frames_out;	// frames sent in all
+    u8 held[4 * (16 + FRAME_SIZE)];	// HOLD frames waiting for the next one
+    u32 held_len;
+    u8 rx[ACK_SIZE];
+    u32 rx_len;
+} pc;
+
+static u8 file[FILE_SIZE];
+
+static void put32(u8 *p, u32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static u32 get32(const u8 *p)
+{
+    return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static int fault_of(u32 seq, u32 sending)
+{
+    for (const fault_t *f = pc.script->faults; f && f->fault; f++)
+        if (f->seq == seq && f->sending == sending)
+            return f->fault;
+    return PASS;
+}
+
+static void deliver(const u8 *data, u32 len)
+{
+    geckopeer_push(data, len);
+    geckopeer_push(pc.held, pc.held_len);
+    pc.held_len = 0;
+}
+
+static void send_frame(u32 seq)
+{
+    u8 f[16 + FRAME_SIZE];
+    u32 ofs = seq * FRAME_SIZE;
+    u32 len = pc.total - 1 == seq ? sizeof(pc.stream) - ofs : FRAME_SIZE;
+
+    if (pc.script->quit_after && pc.frames_out >= pc.script->quit_after)
+        return;
+    pc.frames_out++;
+
+    f[0] = GECKOLINK_FRAME_MAGIC >> 8;
+    f[1] = GECKOLINK_FRAME_MAGIC & 0xff;
+    f[2] = GECKOLINK_FRAME_DATA;
+    f[3] = seq == pc.total - 1 ? GECKOLINK_FLAG_LAST : 0;
+    put32(f + 4, seq);
+    put32(f + 8, len);
+    memcpy(f + 16, pc.stream + ofs, len);
+    put32(f + 12, ~lfs_crc(lfs_crc(0xffffffff, f, 12), f + 16, len));
+
+    switch (fault_of(seq, pc.sendings[seq]++))
+    {
+    case DROP:
+        break;
+    case CORRUPT:
+        f[16 + len / 2] ^= 0x40;
+        deliver(f, 16 + len);
+        break;
+    case SHORT:
+        memmove(f + 6, f + 7, 16 + len - 7);
+        deliver(f, 16 + len - 1);
+        break;
+    case HOLD:
+        memcpy(pc.held + pc.held_len, f, 16 + len);
+        pc.held_len += 16 + len;
+        break;
+    case TWICE:
+        deliver(f, 16 + len);
+        deliver(f, 16 + len);
+        break;
+    default:
+        deliver(f, 16 + len);
+        break;
+    }
+}
+
+static void fill_window(void)
+{
+    u32 limit = pc.base + pc.window < pc.total ? pc.base + pc.window : pc.total;
+
+    while (pc.sent < limit)
+        send_frame(pc.sent++);
+}
+
+// geckosend.py's answer to an ack
+static void on_ack(const u8 *ack)
+{
+    int type = ack[2];
+    u32 next = get32(ack + 4), have = get32(ack + 8);
+
+    if (type == GECKOLINK_ACK_READY && !pc.window)
+    {
+        pc.window = ack[3];
+        fill_window();
+        return;
+    }
+    if (next > pc.base)
+        pc.base = next;
+    if (type == GECKOLINK_NAK)
+    {
+        // everything missing before the newest buffered frame was lost
+        u32 upto = pc.base + (have ? 32 - __builtin_clz(have) : 0);
+        int any = 0;
+
+        pc.naks++;
+        for (u32 s = pc.base; s < upto && s < pc.sent; s++)
+            if (!(have >> (s - pc.base) & 1))
+            {
+                send_frame(s);
+                pc.resent++;
+                any = 1;
+            }
+        if (!any && pc.base < pc.sent)
+        {
+            send_frame(pc.base);
+            pc.resent++;
+        }
+    }
+    else
+        pc.acks++;
+    fill_window();
+}
+
+static void on_send(geckopeer_t *p, const u8 *data, u32 len)
+{
+    (void) p;
+
+    if (!pc.framed)
+    {
+        if (len == 1 && *data == GC_READY)
+        {
+            u8 b = PC_FRAMED;
+            geckopeer_push(&b, 1);
+            pc.framed = 1;
+        }
+        return;
+    }
+
+    // scanned for the magic like the PC does
+    for (u32 i = 0; i < len; i++)
+    {
+        pc.rx[pc.rx_len++] = data[i];
+        if (pc.rx_len == 2 && (pc.rx[0] != (GECKOLINK_ACK_MAGIC >> 8) ||
+                               pc.rx[1] != (GECKOLINK_ACK_MAGIC & 0xff)))
+        {
+            pc.rx[0] = pc.rx[1];
+            pc.rx_len = 1;
+        }
+        if (pc.rx_len == ACK_SIZE)
+        {
+            pc.rx_len = 0;
+            if (~lfs_crc(0xffffffff, pc.rx, 16) != get32(pc.rx + 16))
+                continue;
+            // the READY ack itself always gets through
+            if (pc.window && pc.acks_lost < pc.script->lose_acks)
+            {
+                pc.acks_lost++;
+                continue;
+            }
+            on_ack(pc.rx);
+        }
+    }
+}
+
+static void start(const script_t *s)
+{
+    memset(&pc, 0, sizeof(pc));
+    pc.script = s;
+
+    u32 crc = ~lfs_crc(0xffffffff, file, sizeof(file));
+    put32(pc.stream, GECKOLINK_XFER_MAGIC);
+    put32(pc.stream + 4, sizeof(file));
+    put32(pc.stream + 8, GECKOLINK_MODE_BOOT);
+    put32(pc.stream + 12, crc);
+    strcpy((char *) pc.stream + 16, "linktest.dol");
+    memcpy(pc.stream + sizeof(geckolink_xfer_t), file, sizeof(file));
+    pc.total = (sizeof(pc.stream) + FRAME_SIZE - 1) / FRAME_SIZE;
+
+    geckopeer_reset(CHANNEL);
+    geckopeer.on_send = on_send;
+    host_clock_reset();
+}
+
+// the whole file in uneven reads, returns GECKOLINK_OK or the first error
+static int receive(u8 *buf)
+{
+    geckolink_t gl;
+    int err;
+
+    if (geckolink_connect(&gl, CHANNEL) != GECKOLINK_FRAMED)
+        return GECKOLINK_ERR_PROTO;
+    if ((err = geckolink_begin(&gl)) != GECKOLINK_OK)
+    {
+        geckolink_end(&gl);
+        return err;
+    }
+    HOST_CHECK(gl.xfer.size == sizeof(file) && !strcmp(gl.xfer.name, "linktest.dol"));
+
+    for (u32 pos = 0, n = 1; pos < sizeof(file); pos += n, n = n * 7 % 3001 + 1)
+    {
+        if (n > sizeof(file) - pos)
+            n = sizeof(file) - pos;
+        if ((err = geckolink_read(&gl, buf + pos, n)) != (int) n)
+        {
+            geckolink_end(&gl);
+            return err;
+        }
+    }
+    return geckolink_end(&gl);
+}
+
+static const fault_t lost[] = {
+    { 3, 0, DROP }, { 17, 0, DROP }, { 17, 1, DROP }, { 40, 0, DROP }, { 41, 0, DROP },
+    { 0 },
+};
+static const fault_t reordered[] = {
+    { 5, 0, HOLD }, { 30, 0, HOLD }, { 31, 0, HOLD }, { 60, 0, TWICE },
+    { 0 },
+};
+static const fault_t damaged[] = {
+    { 0, 0, CORRUPT }, { 9, 0, SHORT }, { 10, 0, CORRUPT }, { 50, 0, SHORT }, { 50, 1, CORRUPT },
+    { 0 },
+};
+static const fault_t last_lost[] = {
+    { 97, 0, DROP }, { 97, 1, SHORT },
+    { 0 },
+};
+
+static const script_t scripts[] = {
+    { "clean",     NULL,       0, 0, 1 * GECKOLINK_NUDGE_MS },
+    { "lost",      lost,       0, 0, 2 * GECKOLINK_NUDGE_MS },
+    { "reordered", reordered,  0, 0, 1 * GECKOLINK_NUDGE_MS },
+    { "damaged",   damaged,    0, 0, 2 * GECKOLINK_NUDGE_MS },
+    { "last lost", last_lost,  0, 0, 2 * GECKOLINK_NUDGE_MS },
+    { "acks lost", NULL,       3, 0, 3 * GECKOLINK_NUDGE_MS },
+};
+
+static void transfers(void)
+{
+    static u8 buf[FILE_SIZE];
+
+    for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++)
+    {
+        printf("%s\n", scripts[i].name);
+        start(&scripts[i]);
+        memset(buf, 0, sizeof(buf));
+        if (!HOST_CHECK(receive(buf) == GECKOLINK_OK))
+            continue;
+        HOST_CHECK(!memcmp(buf, file, sizeof(file)));
+        HOST_CHECK(pc.base == pc.total && pc.sent == pc.total);
+
+        u32 ms = ticks_to_millisecs(gettime());
+        printf("  %u frames, %u resent, %u acks, %u naks, %u ms\n",
+               pc.total, pc.resent, pc.acks, pc.naks, ms);
+        if (!scripts[i].faults && !scripts[i].lose_acks)
+            HOST_CHECK(pc.resent == 0 && pc.naks == 0);
+        HOST_CHECK(pc.resent <= 8 && ms < scripts[i].max_ms);
+    }
+}
+
+// the PC is gone halfway, the console gives up after GECKOLINK_IDLE_MS
+static void gone(void)
+{
+    static const script_t s = { "gone", NULL, 0, 40, 0 };
+    static u8 buf[FILE_SIZE];
+
+    printf("%s\n", s.name);
+    start(&s);
+    HOST_CHECK(receive(buf) == GECKOLINK_ERR_TIMEOUT);
+    u32 ms = ticks_to_millisecs(gettime());
+    HOST_CHECK(ms >= GECKOLINK_IDLE_MS && ms < GECKOLINK_IDLE_MS + GECKOLINK_NUDGE_MS);
+    // it kept asking for the missing frame meanwhile
+    HOST_CHECK(pc.naks >= GECKOLINK_IDLE_MS / GECKOLINK_NUDGE_MS - 1);
+}
+
+int main(void)
+{
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    for (u32 i = 0; i < sizeof(file); i++)
+        file[i] = i * 131 + (i >> 9);
+
+    transfers();
+    gone();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * host.c
+ *
+ * The time base only moves when a simulated device says so, which makes
+ * every timing the modules record a deterministic model result instead of
+ * a measure of the host.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "host.h"
+
+int host_verbose;
+int host_failures;
+
+static u64 now;
+
+void host_clock_advance_us(u64 us)
+{
+    now += microsecs_to_ticks(us);
+}
+
+void host_clock_reset(void)
+{
+    now = 0;
+}
+
+u64 gettime(void)
+{
+    return now;
+}
+
+u32 diff_usec(u64 start, u64 end)
+{
+    return ticks_to_microsecs(end - start);
+}
+
+void kprintf(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!host_verbose)
+        return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+int host_check(int ok, const char *what, const char *file, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        host_failures++;
+    }
+    return ok;
+}
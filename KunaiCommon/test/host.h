@@ -0,0 +1,26 @@
+/*
+ * host.h
+ *
+ * Simulated clock and helpers shared by the host tests.
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <gccore.h>
+
+// advance the clock gettime() returns
+void host_clock_advance_us(u64 us);
+void host_clock_reset(void);
+
+// set to print everything the modules kprintf()
+extern int host_verbose;
+
+#define HOST_CHECK(cond) \
+    host_check((cond), #cond, __FILE__, __LINE__)
+
+// counts and reports failures, returns 'ok'
+int host_check(int ok, const char *what, const char *file, int line);
+extern int host_failures;
+
+#endif /* HOST_H_ */
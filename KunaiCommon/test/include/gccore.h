@@ -0,0 +1,38 @@
+/*
+ * gccore.h
+ *
+ * Host stand-in for the parts of libogc the tested modules use. Only types
+ * and macros, anything with behaviour is in host.c.
+ */
+
+#ifndef HOST_GCCORE_H_
+#define HOST_GCCORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef volatile u8 vu8;
+typedef volatile u32 vu32;
+
+#define ATTRIBUTE_ALIGN(v) __attribute__((aligned(v)))
+#define ATTRIBUTE_PACKED __attribute__((packed))
+
+void kprintf(const char *fmt, ...);
+
+#include <ogc/exi.h>
+#include <ogc/system.h>
+#include <ogc/cache.h>
+#include <ogc/aram.h>
+#include <ogc/usbgecko.h>
+#include <ogc/lwp.h>
+
+#endif /* HOST_GCCORE_H_ */
@@ -0,0 +1,20 @@
+/*
+ * malloc.h
+ *
+ * Host stand-in for the modules that allocate buffers they hand to DMA as
+ * 32 bit addresses: memalign() is served from the heap at the bottom of
+ * gcmem.c's arena instead.
+ */
+
+#ifndef HOST_MALLOC_H_
+#define HOST_MALLOC_H_
+
+#include <stdlib.h>
+
+void *gcmem_memalign(size_t align, size_t size);
+void gcmem_free(void *ptr);
+
+#define memalign gcmem_memalign
+#define free gcmem_free
+
+#endif /* HOST_MALLOC_H_ */
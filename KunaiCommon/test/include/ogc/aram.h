@@ -0,0 +1,20 @@
+/*
+ * aram.h
+ *
+ * Host stand-in, the ARAM is an array in gcmem.c and DMA is done at once.
+ */
+
+#ifndef HOST_ARAM_H_
+#define HOST_ARAM_H_
+
+#include <gccore.h>
+
+#define AR_MRAMTOARAM	0
+#define AR_ARAMTOMRAM	1
+
+u32 AR_Init(u32 *stack_index, u32 num_entries);
+u32 AR_GetSize(void);
+void AR_StartDMA(u32 dir, u32 memaddr, u32 aramaddr, u32 len);
+u32 AR_GetDMAStatus(void);
+
+#endif /* HOST_ARAM_H_ */
@@ -0,0 +1,17 @@
+/*
+ * cache.h
+ *
+ * Host stand-in, gcmem.c logs the ranges for the tests to check.
+ */
+
+#ifndef HOST_CACHE_H_
+#define HOST_CACHE_H_
+
+#include <gccore.h>
+
+void DCFlushRange(void *startaddress, u32 len);
+void DCStoreRange(void *startaddress, u32 len);
+void DCInvalidateRange(void *startaddress, u32 len);
+void ICInvalidateRange(void *startaddress, u32 len);
+
+#endif /* HOST_CACHE_H_ */
@@ -0,0 +1,32 @@
+/*
+ * disc_io.h
+ *
+ * Host stand-in for libogc's block device interface.
+ */
+
+#ifndef HOST_DISC_IO_H_
+#define HOST_DISC_IO_H_
+
+#include <gccore.h>
+
+typedef u32 sec_t;
+
+typedef bool (*FN_MEDIUM_STARTUP)(void);
+typedef bool (*FN_MEDIUM_ISINSERTED)(void);
+typedef bool (*FN_MEDIUM_READSECTORS)(sec_t sector, sec_t numSectors, void *buffer);
+typedef bool (*FN_MEDIUM_WRITESECTORS)(sec_t sector, sec_t numSectors, const void *buffer);
+typedef bool (*FN_MEDIUM_CLEARSTATUS)(void);
+typedef bool (*FN_MEDIUM_SHUTDOWN)(void);
+
+typedef struct {
+    u32 ioType;
+    u32 features;
+    FN_MEDIUM_STARTUP startup;
+    FN_MEDIUM_ISINSERTED isInserted;
+    FN_MEDIUM_READSECTORS readSectors;
+    FN_MEDIUM_WRITESECTORS writeSectors;
+    FN_MEDIUM_CLEARSTATUS clearStatus;
+    FN_MEDIUM_SHUTDOWN shutdown;
+} DISC_INTERFACE;
+
+#endif /* HOST_DISC_IO_H_ */
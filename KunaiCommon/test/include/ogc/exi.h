@@ -0,0 +1,41 @@
+/*
+ * exi.h
+ *
+ * Host stand-in, declarations only. kunai/exiflash.c plays the KunaiGC on
+ * channel 0, a test that probes the slots answers EXI_ProbeEx() itself.
+ */
+
+#ifndef HOST_EXI_H_
+#define HOST_EXI_H_
+
+#include <gccore.h>
+
+#define EXI_READ		0
+#define EXI_WRITE		1
+#define EXI_READWRITE		2
+
+#define EXI_CHANNEL_0		0
+#define EXI_CHANNEL_1		1
+#define EXI_CHANNEL_2		2
+
+#define EXI_DEVICE_0		0
+#define EXI_DEVICE_1		1
+#define EXI_DEVICE_2		2
+
+#define EXI_SPEED1MHZ		0
+#define EXI_SPEED8MHZ		3
+#define EXI_SPEED16MHZ		4
+#define EXI_SPEED32MHZ		5
+
+typedef s32 (*EXICallback)(s32 chn, s32 dev);
+
+s32 EXI_Lock(s32 nChn, s32 nDev, EXICallback unlockCB);
+s32 EXI_Unlock(s32 nChn);
+s32 EXI_Select(s32 nChn, s32 nDev, s32 nFrq);
+s32 EXI_Deselect(s32 nChn);
+s32 EXI_Imm(s32 nChn, void *pData, u32 nLen, u32 nMode, EXICallback tc_cb);
+s32 EXI_Dma(s32 nChn, void *pData, u32 nLen, u32 nMode, EXICallback tc_cb);
+s32 EXI_Sync(s32 nChn);
+s32 EXI_ProbeEx(s32 nChn);
+
+#endif /* HOST_EXI_H_ */
@@ -0,0 +1,19 @@
+/*
+ * lwp.h
+ *
+ * Host stand-in, declarations only. A test that starts threads implements
+ * these on top of pthreads.
+ */
+
+#ifndef HOST_LWP_H_
+#define HOST_LWP_H_
+
+#include <gccore.h>
+
+typedef u32 lwp_t;
+
+s32 LWP_CreateThread(lwp_t *thethread, void *(*entry)(void *), void *arg,
+                     void *stackbase, u32 stack_size, u8 prio);
+s32 LWP_JoinThread(lwp_t thethread, void **value_ptr);
+
+#endif /* HOST_LWP_H_ */
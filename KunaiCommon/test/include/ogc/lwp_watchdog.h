@@ -0,0 +1,23 @@
+/*
+ * lwp_watchdog.h
+ *
+ * Host stand-in: the time base is the simulated clock from host.c, at the
+ * GameCube's 40.5 MHz.
+ */
+
+#ifndef HOST_LWP_WATCHDOG_H_
+#define HOST_LWP_WATCHDOG_H_
+
+#include <gccore.h>
+
+#define TB_TIMER_CLOCK 40500
+
+#define ticks_to_millisecs(ticks) (((u64) (ticks)) / (u64) TB_TIMER_CLOCK)
+#define ticks_to_microsecs(ticks) ((((u64) (ticks)) * 8) / (u64) (TB_TIMER_CLOCK / 125))
+#define millisecs_to_ticks(ms) (((u64) (ms)) * TB_TIMER_CLOCK)
+#define microsecs_to_ticks(us) ((((u64) (us)) * (TB_TIMER_CLOCK / 125)) / 8)
+
+u64 gettime(void);
+u32 diff_usec(u64 start, u64 end);
+
+#endif /* HOST_LWP_WATCHDOG_H_ */
@@ -0,0 +1,17 @@
+/*
+ * system.h
+ *
+ * Host stand-in, the arena pointers are those of gcmem.c.
+ */
+
+#ifndef HOST_SYSTEM_H_
+#define HOST_SYSTEM_H_
+
+#include <gccore.h>
+
+void *SYS_GetArenaLo(void);
+void *SYS_GetArenaHi(void);
+void SYS_SetArenaLo(void *newLo);
+void SYS_SetArenaHi(void *newHi);
+
+#endif /* HOST_SYSTEM_H_ */
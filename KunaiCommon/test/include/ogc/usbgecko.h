@@ -0,0 +1,18 @@
+/*
+ * usbgecko.h
+ *
+ * Host stand-in, gecko/geckopeer.c plays the PC on the other end.
+ */
+
+#ifndef HOST_USBGECKO_H_
+#define HOST_USBGECKO_H_
+
+#include <gccore.h>
+
+int usb_isgeckoalive(s32 chn);
+int usb_checkrecv(s32 chn);
+void usb_flush(s32 chn);
+int usb_recvbuffer_safe_ex(s32 chn, void *buffer, int size, int retries);
+int usb_sendbuffer_safe_ex(s32 chn, const void *buffer, int size, int retries);
+
+#endif /* HOST_USBGECKO_H_ */
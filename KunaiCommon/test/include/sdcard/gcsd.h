@@ -0,0 +1,17 @@
+/*
+ * gcsd.h
+ *
+ * Host stand-in for the SD adapters in the memory card slots and SP2, a
+ * test that needs them defines them.
+ */
+
+#ifndef HOST_GCSD_H_
+#define HOST_GCSD_H_
+
+#include <ogc/disc_io.h>
+
+extern const DISC_INTERFACE __io_gcsda;
+extern const DISC_INTERFACE __io_gcsdb;
+extern const DISC_INTERFACE __io_gcsd2;
+
+#endif /* HOST_GCSD_H_ */
@@ -0,0 +1,395 @@
+/*
+ * exiflash.c
+ *
+ * One selection at a time: the first word after EXI_Select decides what
+ * the rest of it is, a CPLD command (0xC0000000), passthrough to the flash
+ * (0x80000000) or a memory read. In passthrough the first transfer is the
+ * flash command, with the address in its low 24 bits. Every byte costs
+ * simulated time at the clock it was selected with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "spiflash/spiflash.h"
+
+#include "host.h"
+#include "exiflash.h"
+
+exiflash_stats_t exiflash_stats;
+
+enum phase {
+    PHASE_IDLE,			// not selected
+    PHASE_START,		// selected, nothing sent yet
+    PHASE_CPLD,			// 0xC0000000 sent, the command follows
+    PHASE_CMD,			// passthrough, the flash command follows
+    PHASE_JEDEC,
+    PHASE_STATUS,
+    PHASE_DUMMY,		// fast read, one dummy byte first
+    PHASE_READ,
+    PHASE_PROG,
+    PHASE_MEM_SIZE,		// memory read, the size word first
+    PHASE_MEM,
+    PHASE_DONE,			// command complete, nothing more expected
+    PHASE_OFF,			// passthrough with the CPLD disabled
+};
+
+static u8 *flash;
+static u32 flash_size;
+static u32 flash_size_mapped;
+static u32 jedec_id;
+static int enabled;
+static int locked;
+static int selected;
+static u32 byte_ns;		// at the selected clock
+static u64 busy_ns;		// byte time not yet on the clock
+static enum phase phase;
+static int wel;
+static u32 addr;
+
+static u8 *mem;
+static u32 mem_addr, mem_size, mem_pos;
+
+void exiflash_reset(u32 jedec)
+{
+    jedec_id = jedec;
+    flash_size = 1u << (jedec & 0xFF);
+    if (flash_size > EXIFLASH_SIZE_MAX)
+        flash_size = EXIFLASH_SIZE_MAX;
+    // shared, so what a forked child writes outlives it like a reboot
+    if (flash)
+        munmap(flash, flash_size_mapped);
+    flash_size_mapped = flash_size;
+    flash = mmap(NULL, flash_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset(flash, 0xFF, flash_size);
+    memset(&exiflash_stats, 0, sizeof(exiflash_stats));
+    enabled = locked = selected = wel = 0;
+    phase = PHASE_IDLE;
+}
+
+int exiflash_enabled(void)
+{
+    return enabled;
+}
+
+u8 *exiflash_at(u32 a)
+{
+    return flash + a;
+}
+
+void exiflash_set_payload(u32 a, const void *data, u32 size)
+{
+    free(mem);
+    mem = malloc(size);
+    memcpy(mem, data, size);
+    mem_addr = a;
+    mem_size = size;
+}
+
+static void error(const char *what)
+{
+    if (host_verbose)
+        fprintf(stderr, "exiflash: %s\n", what);
+    exiflash_stats.errors++;
+}
+
+// the value of a command or address word
+static u32 value(const void *buf, u32 len)
+{
+    switch (len)
+    {
+    case 1: return *(const u8 *) buf;
+    case 2: return *(const u16 *) buf;
+    case 4: return *(const u32 *) buf;
+    default: return 0;
+    }
+}
+
+static void set_value(void *buf, u32 len, u32 v)
+{
+    switch (len)
+    {
+    case 1: *(u8 *) buf = v; break;
+    case 2: *(u16 *) buf = v; break;
+    case 4: *(u32 *) buf = v; break;
+    }
+}
+
+static void flash_command(u8 cmd)
+{
+    switch (cmd)
+    {
+    case W25Q80BV_CMD_WRITE_ENABLE:
+        wel = 1;
+        phase = PHASE_DONE;
+        break;
+    case W25Q80BV_CMD_WRITE_DISABLE:
+        wel = 0;
+        phase = PHASE_DONE;
+        break;
+    case W25Q80BV_CMD_READ_JEDEC_ID:
+        phase = PHASE_JEDEC;
+        break;
+    case W25Q80BV_CMD_READ_STAT1:
+        // programs and erases are done by the time anyone asks
+        phase = PHASE_STATUS;
+        break;
+    case W25Q80BV_CMD_READ_FAST:
+        exiflash_stats.reads++;
+        phase = PHASE_DUMMY;
+        break;
+    case W25Q80BV_CMD_READ_DATA:
+        exiflash_stats.reads++;
+        phase = PHASE_READ;
+        break;
+    case W25Q80BV_CMD_PAGE_PROG:
+        if (!wel)
+            error("page program without write enable");
+        exiflash_stats.programs++;
+        phase = wel ? PHASE_PROG : PHASE_DONE;
+        wel = 0;
+        break;
+    case W25Q80BV_CMD_ERASE_4K:
+        if (!wel)
+            error("erase without write enable");
+        else
+            memset(flash + (addr & (flash_size - 1) & ~0xFFF), 0xFF, 0x1000);
+        exiflash_stats.erases++;
+        phase = PHASE_DONE;
+        wel = 0;
+        break;
+    default:
+        error("unknown flash command");
+        phase = PHASE_DONE;
+        break;
+    }
+}
+
+static void transfer(u8 *buf, u32 len, u32 mode, int dma)
+{
+    if (!selected)
+    {
+        error("transfer without a selection");
+        return;
+    }
+    busy_ns += (u64) len * byte_ns;
+    host_clock_advance_us(busy_ns / 1000);
+    exiflash_stats.bus_us += busy_ns / 1000;
+    busy_ns %= 1000;
+
+    switch (phase)
+    {
+    case PHASE_START:
+        if (mode != EXI_WRITE || len != 4)
+        {
+            error("selection doesn't start with a word");
+            phase = PHASE_DONE;
+        }
+        else if (value(buf, len) == 0xC0000000)
+        {
+            phase = PHASE_CPLD;
+        }
+        else if (value(buf, len) == 0x80000000)
+        {
+            exiflash_stats.passthrough++;
+            if (!enabled)
+                exiflash_stats.off_accesses++;
+            phase = enabled ? PHASE_CMD : PHASE_OFF;
+        }
+        else if (value(buf, len) >> 6 == mem_addr && mem)
+        {
+            mem_pos = 0;
+            phase = PHASE_MEM_SIZE;
+        }
+        else
+        {
+            error("unknown address word");
+            phase = PHASE_DONE;
+        }
+        return;
+
+    case PHASE_CPLD:
+        if (value(buf, len) == 1u << 24)
+        {
+            enabled = 1;
+            exiflash_stats.enables++;
+        }
+        else if (value(buf, len) == 6u << 24)
+        {
+            enabled = 0;
+            exiflash_stats.disables++;
+        }
+        else
+        {
+            error("unknown CPLD command");
+        }
+        phase = PHASE_DONE;
+        return;
+
+    case PHASE_CMD:
+        if (mode != EXI_WRITE || (len != 1 && len != 4))
+        {
+            error("flash command isn't a write");
+            phase = PHASE_DONE;
+            return;
+        }
+        addr = len == 4 ? value(buf, len) & 0xFFFFFF : 0;
+        flash_command(len == 4 ? value(buf, len) >> 24 : buf[0]);
+        return;
+
+    case PHASE_JEDEC:
+        // clocked out MSB first, read as a value
+        if (mode != EXI_READ || len != 4)
+            error("JEDEC ID not read as a word");
+        else
+            set_value(buf, len, jedec_id << 8);
+        phase = PHASE_DONE;
+        return;
+
+    case PHASE_STATUS:
+        if (mode != EXI_READ)
+            error("status register not read");
+        else
+            memset(buf, 0, len);
+        return;
+
+    case PHASE_DUMMY:
+        if (mode != EXI_READ || len != 1)
+            error("fast read without its dummy byte");
+        phase = PHASE_READ;
+        return;
+
+    case PHASE_READ:
+        if (mode != EXI_READ)
+        {
+            error("write during a read");
+            return;
+        }
+        for (u32 i = 0; i < len; i++, addr++)
+            buf[i] = flash[addr & (flash_size - 1)];
+        return;
+
+    case PHASE_PROG:
+        if (mode != EXI_WRITE || dma)
+        {
+            error("page program data isn't an immediate write");
+            return;
+        }
+        // bits only go from 1 to 0, the address wraps within the page
+        for (u32 i = 0; i < len; i++, addr = (addr & ~0xFF) | ((addr + 1) & 0xFF))
+            flash[addr & (flash_size - 1)] &= buf[i];
+        return;
+
+    case PHASE_MEM_SIZE:
+        if (mode != EXI_READ || len != 4)
+            error("payload size not read as a word");
+        else
+            set_value(buf, len, mem_size);
+        phase = PHASE_MEM;
+        return;
+
+    case PHASE_MEM:
+        for (u32 i = 0; i < len; i++, mem_pos++)
+            buf[i] = mem_pos < mem_size ? mem[mem_pos] : 0xFF;
+        return;
+
+    case PHASE_OFF:
+        // nobody answers, the bus floats high
+        if (mode == EXI_READ)
+            memset(buf, 0xFF, len);
+        return;
+
+    case PHASE_DONE:
+    case PHASE_IDLE:
+        error("transfer after the command completed");
+        return;
+    }
+}
+
+s32 EXI_Lock(s32 chan, s32 dev, EXICallback cb)
+{
+    (void) cb;
+    if (chan != EXI_CHANNEL_0 || dev != EXI_DEVICE_1)
+        return 0;
+    if (locked)
+        error("locked twice");
+    locked = 1;
+    return 1;
+}
+
+s32 EXI_Unlock(s32 chan)
+{
+    if (chan != EXI_CHANNEL_0)
+        return 0;
+    if (!locked)
+        error("unlocked without a lock");
+    locked = 0;
+    return 1;
+}
+
+s32 EXI_Select(s32 chan, s32 dev, s32 speed)
+{
+    (void) speed;
+    if (chan != EXI_CHANNEL_0 || dev != EXI_DEVICE_1)
+        return 0;
+    if (!locked)
+        error("selected without a lock");
+    if (selected)
+        error("selected twice");
+    selected = 1;
+    byte_ns = 8000 >> speed;
+    phase = PHASE_START;
+    return 1;
+}
+
+s32 EXI_Deselect(s32 chan)
+{
+    if (chan != EXI_CHANNEL_0)
+        return 0;
+    if (!selected)
+        error("deselected without a selection");
+    selected = 0;
+    phase = PHASE_IDLE;
+    return 1;
+}
+
+s32 EXI_Imm(s32 chan, void *buf, u32 len, u32 mode, EXICallback cb)
+{
+    (void) cb;
+    if (chan != EXI_CHANNEL_0 || len < 1 || len > 4)
+    {
+        error("bad immediate transfer");
+        return 0;
+    }
+    transfer(buf, len, mode, 0);
+    return 1;
+}
+
+s32 EXI_Dma(s32 chan, void *buf, u32 len, u32 mode, EXICallback cb)
+{
+    (void) cb;
+    if (chan != EXI_CHANNEL_0 || ((uintptr_t) buf | len) & 31)
+    {
+        error("bad DMA");
+        return 0;
+    }
+    transfer(buf, len, mode, 1);
+    return 1;
+}
+
+s32 EXI_Sync(s32 chan)
+{
+    (void) chan;
+    return 1;
+}
+
+// kunai_wait()'s delay, in simulated time
+int usleep(useconds_t us)
+{
+    host_clock_advance_us(us);
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * exiflash.h
+ *
+ * The KunaiGC as kunaigc.c and spiflash.c see it over EXI channel 0,
+ * device 1: the CPLD's enable and disable commands, passthrough to a W25Q
+ * flash kept in RAM, and the memory read kunai_load_payload() uses.
+ *
+ * libogc moves EXI data in the CPU's byte order, which is the wire order
+ * on the GameCube. On the host the two differ, so command and address
+ * words and register reads are taken as values, and flash data in memory
+ * order, which is what the drivers mean on the target.
+ */
+
+#ifndef EXIFLASH_H_
+#define EXIFLASH_H_
+
+#include <gccore.h>
+
+// W25Q16, 2 MB, what the KunaiGC ships with
+#define EXIFLASH_JEDEC		0xEF4015
+#define EXIFLASH_SIZE_MAX	(32 * 1024 * 1024)
+
+typedef struct {
+    u32 enables;		// CPLD enable commands
+    u32 disables;
+    u32 passthrough;		// passthrough selections
+    u32 off_accesses;		// passthrough selections while disabled
+    u32 reads;			// read commands
+    u32 programs;		// page programs
+    u32 erases;
+    u32 errors;			// anything the hardware wouldn't do
+    u32 bus_us;			// time spent moving bytes
+} exiflash_stats_t;
+
+extern exiflash_stats_t exiflash_stats;
+
+// erase the flash (all 0xFF) of the chip 'jedec' names, disable the CPLD
+// and reset the counters. The flash is shared with forked children.
+void exiflash_reset(u32 jedec);
+
+// what the CPLD is switched to right now
+int exiflash_enabled(void);
+
+// byte 'addr' of the flash
+u8 *exiflash_at(u32 addr);
+
+// The data kunai_load_payload() reads: a word naming 'size', then 'size'
+// bytes, served at address 'addr' (the word it sends, shifted down by 6)
+void exiflash_set_payload(u32 addr, const void *data, u32 size);
+
+#endif /* EXIFLASH_H_ */
@@ -0,0 +1,178 @@
+/*
+ * holdtest.c
+ *
+ * kunai_hold()/kunai_release() nesting and the storage service's hold on
+ * top of them, against exiflash. Every flash access has to find the CPLD
+ * enabled, whatever the menu switched it to while the filesystem was
+ * held, and once the last hold is gone the CPLD is where the menu left it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kunaigc/kunaistorage.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "exiflash.h"
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+u8 *dol;
+
+void dol_alloc(int size)
+{
+    (void) size;
+}
+
+static const char text[] = "read back through every hold";
+
+// the CPLD off and the counters cleared, the flash erased if 'erase'
+static void setup(int erase)
+{
+    if (erase)
+        exiflash_reset(EXIFLASH_JEDEC);
+    kunai_disable();
+    memset(&exiflash_stats, 0, sizeof(exiflash_stats));
+}
+
+// a file read through a mount held by someone else
+static int read_text(lfs_t *fs)
+{
+    lfs_file_t f;
+    char buf[sizeof(text)] = { 0 };
+
+    if (lfs_file_open(fs, &f, "text", LFS_O_RDONLY))
+        return 0;
+    int n = lfs_file_read(fs, &f, buf, sizeof(buf));
+    lfs_file_close(fs, &f);
+    return n == sizeof(buf) && !memcmp(buf, text, sizeof(text));
+}
+
+static void nesting(void)
+{
+    printf("nesting\n");
+    setup(1);
+
+    kunai_hold();
+    HOST_CHECK(exiflash_enabled() && exiflash_stats.enables == 1);
+    kunai_hold();
+    kunai_hold();
+    HOST_CHECK(kunai_get_jedecID() == EXIFLASH_JEDEC);
+    kunai_release();
+    kunai_release();
+    HOST_CHECK(exiflash_enabled() && exiflash_stats.disables == 0);
+    kunai_release();
+    HOST_CHECK(!exiflash_enabled());
+    HOST_CHECK(exiflash_stats.enables == 1 && exiflash_stats.disables == 1);
+
+    // one release too many changes nothing
+    kunai_release();
+    HOST_CHECK(!exiflash_enabled() && exiflash_stats.disables == 1);
+    kunai_hold();
+    HOST_CHECK(exiflash_enabled());
+    kunai_release();
+    HOST_CHECK(!exiflash_enabled() && exiflash_stats.enables == 2);
+}
+
+static void storage(void)
+{
+    lfs_file_t f;
+
+    printf("storage\n");
+    setup(1);
+    // cached from here on, not part of what is counted
+    HOST_CHECK(kunai_storage_jedec() == EXIFLASH_JEDEC);
+    memset(&exiflash_stats, 0, sizeof(exiflash_stats));
+
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, KUNAI_STORAGE_FORMAT);
+    if (!HOST_CHECK(fs != NULL))
+        return;
+    HOST_CHECK(lfs_file_open(fs, &f, "text", LFS_O_WRONLY | LFS_O_CREAT) == 0);
+    HOST_CHECK(lfs_file_write(fs, &f, text, sizeof(text)) == sizeof(text));
+    HOST_CHECK(lfs_file_close(fs, &f) == 0);
+
+    // a second user shares the mount and the hold
+    HOST_CHECK(kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0) == fs);
+    HOST_CHECK(read_text(fs));
+    kunai_storage_put();
+    HOST_CHECK(exiflash_enabled());
+
+    // one enable for the mount, format and all accesses
+    HOST_CHECK(exiflash_stats.enables == 1 && exiflash_stats.disables == 0);
+    kunai_storage_put();
+    HOST_CHECK(!exiflash_enabled() && exiflash_stats.disables == 1);
+
+    // still mounted, held again on the next get
+    HOST_CHECK(kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0) == fs);
+    HOST_CHECK(exiflash_enabled() && exiflash_stats.enables == 2);
+    HOST_CHECK(read_text(fs));
+    kunai_storage_put();
+    HOST_CHECK(!exiflash_enabled());
+
+    HOST_CHECK(exiflash_stats.errors == 0 && exiflash_stats.off_accesses == 0);
+}
+
+// the menu's Deactivate and Reactivate while it holds the filesystem
+static void menu(void)
+{
+    printf("menu\n");
+    // on the filesystem storage() left mounted
+    setup(0);
+
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, 0);
+    if (!HOST_CHECK(fs != NULL))
+        return;
+
+    // Deactivate takes effect, the next access enables the chip again
+    kunai_disable();
+    HOST_CHECK(!exiflash_enabled());
+    HOST_CHECK(read_text(fs));
+    HOST_CHECK(exiflash_enabled());
+    HOST_CHECK(kunai_get_jedecID() == EXIFLASH_JEDEC);
+
+    // and it is off again once the menu lets go
+    kunai_storage_put();
+    HOST_CHECK(!exiflash_enabled());
+
+    // Reactivate outlives the hold, the boot path and the shutdown
+    fs = kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, 0);
+    kunai_reenable();
+    HOST_CHECK(read_text(fs));
+    kunai_storage_put();
+    HOST_CHECK(exiflash_enabled());
+    fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+    HOST_CHECK(read_text(fs));
+    kunai_storage_put();
+    HOST_CHECK(exiflash_enabled());
+    u32 disables = exiflash_stats.disables;
+    kunai_storage_shutdown();
+    HOST_CHECK(exiflash_enabled() && exiflash_stats.disables == disables);
+
+    // Deactivate with no hold at all is immediate and stays
+    kunai_disable();
+    HOST_CHECK(!exiflash_enabled());
+    HOST_CHECK(kunai_get_jedecID() == EXIFLASH_JEDEC);
+    HOST_CHECK(!exiflash_enabled());
+
+    // a shutdown with the menu's hold still there
+    fs = kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, 0);
+    HOST_CHECK(fs && read_text(fs));
+    kunai_storage_shutdown();
+    HOST_CHECK(!exiflash_enabled());
+
+    HOST_CHECK(exiflash_stats.errors == 0 && exiflash_stats.off_accesses == 0);
+}
+
+int main(void)
+{
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    nesting();
+    storage();
+    menu();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * installtest.c
+ *
+ * kunai_install_gecko() into LittleFS on exiflash, mounted with the BULK
+ * profile, from a PC sending like buildtools/geckosend.py --install. A new
+ * file replaces the old one with its CRC attribute set, and the frames
+ * come in while the flash programs: the transfer adds next to nothing to
+ * the time the page programs and erases take anyway. A transfer that
+ * breaks off or arrives wrong leaves the old file as it was, and neither
+ * a bad name nor a boot transfer gets near the filesystem.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kunaigc/kunaiinstall.h"
+#include "kunaigc/kunaiscrub.h"
+#include "geckolink/geckolink.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "exiflash.h"
+#include "gecko/geckopeer.h"
+
+#define CHANNEL		EXI_CHANNEL_1
+#define FILE_SIZE	(64 * 1024 + 300)
+#define OLD_SIZE	5000
+#define FRAME_SIZE	1024
+#define FRAMES_MAX	80
+#define ACK_SIZE	20
+#define WAIT_US		150000		/* what kunai_wait() gives a program or erase */
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+u8 *dol;
+
+void dol_alloc(int size)
+{
+    (void) size;
+}
+
+typedef struct {
+    const char *name;
+    u32 mode;
+    const char *file_name;
+    u32 crc_flip;		// xor'ed into the CRC of the header
+    u32 drop_every;		// the first sending of every n-th frame is lost, 0 none
+    u32 quit_after;		// the PC is gone after this many frames, 0 never
+    int expect;
+} script_t;
+
+// the PC's side, geckosend.py without the retries of the handshake
+static struct {
+    const script_t *script;
+    u8 stream[sizeof(geckolink_xfer_t) + FILE_SIZE];
+    u32 total;
+    u32 window;
+    u32 base, sent;
+    u32 sendings[FRAMES_MAX];
+    u32 frames_out;
+    int framed;
+    u8 rx[ACK_SIZE];
+    u32 rx_len;
+} pc;
+
+static u8 file[FILE_SIZE];
+static u8 old[OLD_SIZE];
+
+static lfs_t fs;
+static struct lfs_config cfg_bulk;
+
+static void put32(u8 *p, u32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static u32 get32(const u8 *p)
+{
+    return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void send_frame(u32 seq)
+{
+    u8 f[16 + FRAME_SIZE];
+    u32 ofs = seq * FRAME_SIZE;
+    u32 len = pc.total - 1 == seq ? sizeof(pc.stream) - ofs : FRAME_SIZE;
+
+    if (pc.script->quit_after && pc.frames_out >= pc.script->quit_after)
+        return;
+    pc.frames_out++;
+
+    f[0] = GECKOLINK_FRAME_MAGIC >> 8;
+    f[1] = GECKOLINK_FRAME_MAGIC & 0xff;
+    f[2] = GECKOLINK_FRAME_DATA;
+    f[3] = seq == pc.total - 1 ? GECKOLINK_FLAG_LAST : 0;
+    put32(f + 4, seq);
+    put32(f + 8, len);
+    memcpy(f + 16, pc.stream + ofs, len);
+    put32(f + 12, ~lfs_crc(lfs_crc(0xffffffff, f, 12), f + 16, len));
+
+    if (pc.sendings[seq]++ == 0 && pc.script->drop_every && seq % pc.script->drop_every == 1)
+        return;
+    geckopeer_push(f, 16 + len);
+}
+
+static void fill_window(void)
+{
+    u32 limit = pc.base + pc.window < pc.total ? pc.base + pc.window : pc.total;
+
+    while (pc.sent < limit)
+        send_frame(pc.sent++);
+}
+
+static void on_ack(const u8 *ack)
+{
+    u32 next = get32(ack + 4), have = get32(ack + 8);
+
+    if (ack[2] == GECKOLINK_ACK_READY && !pc.window)
+        pc.window = ack[3];
+    if (next > pc.base)
+        pc.base = next;
+    if (ack[2] == GECKOLINK_NAK)
+    {
+        u32 upto = pc.base + (have ? 32 - __builtin_clz(have) : 1);
+
+        for (u32 s = pc.base; s < upto && s < pc.sent; s++)
+            if (!(have >> (s - pc.base) & 1))
+                send_frame(s);
+    }
+    fill_window();
+}
+
+static void on_send(geckopeer_t *p, const u8 *data, u32 len)
+{
+    (void) p;
+
+    if (!pc.framed)
+    {
+        if (len == 1 && *data == GC_READY)
+        {
+            u8 b = PC_FRAMED;
+            geckopeer_push(&b, 1);
+            pc.framed = 1;
+        }
+        return;
+    }
+
+    for (u32 i = 0; i < len; i++)
+    {
+        pc.rx[pc.rx_len++] = data[i];
+        if (pc.rx_len == 2 && (pc.rx[0] != (GECKOLINK_ACK_MAGIC >> 8) ||
+                               pc.rx[1] != (GECKOLINK_ACK_MAGIC & 0xff)))
+        {
+            pc.rx[0] = pc.rx[1];
+            pc.rx_len = 1;
+        }
+        if (pc.rx_len == ACK_SIZE)
+        {
+            pc.rx_len = 0;
+            if (~lfs_crc(0xffffffff, pc.rx, 16) == get32(pc.rx + 16))
+                on_ack(pc.rx);
+        }
+    }
+}
+
+static void start(const script_t *s)
+{
+    memset(&pc, 0, sizeof(pc));
+    pc.script = s;
+
+    put32(pc.stream, GECKOLINK_XFER_MAGIC);
+    put32(pc.stream + 4, sizeof(file));
+    put32(pc.stream + 8, s->mode);
+    put32(pc.stream + 12, ~lfs_crc(0xffffffff, file, sizeof(file)) ^ s->crc_flip);
+    strcpy((char *) pc.stream + 16, s->file_name);
+    memcpy(pc.stream + sizeof(geckolink_xfer_t), file, sizeof(file));
+    pc.total = (sizeof(pc.stream) + FRAME_SIZE - 1) / FRAME_SIZE;
+
+    geckopeer_reset(CHANNEL);
+    geckopeer.on_send = on_send;
+    memset(&exiflash_stats, 0, sizeof(exiflash_stats));
+    host_clock_reset();
+}
+
+static int write_file(const char *path, const void *data, u32 size)
+{
+    lfs_file_t f;
+
+    if (lfs_file_open(&fs, &f, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC))
+        return 0;
+    int n = lfs_file_write(&fs, &f, data, size);
+    return lfs_file_close(&fs, &f) == 0 && n == (int) size;
+}
+
+// 'path' holds exactly 'data', and its CRC attribute, if it has one, agrees
+static int file_is(const char *path, const void *data, u32 size, int with_crc)
+{
+    static u8 buf[FILE_SIZE + 1];
+    lfs_file_t f;
+    u32 crc;
+
+    if (lfs_file_open(&fs, &f, path, LFS_O_RDONLY))
+        return 0;
+    int n = lfs_file_read(&fs, &f, buf, sizeof(buf));
+    lfs_file_close(&fs, &f);
+    if (n != (int) size || memcmp(buf, data, size))
+        return 0;
+
+    lfs_ssize_t attr = lfs_getattr(&fs, path, KUNAI_ATTR_CRC, &crc, sizeof(crc));
+    if (!with_crc)
+        return attr == LFS_ERR_NOATTR;
+    return attr == sizeof(crc) && crc == ~lfs_crc(0xffffffff, data, size);
+}
+
+static const script_t scripts[] = {
+    { "new file",  GECKOLINK_MODE_INSTALL, "boot.dol",   0, 0, 0,  KUNAI_INSTALL_OK },
+    { "lossy",     GECKOLINK_MODE_INSTALL, "boot.dol",   0, 5, 0,  KUNAI_INSTALL_OK },
+    { "PC gone",   GECKOLINK_MODE_INSTALL, "boot.dol",   0, 0, 30, KUNAI_INSTALL_ERR_GECKO },
+    { "bad CRC",   GECKOLINK_MODE_INSTALL, "boot.dol",   1, 0, 0,  KUNAI_INSTALL_ERR_CRC },
+    { "hidden",    GECKOLINK_MODE_INSTALL, ".boot.dol",  0, 0, 0,  KUNAI_INSTALL_ERR_NAME },
+    { "directory", GECKOLINK_MODE_INSTALL, "a/boot.dol", 0, 0, 0,  KUNAI_INSTALL_ERR_NAME },
+    { "boot mode", GECKOLINK_MODE_BOOT,    "boot.dol",   0, 0, 0,  KUNAI_INSTALL_ERR_GECKO },
+};
+
+static void installs(void)
+{
+    char name[LFS_NAME_MAX + 1];
+    struct lfs_info info;
+
+    for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++)
+    {
+        const script_t *s = &scripts[i];
+
+        printf("%s\n", s->name);
+        lfs_remove(&fs, "boot.dol");
+        HOST_CHECK(write_file("boot.dol", old, sizeof(old)));
+        start(s);
+
+        int err = kunai_install_gecko(&fs, CHANNEL, name);
+        if (!HOST_CHECK(err == s->expect))
+            fprintf(stderr, "  %s: %d\n", s->name, err);
+        HOST_CHECK(lfs_stat(&fs, KUNAI_INSTALL_TMP, &info) == LFS_ERR_NOENT);
+        HOST_CHECK(exiflash_stats.errors == 0);
+
+        if (err != KUNAI_INSTALL_OK)
+        {
+            HOST_CHECK(file_is("boot.dol", old, sizeof(old), 0));
+            continue;
+        }
+
+        // what the flash itself takes, and what the Gecko added to it
+        u64 us = ticks_to_microsecs(gettime());
+        u64 flash_us = (u64) (exiflash_stats.programs + exiflash_stats.erases) * WAIT_US +
+                       exiflash_stats.bus_us;
+        u64 gecko_us = (u64) sizeof(pc.stream) * GECKOPEER_BYTE_NS / 1000;
+        printf("  %u programs, %u erases, %u frames sent, %u ms, %u ms for the Gecko\n",
+               exiflash_stats.programs, exiflash_stats.erases, pc.frames_out,
+               (u32) (us / 1000), (u32) ((us - flash_us) / 1000));
+        HOST_CHECK(us >= flash_us && us - flash_us < gecko_us / 4);
+
+        HOST_CHECK(!strcmp(name, s->file_name));
+        HOST_CHECK(file_is("boot.dol", file, sizeof(file), 1));
+    }
+}
+
+int main(void)
+{
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    for (u32 i = 0; i < sizeof(file); i++)
+        file[i] = i * 131 + (i >> 9);
+    memset(old, 0x5A, sizeof(old));
+
+    exiflash_reset(EXIFLASH_JEDEC);
+    if (!HOST_CHECK(kunai_lfs_config(&cfg_bulk, EXIFLASH_JEDEC, KUNAI_LFS_PROFILE_BULK) == LFS_ERR_OK) ||
+        !HOST_CHECK(lfs_format(&fs, &cfg_bulk) == 0 && lfs_mount(&fs, &cfg_bulk) == 0))
+        return 1;
+
+    installs();
+
+    lfs_unmount(&fs);
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
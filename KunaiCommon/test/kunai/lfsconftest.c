@@ -0,0 +1,211 @@
+/*
+ * lfsconftest.c
+ *
+ * kunai_lfs_config() for every chip the KunaiGC can carry and every
+ * profile: the geometry against a table worked out by hand, the cache cut
+ * down for small arenas, and IDs it has to reject. Then one filesystem on
+ * exiflash, formatted with one profile and mounted with each of the others.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kunaigc/kunaigc.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "exiflash.h"
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+u8 *dol;
+
+void dol_alloc(int size)
+{
+    (void) size;
+}
+
+typedef struct {
+    u32 jedec;
+    int profile;
+    u32 block_count;
+    u32 cache_size;
+    u32 lookahead_size;
+} geometry_t;
+
+// 1 MB to 32 MB, the first 256 KB belong to the loaders
+static const geometry_t geometries[] = {
+    { 0xEF4014, KUNAI_LFS_PROFILE_BOOT,     192,  512,   16 },
+    { 0xEF4014, KUNAI_LFS_PROFILE_DEFAULT,  192, 2048,   16 },
+    { 0xEF4014, KUNAI_LFS_PROFILE_BULK,     192, 4096,   24 },
+    { 0xEF4015, KUNAI_LFS_PROFILE_BOOT,     448,  512,   16 },
+    { 0xEF4015, KUNAI_LFS_PROFILE_DEFAULT,  448, 2048,   16 },
+    { 0xEF4015, KUNAI_LFS_PROFILE_BULK,     448, 4096,   56 },
+    { 0xEF4016, KUNAI_LFS_PROFILE_BULK,     960, 4096,  120 },
+    { 0xEF4017, KUNAI_LFS_PROFILE_BULK,    1984, 4096,  248 },
+    { 0xEF4018, KUNAI_LFS_PROFILE_BULK,    4032, 4096,  504 },
+    { 0xEF4019, KUNAI_LFS_PROFILE_BOOT,    8128,  512,   16 },
+    { 0xEF4019, KUNAI_LFS_PROFILE_DEFAULT, 8128, 2048,   16 },
+    { 0xEF4019, KUNAI_LFS_PROFILE_BULK,    8128, 4096, 1016 },
+    // only the capacity byte counts, unknown profiles are DEFAULT
+    { 0xC84015, KUNAI_LFS_PROFILE_BULK,     448, 4096,   56 },
+    { 0xEF4015, 7,                          448, 2048,   16 },
+};
+
+// arena size, then what is left of the cache: 64 KB gives a 4 KB budget
+static const struct {
+    u32 arena;
+    u32 jedec;
+    int profile;
+    u32 cache_size;
+} budgets[] = {
+    { 64 * 1024, 0xEF4015, KUNAI_LFS_PROFILE_BULK,    1024 },
+    { 64 * 1024, 0xEF4015, KUNAI_LFS_PROFILE_DEFAULT, 1024 },
+    { 64 * 1024, 0xEF4015, KUNAI_LFS_PROFILE_BOOT,     512 },
+    { 256 * 1024, 0xEF4019, KUNAI_LFS_PROFILE_BULK,   4096 },
+    { 128 * 1024, 0xEF4019, KUNAI_LFS_PROFILE_BULK,   2048 },
+    // never below an inline file, whatever the arena
+    { 4 * 1024, 0xEF4019, KUNAI_LFS_PROFILE_BULK,      512 },
+    { 0, 0xEF4015, KUNAI_LFS_PROFILE_DEFAULT,          512 },
+};
+
+static const u32 bad_ids[] = {
+    0x000000, 0xFFFFFF, 0xEF4013, 0xEF401A, 0xEF4000, 0xEF40FF,
+};
+
+// what lfs_init() asserts, and the read and prog cache inside the budget
+static void check_usable(const struct lfs_config *c)
+{
+    HOST_CHECK(c->read && c->prog && c->erase && c->sync);
+    HOST_CHECK(c->read_size == 4 && c->prog_size == W25Q80BV_PAGE_SIZE);
+    HOST_CHECK(c->block_size == KUNAI_BLOCK_SIZE && c->block_cycles == 500);
+    HOST_CHECK(c->cache_size % c->read_size == 0 && c->cache_size % c->prog_size == 0);
+    HOST_CHECK(c->block_size % c->cache_size == 0);
+    HOST_CHECK(c->lookahead_size && c->lookahead_size % 8 == 0);
+    HOST_CHECK(c->cache_size >= c->block_size / 8);
+}
+
+static void table(void)
+{
+    struct lfs_config c;
+
+    printf("geometry table\n");
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    for (size_t i = 0; i < sizeof(geometries) / sizeof(geometries[0]); i++)
+    {
+        const geometry_t *g = &geometries[i];
+
+        memset(&c, 0xA5, sizeof(c));
+        if (!HOST_CHECK(kunai_lfs_config(&c, g->jedec, g->profile) == LFS_ERR_OK))
+            continue;
+        if (!HOST_CHECK(c.block_count == g->block_count && c.cache_size == g->cache_size &&
+                        c.lookahead_size == g->lookahead_size))
+            fprintf(stderr, "  %06X profile %d: %u blocks, cache %u, lookahead %u\n",
+                    g->jedec, g->profile, c.block_count, c.cache_size, c.lookahead_size);
+        check_usable(&c);
+
+        // the flash past KUNAI_OFFS, to the byte
+        HOST_CHECK(KUNAI_OFFS + c.block_count * c.block_size == 1u << (g->jedec & 0xFF));
+        // BULK's lookahead covers the whole chip
+        if (g->profile == KUNAI_LFS_PROFILE_BULK)
+            HOST_CHECK(c.lookahead_size * 8 >= c.block_count);
+        // nothing left over from before
+        HOST_CHECK(!c.context && !c.read_buffer && !c.prog_buffer && !c.lookahead_buffer);
+        HOST_CHECK(!c.name_max && !c.file_max && !c.attr_max);
+    }
+}
+
+static void budget(void)
+{
+    struct lfs_config c;
+
+    printf("arena budget\n");
+    for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++)
+    {
+        gcmem_reset(ARENA_LO, ARENA_LO + budgets[i].arena, 0);
+        HOST_CHECK(kunai_lfs_config(&c, budgets[i].jedec, budgets[i].profile) == LFS_ERR_OK);
+        if (!HOST_CHECK(c.cache_size == budgets[i].cache_size))
+            fprintf(stderr, "  %u byte arena, profile %d: cache %u\n",
+                    budgets[i].arena, budgets[i].profile, c.cache_size);
+        check_usable(&c);
+        if (c.cache_size > c.block_size / 8)
+            HOST_CHECK(3 * c.cache_size + c.lookahead_size <= budgets[i].arena / 16);
+    }
+}
+
+static void rejects(void)
+{
+    struct lfs_config c;
+
+    printf("rejects\n");
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    for (size_t i = 0; i < sizeof(bad_ids) / sizeof(bad_ids[0]); i++)
+    {
+        memset(&c, 0xA5, sizeof(c));
+        HOST_CHECK(kunai_lfs_config(&c, bad_ids[i], KUNAI_LFS_PROFILE_DEFAULT) == LFS_ERR_INVAL);
+        // and left alone
+        HOST_CHECK(c.block_size == 0xA5A5A5A5);
+    }
+}
+
+// The profiles only differ in RAM, a filesystem made with one is the same
+// filesystem to the others
+static void profiles(void)
+{
+    static const char text[] = "written with DEFAULT, read with every profile";
+    static const int mount_with[] = {
+        KUNAI_LFS_PROFILE_BOOT, KUNAI_LFS_PROFILE_BULK, KUNAI_LFS_PROFILE_DEFAULT,
+    };
+    struct lfs_config c;
+    lfs_t fs;
+    lfs_file_t f;
+    char buf[sizeof(text)];
+
+    printf("profiles\n");
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    exiflash_reset(EXIFLASH_JEDEC);
+
+    HOST_CHECK(kunai_lfs_config(&c, kunai_get_jedecID(), KUNAI_LFS_PROFILE_DEFAULT) == LFS_ERR_OK);
+    HOST_CHECK(lfs_format(&fs, &c) == 0);
+    HOST_CHECK(lfs_mount(&fs, &c) == 0);
+    HOST_CHECK(lfs_file_open(&fs, &f, "text", LFS_O_WRONLY | LFS_O_CREAT) == 0);
+    HOST_CHECK(lfs_file_write(&fs, &f, text, sizeof(text)) == sizeof(text));
+    HOST_CHECK(lfs_file_close(&fs, &f) == 0);
+    HOST_CHECK(lfs_unmount(&fs) == 0);
+
+    for (size_t i = 0; i < sizeof(mount_with) / sizeof(mount_with[0]); i++)
+    {
+        HOST_CHECK(kunai_lfs_config(&c, EXIFLASH_JEDEC, mount_with[i]) == LFS_ERR_OK);
+        if (!HOST_CHECK(lfs_mount(&fs, &c) == 0))
+            continue;
+        memset(buf, 0, sizeof(buf));
+        HOST_CHECK(lfs_file_open(&fs, &f, "text", LFS_O_RDONLY) == 0);
+        HOST_CHECK(lfs_file_read(&fs, &f, buf, sizeof(buf)) == sizeof(buf));
+        HOST_CHECK(!memcmp(buf, text, sizeof(text)));
+        HOST_CHECK(lfs_file_close(&fs, &f) == 0);
+        HOST_CHECK(lfs_unmount(&fs) == 0);
+    }
+
+    // nothing went to the flash below KUNAI_OFFS, or with the CPLD off
+    for (u32 a = 0; a < KUNAI_OFFS; a++)
+        if (*exiflash_at(a) != 0xFF)
+        {
+            HOST_CHECK(!"loader area written");
+            break;
+        }
+    HOST_CHECK(exiflash_stats.errors == 0 && exiflash_stats.off_accesses == 0);
+    HOST_CHECK(!exiflash_enabled());
+}
+
+int main(void)
+{
+    table();
+    budget();
+    rejects();
+    profiles();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * prefetchtest.c
+ *
+ * kunai_prefetch_*() on LittleFS in exiflash, mounted with the profile the
+ * menu uses. No step may take much more bus time than its budget, and the
+ * longer an entry stays highlighted, the less of its file is left for
+ * kunai_prefetch_take() to read once it is confirmed. Cancelling, taking
+ * early and a missing file all leave the filesystem with no file open.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "kunaigc/kunaiprefetch.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "exiflash.h"
+
+#define FILE_SIZE	(300 * 1000)
+#define BUDGET_US	KUNAI_PREFETCH_BUDGET_US
+// a 4K chunk at 32 MHz, and the CTZ list lookups ahead of it
+#define CHUNK_US	2000
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+u8 *dol;
+
+void dol_alloc(int size)
+{
+    (void) size;
+}
+
+static u8 file[FILE_SIZE];
+
+static lfs_t fs;
+static struct lfs_config cfg_menu;
+
+static u32 now_us(void)
+{
+    return ticks_to_microsecs(gettime());
+}
+
+// the buffer take() hands over holds the file
+static int took_file(kunai_prefetch_t *p)
+{
+    u32 size = 0;
+    u8 *buf = kunai_prefetch_take(p, &size);
+    int ok = buf && size == sizeof(file) && !memcmp(buf, file, size);
+
+    free(buf);
+    return ok && p->state == KUNAI_PREFETCH_IDLE && !p->buf;
+}
+
+static void steps(void)
+{
+    kunai_prefetch_t p;
+    u32 n = 0, longest = 0;
+
+    printf("steps\n");
+    kunai_prefetch_start(&p, &fs, "boot.dol", 0);
+    HOST_CHECK(p.state == KUNAI_PREFETCH_READ && p.budget_us == BUDGET_US && p.done == 0);
+
+    for (int more = 1; more; n++)
+    {
+        u32 start = now_us();
+        more = kunai_prefetch_step(&p);
+        if (now_us() - start > longest)
+            longest = now_us() - start;
+    }
+    printf("  %u bytes in %u steps, the longest %u us\n", p.size, n, longest);
+    HOST_CHECK(p.state == KUNAI_PREFETCH_DONE && fs.mlist == NULL);
+    HOST_CHECK(longest <= BUDGET_US + CHUNK_US);
+    HOST_CHECK(n >= sizeof(file) / (BUDGET_US * 4) && n <= sizeof(file) / KUNAI_PREFETCH_CHUNK + 1);
+
+    // nothing left to do, and nothing to read on take
+    u32 start = now_us();
+    HOST_CHECK(kunai_prefetch_step(&p) == 0);
+    HOST_CHECK(took_file(&p) && now_us() == start);
+}
+
+// confirmed after 'frames' menu frames, each stepping once
+static void dwell(void)
+{
+    static const u32 frames[] = { 0, 1, 2, 5, 8, 11, 20 };
+    u32 full = 0, last = ~0u;
+
+    printf("dwell\n");
+    for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++)
+    {
+        kunai_prefetch_t p;
+
+        kunai_prefetch_start(&p, &fs, "boot.dol", BUDGET_US);
+        for (u32 f = 0; f < frames[i]; f++)
+            kunai_prefetch_step(&p);
+
+        u32 start = now_us();
+        HOST_CHECK(took_file(&p) && fs.mlist == NULL);
+        u32 us = now_us() - start;
+        printf("  %2u frames: %6u us to take\n", frames[i], us);
+
+        if (!frames[i])
+            full = us;
+        // each frame took a budget's worth off, and at most a chunk more
+        HOST_CHECK(us <= last);
+        HOST_CHECK(us + frames[i] * (BUDGET_US + CHUNK_US) >= full || us == 0);
+        HOST_CHECK(us <= (full > frames[i] * BUDGET_US ? full - frames[i] * BUDGET_US : 0) + CHUNK_US);
+        last = us;
+    }
+    HOST_CHECK(last == 0);
+}
+
+// moving off the entry halfway, then coming back to it
+static void cancel(void)
+{
+    kunai_prefetch_t p;
+
+    printf("cancel\n");
+    kunai_prefetch_start(&p, &fs, "boot.dol", BUDGET_US);
+    kunai_prefetch_step(&p);
+    kunai_prefetch_step(&p);
+    HOST_CHECK(p.state == KUNAI_PREFETCH_READ && p.done > 0 && p.done < p.size);
+    kunai_prefetch_cancel(&p);
+    HOST_CHECK(p.state == KUNAI_PREFETCH_IDLE && !p.buf && fs.mlist == NULL);
+
+    // cancelling again, or stepping what was cancelled, does nothing
+    kunai_prefetch_cancel(&p);
+    HOST_CHECK(kunai_prefetch_step(&p) == 0 && p.state == KUNAI_PREFETCH_IDLE);
+    u32 size = 0;
+    HOST_CHECK(kunai_prefetch_take(&p, &size) == NULL);
+
+    kunai_prefetch_start(&p, &fs, "boot.dol", BUDGET_US);
+    kunai_prefetch_step(&p);
+    HOST_CHECK(took_file(&p) && fs.mlist == NULL);
+}
+
+static void missing(void)
+{
+    kunai_prefetch_t p;
+    u32 size = 0;
+
+    printf("missing\n");
+    kunai_prefetch_start(&p, &fs, "gone.dol", BUDGET_US);
+    HOST_CHECK(p.state == KUNAI_PREFETCH_FAILED && !p.buf && fs.mlist == NULL);
+    HOST_CHECK(kunai_prefetch_step(&p) == 0);
+    HOST_CHECK(kunai_prefetch_take(&p, &size) == NULL && p.state == KUNAI_PREFETCH_IDLE);
+    kunai_prefetch_cancel(&p);
+    HOST_CHECK(fs.mlist == NULL);
+}
+
+int main(void)
+{
+    lfs_file_t f;
+
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    for (u32 i = 0; i < sizeof(file); i++)
+        file[i] = i * 131 + (i >> 9);
+
+    exiflash_reset(EXIFLASH_JEDEC);
+    if (!HOST_CHECK(kunai_lfs_config(&cfg_menu, EXIFLASH_JEDEC, KUNAI_LFS_PROFILE_DEFAULT) == LFS_ERR_OK) ||
+        !HOST_CHECK(lfs_format(&fs, &cfg_menu) == 0 && lfs_mount(&fs, &cfg_menu) == 0))
+        return 1;
+    if (!HOST_CHECK(lfs_file_open(&fs, &f, "boot.dol", LFS_O_WRONLY | LFS_O_CREAT) == 0))
+        return 1;
+    HOST_CHECK(lfs_file_write(&fs, &f, file, sizeof(file)) == sizeof(file));
+    HOST_CHECK(lfs_file_close(&fs, &f) == 0);
+    host_clock_reset();
+
+    steps();
+    dwell();
+    cancel();
+    missing();
+
+    lfs_unmount(&fs);
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
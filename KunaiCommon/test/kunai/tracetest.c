@@ -0,0 +1,151 @@
+/*
+ * tracetest.c
+ *
+ * What the EXI trace costs in ring entries: kunaigc.c's flash commands and
+ * kunai_load_payload() against exiflash, counted through exitrace_export().
+ * The payload is read a byte at a time but has to come out as one entry,
+ * leaving what was traced before it in the ring. Then the dump over a USB
+ * Gecko, with a PC reading and with none.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "kunaigc/kunaigc.h"
+#include "exitrace/exitrace.h"
+#include "geckolink/geckolink.h"
+
+#include "host.h"
+#include "exiflash.h"
+#include "gecko/geckopeer.h"
+
+#define PAYLOAD_ADDR	0x1234
+#define PAYLOAD_SIZE	(96 * 1024)
+
+u8 *dol;
+
+void dol_alloc(int size)
+{
+    free(dol);
+    dol = malloc(size);
+}
+
+static exitrace_entry entries[EXITRACE_ENTRIES];
+
+static u32 traced(void)
+{
+    exitrace_header hdr;
+
+    exitrace_export(&hdr, NULL, 0, 0);
+    return hdr.count;
+}
+
+static void payload(void)
+{
+    u8 *data = malloc(PAYLOAD_SIZE);
+
+    printf("payload\n");
+    exiflash_reset(EXIFLASH_JEDEC);
+    exitrace_clear();
+    for (u32 i = 0; i < PAYLOAD_SIZE; i++)
+        data[i] = i * 7 + (i >> 8);
+    exiflash_set_payload(PAYLOAD_ADDR, data, PAYLOAD_SIZE);
+
+    HOST_CHECK(kunai_get_jedecID() == EXIFLASH_JEDEC);
+    u32 jedec_entries = traced();
+
+    HOST_CHECK(kunai_load_payload(PAYLOAD_ADDR, 0) == 1);
+    u32 payload_entries = traced() - jedec_entries;
+    HOST_CHECK(dol && !memcmp(dol, data, PAYLOAD_SIZE));
+    HOST_CHECK(exiflash_stats.errors == 0);
+
+    // lock, select, address, size, the payload, deselect, unlock
+    printf("  JEDEC ID %u entries, %u KB payload %u entries\n",
+           jedec_entries, PAYLOAD_SIZE / 1024, payload_entries);
+    HOST_CHECK(payload_entries == 7);
+
+    u32 n = exitrace_export(NULL, entries, 0, EXITRACE_ENTRIES);
+    HOST_CHECK(n == jedec_entries + payload_entries);
+
+    // the JEDEC ID read survived
+    int found = 0;
+    for (u32 i = 0; i < jedec_entries; i++)
+        found |= entries[i].op == EXITRACE_OP_READ && entries[i].len == 4 &&
+                 entries[i].data == EXIFLASH_JEDEC << 8;
+    HOST_CHECK(found);
+
+    // the whole payload in one entry, clipped length, its first bytes
+    const exitrace_entry *e = &entries[n - 3];
+    HOST_CHECK(e->op == EXITRACE_OP_READ && e->len == 0xFFFF && e->result > 0);
+    HOST_CHECK(!memcmp(&e->data, data, 4));
+
+    free(data);
+}
+
+// LittleFS sized reads through kunai_read(), one block
+static void block_read(void)
+{
+    struct lfs_config c;
+    static u8 buf[KUNAI_BLOCK_SIZE] ATTRIBUTE_ALIGN(32);
+
+    printf("block read\n");
+    exiflash_reset(EXIFLASH_JEDEC);
+    exitrace_clear();
+    HOST_CHECK(kunai_lfs_config(&c, EXIFLASH_JEDEC, KUNAI_LFS_PROFILE_DEFAULT) == LFS_ERR_OK);
+    for (u32 i = 0; i < KUNAI_BLOCK_SIZE; i++)
+        *exiflash_at(KUNAI_OFFS + KUNAI_BLOCK_SIZE + i) = i ^ (i >> 8);
+
+    HOST_CHECK(kunai_read(&c, 1, 0, buf, sizeof(buf)) == 0);
+    HOST_CHECK(*buf == 0 && buf[0x123] == (0x23 ^ 1));
+    u32 aligned = traced();
+    exitrace_clear();
+    HOST_CHECK(kunai_read(&c, 1, 3, buf + 3, 100) == 0);
+    HOST_CHECK(buf[3] == 3 && buf[102] == 102);
+    u32 unaligned = traced();
+
+    printf("  4 KB aligned %u entries, 100 bytes unaligned %u entries\n", aligned, unaligned);
+    HOST_CHECK(exiflash_stats.errors == 0 && exiflash_stats.off_accesses == 0);
+}
+
+static void dump(void)
+{
+    printf("dump\n");
+    exiflash_reset(EXIFLASH_JEDEC);
+    exitrace_clear();
+    for (int i = 0; i < 3; i++)
+        kunai_get_jedecID();
+    u32 count = traced();
+
+    geckopeer_reset(EXI_CHANNEL_1);
+    HOST_CHECK(exitrace_dump_gecko(EXI_CHANNEL_0) == 0);
+    HOST_CHECK(exitrace_dump_gecko(EXI_CHANNEL_1) == 1);
+
+    exitrace_header hdr;
+    HOST_CHECK(geckopeer.out_len == sizeof(hdr) + count * sizeof(exitrace_entry));
+    memcpy(&hdr, geckopeer.out, sizeof(hdr));
+    HOST_CHECK(hdr.magic == EXITRACE_MAGIC && hdr.count == count &&
+               hdr.entry_size == sizeof(exitrace_entry));
+    exitrace_export(NULL, entries, 0, count);
+    HOST_CHECK(!memcmp(geckopeer.out + sizeof(hdr), entries, count * sizeof(exitrace_entry)));
+
+    // a Gecko with no PC behind it gives up after GECKOLINK_IDLE_MS
+    geckopeer_reset(EXI_CHANNEL_1);
+    geckopeer.stalled = 1;
+    u64 start = gettime();
+    HOST_CHECK(exitrace_dump_gecko(EXI_CHANNEL_1) == 0);
+    u32 ms = ticks_to_millisecs(gettime() - start);
+    HOST_CHECK(ms >= GECKOLINK_IDLE_MS && ms < GECKOLINK_IDLE_MS + 10);
+}
+
+int main(void)
+{
+    payload();
+    block_read();
+    dump();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * payloadtest.c
+ *
+ * Containers packed by buildtools/kpack.py, unpacked by payload_load() and
+ * its lz4_decode_block(): runs of zeros whose matches reach back across
+ * chunks, random data that kpack stores chunk by chunk, code-like text and
+ * sizes around the chunk size and the LZ4 end of block rules, each with
+ * several chunk sizes. The reads come in odd pieces like they do from
+ * f_read() or the Gecko. Then damaged containers: every one has to fail
+ * without writing past the end of the payload.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "payload/payload.h"
+#include "lfs/lfs_util.h"
+
+#include "host.h"
+#include "gcmem.h"
+
+#define ARENA_LO	0x80080000
+#define ARENA_HI	0x81300000
+
+#define WORK		"build/payload"
+#define GUARD		64
+
+typedef struct {
+    const char *name;
+    u32 size;
+    void (*fill)(u8 *p, u32 size);
+} corpus_t;
+
+static u32 rnd_state;
+
+static u32 rnd(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return rnd_state >> 8;
+}
+
+static void zeros(u8 *p, u32 size)
+{
+    memset(p, 0, size);
+}
+
+static void noise(u8 *p, u32 size)
+{
+    rnd_state = 1;
+    for (u32 i = 0; i < size; i++)
+        p[i] = rnd();
+}
+
+// instruction words from a small set with varying registers, and strings
+static void code(u8 *p, u32 size)
+{
+    static const u32 ops[] = { 0x38600000, 0x7C0802A6, 0x9421FFF0, 0x4E800020, 0x80010014 };
+    static const char text[] = "Couldn't mount %s, trying the next slot\n";
+
+    rnd_state = 2;
+    for (u32 i = 0; i < size; )
+    {
+        if (rnd() % 8 == 0)
+            for (u32 j = 0; j < sizeof(text) && i < size; j++)
+                p[i++] = text[j];
+        else
+            for (u32 j = 0, op = ops[rnd() % 5] | (rnd() % 32) << 21; j < 4 && i < size; j++)
+                p[i++] = op >> (24 - 8 * j);
+    }
+}
+
+static const corpus_t corpora[] = {
+    { "zeros",        200000, zeros },
+    { "noise",        150000, noise },
+    { "code",         300000, code },
+    { "one byte",          1, code },
+    { "short block",      12, code },
+    { "one chunk",     65536, code },
+    { "one more",      65537, zeros },
+};
+
+static const u32 chunk_sizes[] = { 65536, 4096, 1000 };
+
+static u8 *packed;
+static u32 packed_len;
+
+// kpack.py on 'raw', the container with its header in host byte order
+static int pack(const u8 *raw, u32 size, const char *codec, u32 chunk)
+{
+    char cmd[512];
+    FILE *f = fopen(WORK "/raw", "wb");
+
+    if (!f || fwrite(raw, 1, size, f) != size)
+        return 0;
+    fclose(f);
+    snprintf(cmd, sizeof(cmd), "python3 %s -c %s --chunk-size %u %s/raw %s/kpay > /dev/null",
+             KPACK, codec, chunk, WORK, WORK);
+    if (system(cmd) != 0)
+        return 0;
+
+    f = fopen(WORK "/kpay", "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    packed_len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    free(packed);
+    packed = malloc(packed_len);
+    int ok = fread(packed, 1, packed_len, f) == packed_len;
+    fclose(f);
+
+    // the target reads the big-endian fields as they are
+    payload_header_t *hdr = (payload_header_t *) packed;
+    hdr->magic = __builtin_bswap32(hdr->magic);
+    hdr->raw_size = __builtin_bswap32(hdr->raw_size);
+    hdr->raw_crc = __builtin_bswap32(hdr->raw_crc);
+    hdr->chunk_size = __builtin_bswap32(hdr->chunk_size);
+    return ok;
+}
+
+typedef struct {
+    const u8 *p;
+    u32 left;
+    u32 piece;
+} reader_t;
+
+// up to 'piece' bytes at a time, 0 at the end like f_read()
+static int mem_read(void *ctx, void *buf, u32 len)
+{
+    reader_t *r = ctx;
+
+    if (len > r->left)
+        len = r->left;
+    if (len > r->piece)
+        len = r->piece;
+    memcpy(buf, r->p, len);
+    r->p += len;
+    r->left -= len;
+    r->piece = r->piece * 5 % 4099 + 1;
+    return len;
+}
+
+// unpack 'packed' into a buffer with guard bytes on both sides
+static int unpack(u8 *out, u32 raw_size, int *guard_ok)
+{
+    const payload_header_t *hdr = (const payload_header_t *) packed;
+    reader_t r = { packed + sizeof(*hdr), packed_len - sizeof(*hdr), 7 };
+
+    memset(out, 0xA5, raw_size + 2 * GUARD);
+    int err = payload_load(hdr, mem_read, &r, out + GUARD);
+
+    *guard_ok = 1;
+    for (u32 i = 0; i < GUARD; i++)
+        if (out[i] != 0xA5 || out[GUARD + raw_size + i] != 0xA5)
+            *guard_ok = 0;
+    return err;
+}
+
+static void round_trip(void)
+{
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++)
+    {
+        const corpus_t *c = &corpora[i];
+        u8 *raw = malloc(c->size);
+        u8 *out = malloc(c->size + 2 * GUARD);
+
+        printf("%s\n", c->name);
+        c->fill(raw, c->size);
+        for (size_t j = 0; j < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]) + 1; j++)
+        {
+            int stored = j == sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
+            u32 chunk = stored ? 0 : chunk_sizes[j];
+            int guard_ok;
+
+            if (!HOST_CHECK(pack(raw, c->size, stored ? "stored" : "lz4", stored ? 65536 : chunk)))
+                continue;
+            const payload_header_t *hdr = (const payload_header_t *) packed;
+            HOST_CHECK(payload_check(hdr, packed_len));
+            HOST_CHECK(hdr->codec == (stored ? PAYLOAD_CODEC_STORED : PAYLOAD_CODEC_LZ4));
+            HOST_CHECK(hdr->raw_size == c->size);
+
+            int err = unpack(out, c->size, &guard_ok);
+            if (!HOST_CHECK(err == PAYLOAD_OK && !memcmp(out + GUARD, raw, c->size)))
+                fprintf(stderr, "  %s, chunk %u: %d\n", c->name, chunk, err);
+            HOST_CHECK(guard_ok);
+            if (!stored && c->size > 1000)
+                printf("  chunk %5u: %u -> %u bytes\n", chunk, c->size, packed_len);
+        }
+        free(raw);
+        free(out);
+    }
+}
+
+// damage to the code corpus in 4K chunks, none of it may get through
+static void damaged(void)
+{
+    const u32 size = 100000;
+    u8 *raw = malloc(size);
+    u8 *out = malloc(size + 2 * GUARD);
+    int guard_ok, err;
+
+    printf("damaged\n");
+    code(raw, size);
+    if (!HOST_CHECK(pack(raw, size, "lz4", 4096)))
+        return;
+    payload_header_t *hdr = (payload_header_t *) packed;
+    u8 *copy = malloc(packed_len);
+    memcpy(copy, packed, packed_len);
+
+    // cut short anywhere
+    u32 full = packed_len;
+    for (u32 cut = sizeof(*hdr); cut < full; cut += 997)
+    {
+        packed_len = cut;
+        HOST_CHECK(unpack(out, size, &guard_ok) == PAYLOAD_ERR_READ && guard_ok);
+    }
+    packed_len = full;
+
+    // a chunk longer than a chunk can be
+    memcpy(packed + sizeof(*hdr), "\x00\x00\x10\x01", 4);
+    HOST_CHECK(unpack(out, size, &guard_ok) == PAYLOAD_ERR_CORRUPT && guard_ok);
+    memcpy(packed, copy, packed_len);
+
+    // the wrong checksum
+    hdr->raw_crc ^= 1;
+    HOST_CHECK(unpack(out, size, &guard_ok) == PAYLOAD_ERR_CRC && guard_ok);
+    hdr->raw_crc ^= 1;
+
+    // bytes flipped all over the chunks
+    rnd_state = 3;
+    int caught = 0;
+    for (int i = 0; i < 500; i++)
+    {
+        u32 at = sizeof(*hdr) + rnd() % (packed_len - sizeof(*hdr));
+        u8 was = packed[at];
+
+        packed[at] ^= 1 << rnd() % 8;
+        err = unpack(out, size, &guard_ok);
+        HOST_CHECK(err != PAYLOAD_OK && guard_ok);
+        caught += err == PAYLOAD_ERR_CORRUPT;
+        packed[at] = was;
+    }
+    printf("  500 flipped bits, %d found by the decoder, the rest by the CRC or length\n", caught);
+    HOST_CHECK(unpack(out, size, &guard_ok) == PAYLOAD_OK && !memcmp(out + GUARD, raw, size));
+
+    free(copy);
+    free(raw);
+    free(out);
+}
+
+int main(void)
+{
+    gcmem_reset(ARENA_LO, ARENA_HI, 0);
+    if (system("mkdir -p " WORK) != 0)
+        return 1;
+
+    round_trip();
+    damaged();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
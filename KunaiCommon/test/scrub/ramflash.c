@@ -0,0 +1,154 @@
+/*
+ * ramflash.c
+ */
+
+#include <string.h>
+
+#include "host.h"
+#include "ramflash.h"
+
+#define BLOCK_SIZE 4096
+
+ramflash_stats_t ramflash_stats;
+
+static u8 image[RAMFLASH_BLOCKS][BLOCK_SIZE];
+
+static struct {
+    lfs_block_t block;
+    lfs_off_t off;
+    int bit;
+    int count;
+} faults[RAMFLASH_FAULTS];
+
+void ramflash_flip(lfs_block_t block, lfs_off_t off, int bit, int count)
+{
+    for (int i = 0; i < RAMFLASH_FAULTS; i++)
+    {
+        if (!faults[i].count)
+        {
+            faults[i].block = block;
+            faults[i].off = off;
+            faults[i].bit = bit;
+            faults[i].count = count;
+            return;
+        }
+    }
+}
+
+void ramflash_clear_faults(void)
+{
+    memset(faults, 0, sizeof(faults));
+}
+
+static int ram_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+                    void *buffer, lfs_size_t size)
+{
+    (void) c;
+    ramflash_stats.reads++;
+    host_clock_advance_us(RAMFLASH_READ_CMD_US + (u64) size * RAMFLASH_READ_KIB_US / 1024);
+
+    memcpy(buffer, &image[block][off], size);
+    for (int i = 0; i < RAMFLASH_FAULTS; i++)
+    {
+        if (faults[i].count && faults[i].block == block &&
+            faults[i].off >= off && faults[i].off < off + size)
+        {
+            ((u8 *) buffer)[faults[i].off - off] ^= 1 << faults[i].bit;
+            if (faults[i].count > 0)
+                faults[i].count--;
+        }
+    }
+    return LFS_ERR_OK;
+}
+
+static int ram_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+                    const void *buffer, lfs_size_t size)
+{
+    (void) c;
+    ramflash_stats.progs++;
+    // NOR flash only clears bits
+    for (lfs_size_t i = 0; i < size; i++)
+        image[block][off + i] &= ((const u8 *) buffer)[i];
+    return LFS_ERR_OK;
+}
+
+static int ram_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    (void) c;
+    ramflash_stats.erases++;
+    memset(image[block], 0xFF, BLOCK_SIZE);
+    return LFS_ERR_OK;
+}
+
+static int ram_sync(const struct lfs_config *c)
+{
+    (void) c;
+    return LFS_ERR_OK;
+}
+
+// kunai_lfs_config()'s default profile
+void ramflash_config(struct lfs_config *c)
+{
+    memset(c, 0, sizeof(*c));
+    memset(image, 0xFF, sizeof(image));
+    c->read = ram_read;
+    c->prog = ram_prog;
+    c->erase = ram_erase;
+    c->sync = ram_sync;
+    c->read_size = 4;
+    c->prog_size = 256;
+    c->block_size = BLOCK_SIZE;
+    c->block_count = RAMFLASH_BLOCKS;
+    c->block_cycles = 500;
+    c->cache_size = 256 * 8;
+    c->lookahead_size = 16;
+}
+
+static u32 ctz_pointer(lfs_block_t block, int n)
+{
+    const u8 *p = &image[block][n * 4];
+    return p[0] | p[1] << 8 | p[2] << 16 | (u32) p[3] << 24;
+}
+
+// position 'pos' is in block 'index' of the list, which starts at 'start'
+static lfs_off_t ctz_index(lfs_off_t pos, lfs_off_t *start)
+{
+    lfs_off_t index = 0, cap = BLOCK_SIZE;
+
+    *start = 0;
+    while (pos >= *start + cap)
+    {
+        *start += cap;
+        index++;
+        // block i holds ctz(i) + 1 pointers, to blocks i - 1, i - 2, i - 4...
+        cap = BLOCK_SIZE - 4 * (__builtin_ctz(index) + 1);
+    }
+    return index;
+}
+
+lfs_block_t ramflash_file_block(lfs_t *lfs, const char *name, lfs_off_t pos, lfs_off_t *off)
+{
+    lfs_file_t file;
+    lfs_off_t start;
+
+    if (lfs_file_open(lfs, &file, name, LFS_O_RDONLY) != LFS_ERR_OK)
+        return RAMFLASH_NO_BLOCK;
+    lfs_block_t block = file.ctz.head;
+    lfs_off_t last = ctz_index(file.ctz.size - 1, &start);
+    lfs_file_close(lfs, &file);
+
+    lfs_off_t index = ctz_index(pos, &start);
+
+    // down from the head, skipping as far as each block allows
+    while (last > index)
+    {
+        int skip = __builtin_ctz(last);
+        while (last - (1u << skip) < index)
+            skip--;
+        block = ctz_pointer(block, skip);
+        last -= 1u << skip;
+    }
+
+    *off = pos - start + (index ? 4 * (__builtin_ctz(index) + 1) : 0);
+    return block;
+}
@@ -0,0 +1,42 @@
+/*
+ * ramflash.h
+ *
+ * A LittleFS block device in RAM with the KunaiGC flash geometry. Reads
+ * cost simulated time like the EXI flash does, and single bits can be made
+ * to read back flipped for a number of reads or for good.
+ */
+
+#ifndef RAMFLASH_H_
+#define RAMFLASH_H_
+
+#include "lfs/lfs.h"
+
+#define RAMFLASH_BLOCKS		64
+#define RAMFLASH_FAULTS		8
+#define RAMFLASH_ALWAYS		-1
+#define RAMFLASH_NO_BLOCK	((lfs_block_t) -1)
+
+// reading at the EXI's 32 MHz, plus the command and address bytes
+#define RAMFLASH_READ_CMD_US	2
+#define RAMFLASH_READ_KIB_US	256
+
+typedef struct {
+    u32 reads;
+    u32 progs;
+    u32 erases;
+} ramflash_stats_t;
+
+extern ramflash_stats_t ramflash_stats;
+
+void ramflash_config(struct lfs_config *c);
+
+// read byte 'off' of 'block' with bit 'bit' flipped for the next 'count'
+// reads that cover it, or RAMFLASH_ALWAYS
+void ramflash_flip(lfs_block_t block, lfs_off_t off, int bit, int count);
+void ramflash_clear_faults(void);
+
+// the block the data at 'pos' of a closed file lives in, read from the
+// CTZ skip list in the image the way LittleFS lays it out
+lfs_block_t ramflash_file_block(lfs_t *lfs, const char *name, lfs_off_t pos, lfs_off_t *off);
+
+#endif /* RAMFLASH_H_ */
@@ -0,0 +1,152 @@
+/*
+ * scrubtest.c
+ *
+ * Runs the flash scrubber on a RAM flash with bits that read back flipped:
+ * once (a weak cell, queued for a rewrite) or on every read (a bad file).
+ * Also checks that stepping never programs the flash and never runs much
+ * past its budget, and that kunai_scrub_apply() only keeps good copies.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+
+#include "kunaigc/kunaiscrub.h"
+#include "kunaigc/kunaiinstall.h"
+
+#include "host.h"
+#include "ramflash.h"
+
+#define BUDGET_US	2000
+// one iteration is at most a metadata pair fetch, two blocks
+#define ITERATION_US	(2 * (RAMFLASH_READ_CMD_US + 4 * RAMFLASH_READ_KIB_US))
+
+static lfs_t lfs;
+struct lfs_config cfg;
+
+static void put_file(const char *name, lfs_size_t size, int sign)
+{
+    static u8 buf[16384];
+    lfs_file_t file;
+
+    for (lfs_size_t i = 0; i < size; i++)
+        buf[i] = i * 7 + name[0];
+    lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    lfs_file_write(&lfs, &file, buf, size);
+    lfs_file_close(&lfs, &file);
+
+    if (sign)
+    {
+        uint32_t crc = ~lfs_crc(0xFFFFFFFF, buf, size);
+        lfs_setattr(&lfs, name, KUNAI_ATTR_CRC, &crc, sizeof(crc));
+    }
+}
+
+static void flip(const char *name, lfs_off_t pos, int count)
+{
+    lfs_off_t off;
+    lfs_block_t block = ramflash_file_block(&lfs, name, pos, &off);
+
+    HOST_CHECK(block != RAMFLASH_NO_BLOCK);
+    ramflash_flip(block, off, 3, count);
+}
+
+// scrub to the end in budgeted steps, as the menu does once per frame
+static void scrub(kunai_scrub_t *s)
+{
+    ramflash_stats_t before = ramflash_stats;
+    u32 steps = 0, worst = 0;
+
+    kunai_scrub_start(s, &lfs, BUDGET_US);
+    for (int more = 1; more; steps++)
+    {
+        u64 start = gettime();
+        more = kunai_scrub_step(s);
+        u32 us = diff_usec(start, gettime());
+        if (us > worst)
+            worst = us;
+    }
+
+    printf("  %u steps, longest %u us\n", steps, worst);
+    HOST_CHECK(worst <= BUDGET_US + ITERATION_US);
+    HOST_CHECK(steps > 1);
+    HOST_CHECK(ramflash_stats.progs == before.progs);
+    HOST_CHECK(ramflash_stats.erases == before.erases);
+}
+
+static int has_file(const char *name)
+{
+    struct lfs_info info;
+    return lfs_stat(&lfs, name, &info) == LFS_ERR_OK;
+}
+
+int main(void)
+{
+    kunai_scrub_t s;
+
+    ramflash_config(&cfg);
+    HOST_CHECK(lfs_format(&lfs, &cfg) == LFS_ERR_OK);
+    HOST_CHECK(lfs_mount(&lfs, &cfg) == LFS_ERR_OK);
+
+    put_file("good", 6000, 1);
+    put_file("weak", 10000, 1);
+    put_file("weak_small", 1500, 1);
+    put_file("bad", 10000, 1);
+    put_file("unsigned", 3000, 0);
+    put_file(KUNAI_INSTALL_TMP, 3000, 0);
+
+    lfs_off_t off;
+    lfs_block_t weak_block = ramflash_file_block(&lfs, "weak", 100, &off);
+    flip("weak", 100, 1);
+    flip("weak_small", 700, 1);
+    flip("bad", 9000, RAMFLASH_ALWAYS);
+
+    printf("scrub with flipped bits\n");
+    scrub(&s);
+    HOST_CHECK(s.meta_err == 0);
+    HOST_CHECK(s.files_ok == 1);
+    HOST_CHECK(s.files_weak == 2);
+    HOST_CHECK(s.files_bad == 1);
+    HOST_CHECK(s.files_unsigned == 1);
+    HOST_CHECK(!strcmp(s.last_bad, "bad"));
+    HOST_CHECK(s.fix_count == 3);
+
+    printf("apply the fixes\n");
+    u32 progs = ramflash_stats.progs;
+    HOST_CHECK(kunai_scrub_apply(&s) == 0);
+    HOST_CHECK(s.files_signed == 1);
+    HOST_CHECK(s.files_rewritten == 2);
+    HOST_CHECK(s.fix_count == 0);
+    HOST_CHECK(ramflash_stats.progs > progs);
+    HOST_CHECK(!has_file(KUNAI_SCRUB_TMP));
+    // copy on write, the rewritten file lives somewhere else now
+    HOST_CHECK(ramflash_file_block(&lfs, "weak", 100, &off) != weak_block);
+
+    printf("scrub again\n");
+    scrub(&s);
+    HOST_CHECK(s.files_ok == 4);
+    HOST_CHECK(s.files_weak == 0);
+    HOST_CHECK(s.files_bad == 1);
+    HOST_CHECK(s.files_unsigned == 0);
+    HOST_CHECK(s.fix_count == 0);
+
+    // a copy that reads back wrong is dropped and the original kept
+    printf("rewrite that fails\n");
+    ramflash_clear_faults();
+    flip("weak", 5000, 1);
+    scrub(&s);
+    HOST_CHECK(s.files_weak == 1);
+    weak_block = ramflash_file_block(&lfs, "weak", 5000, &off);
+    ramflash_flip(weak_block, off, 3, RAMFLASH_ALWAYS);
+    HOST_CHECK(kunai_scrub_apply(&s) == 1);
+    HOST_CHECK(s.files_rewritten == 0);
+    HOST_CHECK(!strcmp(s.last_bad, "weak"));
+    HOST_CHECK(!has_file(KUNAI_SCRUB_TMP));
+    HOST_CHECK(ramflash_file_block(&lfs, "weak", 5000, &off) == weak_block);
+
+    lfs_unmount(&lfs);
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
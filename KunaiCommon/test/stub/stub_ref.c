@@ -0,0 +1,179 @@
+/*
+ * stub_ref.c
+ *
+ * Reference for stub.S, step for step and with its header offsets.
+ * Addresses are those of the GameCube, 'mem' is where main memory starts.
+ */
+
+#include <string.h>
+
+#include "stub_ref.h"
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+
+#define MEM_BASE	0x80000000
+
+// dol_header_t, see dolload.h
+#define DOL_OFFSET	0x00
+#define DOL_ADDR	0x48
+#define DOL_SIZE	0x90
+#define DOL_BSS_ADDR	0xd8
+#define DOL_BSS_SIZE	0xdc
+#define DOL_ENTRY	0xe0
+#define DOL_EXTRA_MAGIC	0xe4
+#define DOL_EXTRA	0xe8
+#define DOL_EXTRA_COUNT	0xec
+#define DOL_TEXT_MAX	7
+#define DOL_SECTIONS	18
+#define DOL_EXTRA_ARAM	0x4152414d
+
+// dolload_extra_t
+#define EXTRA_DST	0
+#define EXTRA_SRC	4
+#define EXTRA_SIZE	8
+#define EXTRA_FLAGS	12
+#define EXTRA_TEXT	1
+#define EXTRA_ARAM	2
+
+typedef struct {
+    u8 *mem;
+    const u8 *aram;
+    stub_line_fn line;
+    void *ctx;
+} stub_ref_t;
+
+#define AT(r, addr)	((r)->mem + ((addr) - MEM_BASE))
+
+static u32 word(const u8 *p) {
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static void line_op(stub_ref_t *r, u32 addr, int op) {
+    if (op == STUB_LINE_DCBZ)
+        memset(AT(r, addr & ~31), 0, 32);
+    if (r->line)
+        r->line(r->ctx, addr & ~31, op);
+}
+
+// one destination line, the whole source line is read before dcbz claims it
+static void copy_line(stub_ref_t *r, u32 dst, u32 src) {
+    u8 tmp[32];
+
+    memcpy(tmp, AT(r, src), 32);
+    line_op(r, dst, STUB_LINE_DCBZ);
+    memcpy(AT(r, dst), tmp, 32);
+    line_op(r, dst, STUB_LINE_DCBST);
+}
+
+static void copy_forward(stub_ref_t *r, u32 dst, u32 src, u32 n) {
+    for (; n && (dst & 31); n--)
+        *AT(r, dst++) = *AT(r, src++);
+    for (; n >= 32; n -= 32, dst += 32, src += 32)
+        copy_line(r, dst, src);
+    for (; n; n--)
+        *AT(r, dst++) = *AT(r, src++);
+}
+
+static void copy_backward(stub_ref_t *r, u32 dst, u32 src, u32 n) {
+    dst += n;
+    src += n;
+    for (; n && (dst & 31); n--)
+        *AT(r, --dst) = *AT(r, --src);
+    for (; n >= 32; n -= 32) {
+        dst -= 32;
+        src -= 32;
+        copy_line(r, dst, src);
+    }
+    for (; n; n--)
+        *AT(r, --dst) = *AT(r, --src);
+}
+
+static void clear(stub_ref_t *r, u32 dst, u32 n) {
+    for (; n && (dst & 31); n--)
+        *AT(r, dst++) = 0;
+    for (; n >= 32; n -= 32, dst += 32) {
+        line_op(r, dst, STUB_LINE_DCBZ);
+        line_op(r, dst, STUB_LINE_DCBST);
+    }
+    for (; n; n--)
+        *AT(r, dst++) = 0;
+}
+
+// whole lines behind the data cache, which drops them first
+static void aram_copy(stub_ref_t *r, u32 dst, u32 src, u32 n) {
+    for (u32 a = dst; a < dst + n; a += 32)
+        line_op(r, a, STUB_LINE_DCBI);
+    memcpy(AT(r, dst), r->aram + src, n);
+}
+
+// the full lines went out while copying, write back the partial ones at
+// both ends, then drop text from the instruction cache
+static void flush(stub_ref_t *r, u32 addr, u32 n, int text) {
+    if (!n)
+        return;
+
+    u32 last = addr + n - 1;
+    line_op(r, addr, STUB_LINE_DCBST);
+    line_op(r, last, STUB_LINE_DCBST);
+    if (!text)
+        return;
+
+    for (u32 a = addr & ~31; a <= (last & ~31); a += 32)
+        line_op(r, a, STUB_LINE_ICBI);
+}
+
+u32 stub_ref(u8 *mem, const u8 *aram, u32 dol, stub_line_fn line, void *ctx) {
+    stub_ref_t r = { mem, aram, line, ctx };
+    u8 hdr[STUB_REF_HDR_SIZE];
+    int i, step;
+
+    // the copy on the stack, the sections may overwrite the image header
+    memcpy(hdr, AT(&r, dol), sizeof(hdr));
+
+    // sections moving down are copied first to last, else last to first
+    if (word(hdr + DOL_ADDR) < dol + word(hdr + DOL_OFFSET)) {
+        i = 0;
+        step = 1;
+    } else {
+        i = DOL_SECTIONS - 1;
+        step = -1;
+    }
+
+    for (; i >= 0 && i < DOL_SECTIONS; i += step) {
+        u32 dst = word(hdr + DOL_ADDR + i * 4);
+        u32 src = dol + word(hdr + DOL_OFFSET + i * 4);
+        u32 n = word(hdr + DOL_SIZE + i * 4);
+
+        if (!n)
+            continue;
+        if (dst <= src)
+            copy_forward(&r, dst, src, n);
+        else
+            copy_backward(&r, dst, src, n);
+        flush(&r, dst, n, i < DOL_TEXT_MAX);
+    }
+
+    u32 count = word(hdr + DOL_EXTRA_MAGIC) == DOL_EXTRA_ARAM ? word(hdr + DOL_EXTRA_COUNT) : 0;
+    for (u32 k = 0; k < count; k++) {
+        const u8 *e = AT(&r, word(hdr + DOL_EXTRA) + k * 16);
+        u32 dst = word(e + EXTRA_DST), src = word(e + EXTRA_SRC);
+        u32 n = word(e + EXTRA_SIZE), flags = word(e + EXTRA_FLAGS);
+
+        if (flags & EXTRA_ARAM)
+            aram_copy(&r, dst, src, n);
+        else if (dst <= src)
+            copy_forward(&r, dst, src, n);
+        else
+            copy_backward(&r, dst, src, n);
+        flush(&r, dst, n, flags & EXTRA_TEXT);
+    }
+
+    u32 bss = word(hdr + DOL_BSS_ADDR), bss_size = word(hdr + DOL_BSS_SIZE);
+    clear(&r, bss, bss_size);
+    flush(&r, bss, bss_size, 0);
+
+    return word(hdr + DOL_ENTRY);
+}
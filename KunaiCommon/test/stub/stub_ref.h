@@ -0,0 +1,33 @@
+/*
+ * stub_ref.h
+ *
+ * stub.S in portable C, for checking staged images and the cache
+ * maintenance on the host. Host only, it isn't part of either IPL.
+ */
+
+#ifndef STUB_REF_H_
+#define STUB_REF_H_
+
+#include <stdint.h>
+
+// the part of the DOL header stub.S keeps a copy of, up to extra_count
+#define STUB_REF_HDR_SIZE	0xf0
+
+enum stub_line_op {
+    STUB_LINE_DCBZ,
+    STUB_LINE_DCBST,
+    STUB_LINE_ICBI,
+    STUB_LINE_DCBI,
+};
+
+// called for every cache line operation the stub would issue
+typedef void (*stub_line_fn)(void *ctx, uint32_t addr, int op);
+
+// Place the image at address 'dol' like the stub does. 'mem' holds main
+// memory from 0x80000000 up, the image included, 'aram' the ARAM. Words
+// are read in the host's byte order, as the stub reads them in the CPU's.
+// Returns the entry point.
+uint32_t stub_ref(uint8_t *mem, const uint8_t *aram, uint32_t dol,
+                  stub_line_fn line, void *ctx);
+
+#endif /* STUB_REF_H_ */
@@ -0,0 +1,156 @@
+/*
+ * stubtest.c
+ *
+ * Loads every corpus DOL with the real dolload_load() into GameCube memory
+ * mapped on the host, then runs stub_ref() on the staged image it returns
+ * and checks what the program would find at its entry point: every section
+ * at its address, the BSS cleared, and every line of them written back to
+ * memory (and dropped from the instruction cache for text) by either the
+ * loader or the stub.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dolload/dolload.h"
+
+#include "host.h"
+#include "gcmem.h"
+#include "stub_ref.h"
+#include "dol/corpus.h"
+
+// what the stub did to each line, in gcmem line order
+#define STUB_STORED	0x01
+#define STUB_ICBI	0x02
+#define STUB_DCBI	0x04
+
+static u8 stub_lines[GCMEM_LINES];
+static int icbi_before_store;
+
+typedef struct {
+    const u8 *data;
+    u32 size;
+    u32 next;			// reads must not go back before this
+} file_t;
+
+static int file_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    file_t *f = ctx;
+
+    HOST_CHECK(ofs >= f->next);
+    if (ofs > f->size || len > f->size - ofs)
+        return -1;
+    memcpy(buf, f->data + ofs, len);
+    f->next = ofs + len;
+    return 0;
+}
+
+static void on_line(void *ctx, u32 addr, int op)
+{
+    u8 *l = &stub_lines[(addr - GCMEM_BASE) / 32];
+
+    (void) ctx;
+    switch (op)
+    {
+    case STUB_LINE_DCBST:
+        *l |= STUB_STORED;
+        break;
+    case STUB_LINE_ICBI:
+        // fetching a line the data cache still holds runs stale code
+        if (!(*l & (STUB_STORED | STUB_DCBI)) && !(*gcmem_line(addr) & GCMEM_DC_FLUSHED))
+            icbi_before_store++;
+        *l |= STUB_ICBI;
+        break;
+    case STUB_LINE_DCBI:
+        *l |= STUB_DCBI;
+        break;
+    }
+}
+
+// every line of [addr, addr + size) reached memory, and the instruction
+// cache for text
+static int lines_done(u32 addr, u32 size, int text)
+{
+    for (u32 a = addr & ~31; a < addr + size; a += 32)
+    {
+        u8 loader = *gcmem_line(a);
+        u8 stub = stub_lines[(a - GCMEM_BASE) / 32];
+        int stored = (loader & GCMEM_DC_FLUSHED) || (stub & (STUB_STORED | STUB_DCBI));
+        int fetched = (loader & GCMEM_IC_INVALIDATED) || (stub & STUB_ICBI);
+
+        if (!stored || (text && !fetched))
+        {
+            fprintf(stderr, "  line %08X not %s\n", a, stored ? "invalidated" : "written back");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void run(const corpus_dol_t *c)
+{
+    const dol_header_t *hdr = &c->hdr;
+    file_t file = { corpus_file(c), c->file_size, sizeof(*hdr) };
+
+    printf("%s\n", c->name);
+    gcmem_reset(CORPUS_ARENA_LO, CORPUS_ARENA_HI, 0xAA);
+    memset(stub_lines, 0, sizeof(stub_lines));
+    icbi_before_store = 0;
+
+    HOST_CHECK(dolload_check(hdr, c->file_size));
+    u8 *image = dolload_load(hdr, file_read, &file, DOLLOAD_NO_FALLBACK);
+    if (!HOST_CHECK(!image == !c->loads) || !image)
+    {
+        free((void *) file.data);
+        return;
+    }
+
+    // the heap stays below everything placed directly, which is all the
+    // loader flushed, and the staged image
+    u32 base = (u32) (uintptr_t) image;
+    u32 arena_hi = (u32) (uintptr_t) SYS_GetArenaHi();
+    HOST_CHECK(arena_hi <= base);
+    for (u32 a = GCMEM_BASE; a < arena_hi; a += 32)
+        if (*gcmem_line(a) & GCMEM_DC_FLUSHED)
+        {
+            HOST_CHECK(!"placed below the arena top");
+            break;
+        }
+
+    u32 entry = stub_ref(gcmem_at(GCMEM_BASE), gcmem_aram, base, on_line, NULL);
+    HOST_CHECK(entry == hdr->entry);
+    HOST_CHECK(icbi_before_store == 0);
+
+    for (int i = 0; i < DOL_SECTIONS; i++)
+    {
+        if (!hdr->size[i])
+            continue;
+        if (!HOST_CHECK(!memcmp(gcmem_at(hdr->addr[i]), file.data + hdr->offset[i], hdr->size[i])))
+            fprintf(stderr, "  section %d at %08X\n", i, hdr->addr[i]);
+        HOST_CHECK(lines_done(hdr->addr[i], hdr->size[i], i < DOL_TEXT_MAX));
+    }
+
+    static const u8 zero[0x40000];
+    u32 left = hdr->bss_size;
+    for (u32 a = hdr->bss_addr; left; )
+    {
+        u32 n = left < sizeof(zero) ? left : sizeof(zero);
+        HOST_CHECK(!memcmp(gcmem_at(a), zero, n));
+        a += n;
+        left -= n;
+    }
+    HOST_CHECK(lines_done(hdr->bss_addr, hdr->bss_size, 0));
+
+    free((void *) file.data);
+}
+
+int main(void)
+{
+    for (int i = 0; i < corpus_count; i++)
+        run(corpus[i]);
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * unicodetest.c
+ *
+ * The ffunicode.c buildtools/ffunicode.py generates for the loaders'
+ * ffconf.h against the vendored one it was generated from. The generated
+ * functions are built with a trim_ prefix. Both have to agree on every
+ * character of the code page and on ASCII, which is all the loaders look
+ * up; anything else the generated ff_wtoupper() leaves alone.
+ */
+
+#include <stdio.h>
+
+#include "ff.h"
+
+#include "host.h"
+
+WCHAR trim_oem2uni(WCHAR oem, WORD cp);
+WCHAR trim_uni2oem(DWORD uni, WORD cp);
+DWORD trim_wtoupper(DWORD uni);
+
+static int in_code_page[0x10000];
+
+static void code_page(void)
+{
+    printf("code page %d\n", FF_CODE_PAGE);
+    for (WCHAR c = 0; c < 0x100; c++)
+    {
+        WCHAR uni = ff_oem2uni(c, FF_CODE_PAGE);
+
+        HOST_CHECK(trim_oem2uni(c, FF_CODE_PAGE) == uni);
+        if (uni)
+            in_code_page[uni] = 1;
+    }
+    // both ways, and nothing outside it
+    for (DWORD uni = 0; uni < 0x10000; uni++)
+        if (!HOST_CHECK(trim_uni2oem(uni, FF_CODE_PAGE) == ff_uni2oem(uni, FF_CODE_PAGE)))
+        {
+            fprintf(stderr, "  U+%04X\n", uni);
+            break;
+        }
+}
+
+static void upcase(void)
+{
+    int differ = 0, pairs = 0;
+
+    printf("up-case\n");
+    for (DWORD uni = 0; uni < 0x10000; uni++)
+    {
+        DWORD up = trim_wtoupper(uni);
+
+        if (uni < 0x80 || in_code_page[uni])
+        {
+            if (!HOST_CHECK(up == ff_wtoupper(uni)))
+                fprintf(stderr, "  U+%04X: U+%04X, not U+%04X\n", uni, up, ff_wtoupper(uni));
+            pairs += up != uni;
+        }
+        else if (!HOST_CHECK(up == uni))
+        {
+            fprintf(stderr, "  U+%04X changed outside the code page\n", uni);
+            break;
+        }
+        else
+            differ += ff_wtoupper(uni) != uni;
+    }
+    // what the full table would have up-cased besides
+    printf("  %d characters up-cased, %d left to the full table\n", pairs, differ);
+    HOST_CHECK(pairs > 26);
+}
+
+int main(void)
+{
+    code_page();
+    upcase();
+
+    if (host_failures)
+        printf("%d checks failed\n", host_failures);
+    return host_failures != 0;
+}
@@ -1,8 +1,10 @@
 #include "../fatfs/ff.h"
 #include "../fatfs/diskio.h"
 #include "ffshim.h"
+#include "boottime/boottime.h"
 
 const DISC_INTERFACE *iface = NULL;
+int iface_started;
 
 DSTATUS disk_status(BYTE pdrv)
 {
@@ -20,21 +22,29 @@ DSTATUS disk_initialize(BYTE pdrv)
 {
     (void) pdrv;
 
+    u64 start = gettime();
+    sectorcache_flush();
+
+    int started = iface_started;
+    iface_started = 0;
+
     if (iface == NULL)
         goto noinit;
 
-    if (!iface->startup())
+    if (!started && !iface->startup())
         goto noinit;
 
     if (!iface->isInserted())
         goto shutdown;
 
+    boottime_add(BOOTTIME_DISK_INIT, start);
     return 0;
 
 shutdown:
         iface->shutdown();
 noinit:
         iface = NULL;
+        boottime_add(BOOTTIME_DISK_INIT, start);
         return STA_NOINIT;
 }
 
@@ -45,8 +55,9 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
     if (iface == NULL)
         return RES_NOTRDY;
 
-    if (iface->readSectors(sector, count, buff))
-        return RES_OK;
-    else
-        return RES_ERROR;
+    u64 start = gettime();
+    DRESULT res = sectorcache_read(iface, sector, count, buff) ? RES_OK : RES_ERROR;
+
+    boottime_disk_read(count, start);
+    return res;
 }
@@ -3,6 +3,10 @@
 
 #include <ogc/disc_io.h>
 
+#include "sectorcache/sectorcache.h"
+
 extern const DISC_INTERFACE *iface;
+// set if 'iface' is already started, the next mount only checks for the card
+extern int iface_started;
 
 #endif
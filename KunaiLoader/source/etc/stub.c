@@ -1,44 +0,0 @@
-/*
-  This file was autogenerated by raw2c.
-Visit http://www.devkitpro.org
-*/
-
-const unsigned char stub[] = {
-	0x94, 0x21, 0xfe, 0xe8, 0x38, 0xe6, 0x00, 0x1e, 0x7d, 0x08, 0x02, 0xa6, 0xbf, 0x21, 0x00, 0xfc, 
-	0x7c, 0xbd, 0x2b, 0x78, 0x7c, 0xdc, 0x33, 0x78, 0x80, 0xa1, 0x00, 0x00, 0x54, 0xe6, 0x00, 0x36, 
-	0x7c, 0x3f, 0x0b, 0x78, 0x7c, 0x86, 0x00, 0xd0, 0x91, 0x01, 0x01, 0x1c, 0x7c, 0xa1, 0x21, 0x6e, 
-	0x7c, 0x7e, 0x1b, 0x78, 0x3b, 0x7f, 0x00, 0x08, 0x7f, 0xc4, 0xf3, 0x78, 0x3b, 0x41, 0x00, 0x17, 
-	0x38, 0xa0, 0x00, 0xe4, 0x57, 0x5a, 0x00, 0x36, 0x7f, 0x63, 0xdb, 0x78, 0x48, 0x00, 0x01, 0x91, 
-	0x7f, 0xa4, 0xeb, 0x78, 0x7f, 0x43, 0xd3, 0x78, 0x7f, 0x85, 0xe3, 0x78, 0x48, 0x00, 0x01, 0x81, 
-	0x80, 0x7f, 0x00, 0x08, 0x80, 0x5f, 0x00, 0x50, 0x3b, 0xbf, 0x00, 0x98, 0x7c, 0x1e, 0x1a, 0x14, 
-	0x3b, 0x3f, 0x00, 0x6c, 0x7f, 0x82, 0x00, 0x40, 0x40, 0x9c, 0x00, 0x68, 0x3b, 0xbf, 0x00, 0x4c, 
-	0x3b, 0x3f, 0x00, 0x68, 0x84, 0x7d, 0x00, 0x04, 0x81, 0x3d, 0xff, 0xb8, 0x80, 0xbd, 0x00, 0x48, 
-	0x7c, 0x9e, 0x4a, 0x14, 0x48, 0x00, 0x01, 0x49, 0x80, 0x7d, 0x00, 0x00, 0x80, 0x9d, 0x00, 0x48, 
-	0x48, 0x00, 0x01, 0x21, 0x7c, 0x1d, 0xc8, 0x00, 0x40, 0x82, 0xff, 0xdc, 0x3b, 0xbf, 0x00, 0x68, 
-	0x3b, 0x7b, 0x00, 0x8c, 0x84, 0x7d, 0x00, 0x04, 0x81, 0x5d, 0xff, 0xb8, 0x80, 0xbd, 0x00, 0x48, 
-	0x7c, 0x9e, 0x52, 0x14, 0x48, 0x00, 0x01, 0x19, 0x80, 0x7d, 0x00, 0x00, 0x80, 0x9d, 0x00, 0x48, 
-	0x48, 0x00, 0x00, 0xf1, 0x7c, 0x9d, 0xd8, 0x00, 0x40, 0x86, 0xff, 0xdc, 0x48, 0x00, 0x00, 0x58, 
-	0x84, 0x7d, 0xff, 0xfc, 0x81, 0x7d, 0xff, 0xb8, 0x80, 0xbd, 0x00, 0x48, 0x7c, 0x9e, 0x5a, 0x14, 
-	0x48, 0x00, 0x00, 0xed, 0x80, 0x7d, 0x00, 0x00, 0x80, 0x9d, 0x00, 0x48, 0x48, 0x00, 0x00, 0xc5, 
-	0x7f, 0x1d, 0xc8, 0x00, 0x40, 0x9a, 0xff, 0xdc, 0x3b, 0xbf, 0x00, 0x24, 0x80, 0x7d, 0x00, 0x44, 
-	0x85, 0x9d, 0xff, 0xfc, 0x80, 0xbd, 0x00, 0x90, 0x7c, 0x9e, 0x62, 0x14, 0x48, 0x00, 0x00, 0xc1, 
-	0x80, 0x7d, 0x00, 0x48, 0x80, 0x9d, 0x00, 0x90, 0x48, 0x00, 0x00, 0x99, 0x7f, 0x9d, 0xd8, 0x00, 
-	0x40, 0x9e, 0xff, 0xdc, 0x83, 0x7f, 0x00, 0xe4, 0x38, 0x00, 0x00, 0x00, 0x80, 0x5f, 0x00, 0xe0, 
-	0x3b, 0x3b, 0x00, 0x01, 0x7f, 0x29, 0x03, 0xa6, 0x48, 0x00, 0x00, 0x0c, 0x98, 0x02, 0x00, 0x00, 
-	0x38, 0x42, 0x00, 0x01, 0x42, 0x00, 0xff, 0xf8, 0x80, 0x7f, 0x00, 0xe0, 0x80, 0x9f, 0x00, 0xe4, 
-	0x48, 0x00, 0x00, 0x61, 0x81, 0x3f, 0x00, 0xe8, 0x3c, 0x49, 0x40, 0x00, 0x80, 0x02, 0x00, 0x04, 
-	0x6c, 0x1e, 0x5f, 0x61, 0x2c, 0x1e, 0x72, 0x67, 0x40, 0x82, 0x00, 0x18, 0x2c, 0x9c, 0x00, 0x00, 
-	0x41, 0x86, 0x00, 0x10, 0x90, 0x02, 0x00, 0x08, 0x93, 0x42, 0x00, 0x0c, 0x93, 0x82, 0x00, 0x10, 
-	0x7c, 0x00, 0x04, 0xac, 0x7c, 0x50, 0xfa, 0xa6, 0x60, 0x40, 0x0c, 0x00, 0x7c, 0x10, 0xfb, 0xa6, 
-	0x7d, 0x29, 0x03, 0xa6, 0x4e, 0x80, 0x04, 0x21, 0x39, 0x7f, 0x01, 0x18, 0x83, 0x8b, 0x00, 0x04, 
-	0x7f, 0x88, 0x03, 0xa6, 0xbb, 0x2b, 0xff, 0xe4, 0x7d, 0x61, 0x5b, 0x78, 0x4e, 0x80, 0x00, 0x20, 
-	0x38, 0x40, 0x00, 0x00, 0x48, 0x00, 0x00, 0x0c, 0x7c, 0x03, 0x10, 0x6c, 0x38, 0x42, 0x00, 0x20, 
-	0x7f, 0x82, 0x20, 0x40, 0x41, 0x9c, 0xff, 0xf4, 0x4e, 0x80, 0x00, 0x20, 0x7f, 0x83, 0x20, 0x40, 
-	0x38, 0x05, 0x00, 0x01, 0x38, 0x40, 0x00, 0x00, 0x7c, 0x09, 0x03, 0xa6, 0x41, 0x9c, 0x00, 0x14, 
-	0x48, 0x00, 0x00, 0x18, 0x7c, 0xa4, 0x10, 0xae, 0x7c, 0xa3, 0x11, 0xae, 0x38, 0x42, 0x00, 0x01, 
-	0x42, 0x00, 0xff, 0xf4, 0x4e, 0x80, 0x00, 0x20, 0x41, 0xbd, 0x00, 0x18, 0x4e, 0x80, 0x00, 0x20, 
-	0x38, 0xa5, 0xff, 0xff, 0x7c, 0x44, 0x28, 0xae, 0x7c, 0x43, 0x29, 0xae, 0x48, 0x00, 0x00, 0x0c, 
-	0x38, 0xc5, 0x00, 0x01, 0x7c, 0xc9, 0x03, 0xa6, 0x42, 0x00, 0xff, 0xe8, 0x4e, 0x80, 0x00, 0x20
-	
-};
-const int stub_size = sizeof(stub);
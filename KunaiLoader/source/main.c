@@ -9,8 +9,16 @@
 #include <ogc/system.h>
 #include "etc/ffshim.h"
 #include "fatfs/ff.h"
-
-#include "etc/stub.h"
+#include "fatboot/fatboot.h"
+#include "payload/payload.h"
+#include "dolload/dolload.h"
+#include "elfload/elfload.h"
+#include "geckolink/geckolink.h"
+#include "boottime/boottime.h"
+#include "bootprobe/bootprobe.h"
+#include "bootprobe/bootlast.h"
+
+#include "stub/stub.h"
 #define STUB_ADDR  0x80001000
 #define STUB_STACK 0x80003000
 
@@ -22,14 +30,19 @@ u32 retraceCount;
 #include "gfx/gfx.h"
 #include "spiflash/spiflash.h"
 #include "kunaigc/kunaigc.h"
+#include "kunaigc/kunaistorage.h"
+#include "kunaigc/kunaiscrub.h"
+#include "kunaigc/kunaiprefetch.h"
+#include "kunaigc/kunaiinstall.h"
 #define KUNAI_VERSION "1.0"
 
 u8 *dol = NULL;
 char *path = "/KUNAIGC/ipl.dol";
 
-extern lfs_t lfs;
+// where the dol was loaded from, saved for the next boot
+bootlast_t boot_record;
+
 extern lfs_file_t lfs_file;
-extern struct lfs_config cfg;
 
 struct shortcut {
   u16 pad_buttons;
@@ -60,7 +73,10 @@ void dol_alloc(int size)
         return;
     }
 
-    dol = (u8 *) memalign(32, size);
+    u64 start = gettime();
+    // whole sectors, fatboot_read reads the last one straight into it
+    dol = (u8 *) memalign(32, FATBOOT_BUF_SIZE(size));
+    boottime_add(BOOTTIME_ALLOC, start);
 
     if (!dol)
     {
@@ -68,7 +84,59 @@ void dol_alloc(int size)
     }
 }
 
-int load_fat(const char *slot_name, const DISC_INTERFACE *iface_)
+// decode a payload container into a freshly allocated dol
+int load_payload(const payload_header_t *hdr, payload_read_fn read, void *ctx)
+{
+    kprintf("Payload is %s, %u bytes unpacked\n", payload_codec_name(hdr->codec),
+            hdr->raw_size);
+
+    dol_alloc(hdr->raw_size);
+    if (!dol)
+        return 0;
+
+    u64 start = gettime();
+    int err = payload_load(hdr, read, ctx, dol);
+    boottime_add(BOOTTIME_READ, start);
+    if (err != PAYLOAD_OK)
+    {
+        kprintf("Failed to unpack payload (%d)\n", err);
+        free(dol);
+        dol = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// an ELF is placed like a DOL, there is no reading it whole instead
+static int load_elf(const dol_header_t *head, u32 head_len, u32 size,
+                    dolload_read_fn read, void *ctx)
+{
+    int err;
+
+    kprintf("Loading ELF\n");
+    dol = elfload_load(head, head_len, size, read, ctx, &err);
+    if (!dol)
+        kprintf("Failed to load ELF (%d)\n", err);
+    return dol != NULL;
+}
+
+static int fat_payload_read(void *ctx, void *buf, u32 len)
+{
+    UINT got;
+    if (f_read(ctx, buf, len, &got) != FR_OK)
+        return -1;
+    return got;
+}
+
+static int fat_dol_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    return fatboot_pread(ctx, ofs, buf, len) == FR_OK ? 0 : -1;
+}
+
+// 'expect' is the record of the last boot from this slot, the file is
+// opened from its recorded location and only if that is still valid
+int load_fat(const char *slot_name, const DISC_INTERFACE *iface_, int src,
+             const bootlast_t *expect)
 {
     int res = 1;
 
@@ -76,35 +144,118 @@ int load_fat(const char *slot_name, const DISC_INTERFACE *iface_)
 
     FATFS fs;
     iface = iface_;
-    if (f_mount(&fs, "", 1) != FR_OK)
+    // a card the probe found is still up, it isn't initialised again
+    iface_started = bootprobe_take(iface_);
+    u64 start = gettime();
+    FRESULT mounted = f_mount(&fs, "", 1);
+    boottime_add(BOOTTIME_MOUNT, start);
+    if (mounted != FR_OK)
     {
         kprintf("Couldn't mount %s\n", slot_name);
         res = 0;
         goto end;
     }
 
-    char name[256];
-    f_getlabel(slot_name, name, NULL);
-    kprintf("Mounted %s as %s\n", name, slot_name);
-
-    kprintf("Reading %s\n", path);
     FIL file;
-    if (f_open(&file, path, FA_READ) != FR_OK)
+    fatboot_loc_t loc;
+    FRESULT opened;
+    if (expect)
     {
-        kprintf("Failed to open file\n");
-        res = 0;
-        goto unmount;
+        // no label lookup and no path walk, just the boot sector and the
+        // sector with the file's directory entry
+        kprintf("Mounted %s\n", slot_name);
+        start = gettime();
+        opened = fatboot_reopen(&fs, &file, &expect->loc);
+        boottime_add(BOOTTIME_OPEN, start);
+        if (opened != FR_OK)
+        {
+            kprintf("File changed since the last boot\n");
+            res = 0;
+            goto unmount;
+        }
+        loc = expect->loc;
+    }
+    else
+    {
+        char name[256];
+        f_getlabel(slot_name, name, NULL);
+        kprintf("Mounted %s as %s\n", name, slot_name);
+
+        kprintf("Reading %s\n", path);
+        start = gettime();
+        opened = f_open(&file, path, FA_READ);
+        if (opened == FR_OK && fatboot_locate(&file, &loc) != FR_OK)
+            loc.vsn = loc.dir_sect = 0;
+        boottime_add(BOOTTIME_OPEN, start);
+        if (opened != FR_OK)
+        {
+            kprintf("Failed to open file\n");
+            res = 0;
+            goto unmount;
+        }
     }
 
     size_t size = f_size(&file);
-    dol_alloc(size);
+    payload_header_t hdr;
+    UINT got;
+    if (f_read(&file, &hdr, sizeof(hdr), &got) == FR_OK && got == sizeof(hdr) &&
+        payload_check(&hdr, size))
+    {
+        if (!load_payload(&hdr, fat_payload_read, &file))
+        {
+            f_close(&file);
+            res = 0;
+            goto unmount;
+        }
+    }
+    else
+    {
+        // a plain DOL or ELF, sections that land in free memory are read
+        // straight to their address, the rest is staged for the stub. There
+        // is no copy left to overlap with the next read (fatbench: dol_us
+        // is within 0.2% of one fatboot_read of the file), and libogc's SD
+        // driver waits out every DMA in EXI_Sync anyway.
+        dol_header_t dol_hdr;
+        int elf = 0;
+        start = gettime();
+        fatboot_map(&file);
+        if (fatboot_pread(&file, 0, &dol_hdr, sizeof(dol_hdr)) == FR_OK)
+        {
+            if (dolload_check(&dol_hdr, size))
+                dol = dolload_load(&dol_hdr, fat_dol_read, &file, 0);
+            else if ((elf = elfload_check((elf32_ehdr_t *) &dol_hdr, size)))
+                load_elf(&dol_hdr, sizeof(dol_hdr), size, fat_dol_read, &file);
+        }
+        boottime_add(BOOTTIME_READ, start);
+        if (elf && !dol)
+        {
+            f_close(&file);
+            res = 0;
+            goto unmount;
+        }
+    }
     if (!dol)
     {
-        res = 0;
-        goto unmount;
+        // not a DOL or it doesn't split, read it in one go
+        f_lseek(&file, 0);
+        dol_alloc(size);
+        if (!dol)
+        {
+            res = 0;
+            goto unmount;
+        }
+        start = gettime();
+        fatboot_read(&file, dol, size);
+        boottime_add(BOOTTIME_READ, start);
     }
-    UINT _;
-    f_read(&file, dol, size, &_);
+    kprintf("Sector cache: %u hits, %u misses, %u bypassed\n",
+            sectorcache_stats.hits, sectorcache_stats.misses,
+            sectorcache_stats.bypassed);
+
+    // a file that can't be located is still booted, just not remembered
+    if (loc.dir_sect)
+        boot_record.src = src;
+    boot_record.loc = loc;
     f_close(&file);
 
 unmount:
@@ -128,10 +279,133 @@ unsigned int convert_int(unsigned int in)
     return out;
 }
 
-#define PC_READY 0x80
-#define PC_OK    0x81
-#define GC_READY 0x88
-#define GC_OK    0x89
+static int gecko_payload_read(void *ctx, void *buf, u32 len)
+{
+    geckolink_t *link = ctx;
+    u32 left = link->xfer.size - link->done;
+    if (len > left)
+        len = left;
+    return len ? geckolink_read(link, buf, len) : 0;
+}
+
+static int gecko_recv_read(void *ctx, void *buf, u32 len)
+{
+    return geckolink_recv(ctx, buf, len) == GECKOLINK_OK ? (int) len : -1;
+}
+
+// Undo a load that failed a later check. A placed DOL isn't on the heap,
+// giving the arena back is all there is to free.
+static void drop_dol(void *arena_hi)
+{
+    if (SYS_GetArenaHi() != arena_hi)
+        SYS_SetArenaHi(arena_hi);
+    else
+        free(dol);
+    dol = NULL;
+}
+
+// Load a DOL or ELF of 'size' bytes from a stream, the first s->pos bytes of it
+// are already in 'hdr'. Sections are placed as they come in and the rest of
+// the file is read and dropped. A DOL that doesn't split is read whole, as
+// long as nothing past the header was consumed yet.
+static int load_dol_stream(dolload_stream_t *s, dol_header_t *hdr, u32 size)
+{
+    u8 *head = (u8 *) hdr;
+    u32 want = size < sizeof(*hdr) ? size : sizeof(*hdr);
+
+    if (dolload_stream_read(s, s->pos, head + s->pos, want - s->pos))
+        return 0;
+
+    if (dolload_check(hdr, size))
+    {
+        void *arena_hi = SYS_GetArenaHi();
+        dol = dolload_load(hdr, dolload_stream_read, s, 0);
+        if (dol && !dolload_stream_skip(s, size))
+            return 1;
+        if (dol || s->pos != want)
+        {
+            drop_dol(arena_hi);
+            return 0;
+        }
+    }
+    else if (elfload_check((elf32_ehdr_t *) hdr, size))
+    {
+        void *arena_hi = SYS_GetArenaHi();
+        if (load_elf(hdr, want, size, dolload_stream_read, s) &&
+            !dolload_stream_skip(s, size))
+            return 1;
+        if (dol)
+            drop_dol(arena_hi);
+        return 0;
+    }
+
+    dol_alloc(size);
+    if (!dol)
+        return 0;
+    memcpy(dol, head, want);
+    if (dolload_stream_read(s, want, dol + want, size - want))
+    {
+        free(dol);
+        dol = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// receive the file of a framed transfer, payload containers are unpacked
+// and DOL sections placed frame by frame as they come in
+static int load_usb_framed(geckolink_t *link)
+{
+    int err = geckolink_begin(link);
+    if (err != GECKOLINK_OK)
+    {
+        kprintf("Bad transfer header (%d)\n", err);
+        geckolink_end(link);
+        return 0;
+    }
+
+    if (link->xfer.mode != GECKOLINK_MODE_BOOT)
+    {
+        kprintf("Not a boot transfer\n");
+        geckolink_end(link);
+        return 0;
+    }
+
+    u32 size = link->xfer.size;
+    kprintf("Receiving %s, %u bytes\n", link->xfer.name, size);
+
+    // the payload header is the shorter one, both start the file
+    dol_header_t hdr;
+    payload_header_t *payload = (payload_header_t *) &hdr;
+    u32 head = size < sizeof(*payload) ? size : sizeof(*payload);
+    void *arena_hi = SYS_GetArenaHi();
+    err = geckolink_read(link, &hdr, head);
+    if (err >= 0 && payload_check(payload, size))
+    {
+        if (!load_payload(payload, gecko_payload_read, link))
+            err = GECKOLINK_ERR_PROTO;
+    }
+    else if (err >= 0)
+    {
+        dolload_stream_t stream = { gecko_payload_read, link, head };
+        if (!load_dol_stream(&stream, &hdr, size))
+            err = GECKOLINK_ERR_PROTO;
+    }
+
+    // the end check runs either way, it releases the frame buffers and
+    // catches a bad CRC only after the sections were placed
+    int ended = geckolink_end(link);
+    if (err >= 0)
+        err = ended;
+    if (err != GECKOLINK_OK)
+    {
+        kprintf("Transfer failed (%d)\n", err);
+        if (dol)
+            drop_dol(arena_hi);
+        return 0;
+    }
+    return 1;
+}
 
 int load_usb(char slot)
 {
@@ -151,95 +425,215 @@ int load_usb(char slot)
         break;
     }
 
-    if (!usb_isgeckoalive(channel))
+    geckolink_t link;
+    int peer = geckolink_connect(&link, channel);
+    if (peer == GECKOLINK_ERR_ABSENT)
     {
         kprintf("Not present\n");
         res = 0;
         goto end;
     }
+    if (peer == GECKOLINK_ERR_TIMEOUT)
+    {
+        kprintf("No sender\n");
+        res = 0;
+        goto end;
+    }
 
-    usb_flush(channel);
-
-    char data;
-
-    kprintf("Sending ready\n");
-    data = GC_READY;
-    usb_sendbuffer_safe(channel, &data, 1);
-
-    kprintf("Waiting for ack...\n");
-    while ((data != PC_READY) && (data != PC_OK))
-        usb_recvbuffer_safe(channel, &data, 1);
-
-    if(data == PC_READY)
+    if (peer == GECKOLINK_FRAMED)
     {
-        kprintf("Respond with OK\n");
-        // Sometimes the PC can fail to receive the byte, this helps
-        usleep(100000);
-        data = GC_OK;
-        usb_sendbuffer_safe(channel, &data, 1);
+        res = load_usb_framed(&link);
+        goto record;
     }
 
     kprintf("Getting DOL size\n");
     int size;
-    usb_recvbuffer_safe(channel, &size, 4);
+    if (geckolink_recv(&link, &size, 4) != GECKOLINK_OK)
+    {
+        kprintf("Timed out\n");
+        res = 0;
+        goto end;
+    }
     size = convert_int(size);
-
-    dol_alloc(size);
-    unsigned char* pointer = dol;
-
-    if(!dol)
+    if (size <= 0)
     {
+        kprintf("Empty DOL\n");
         res = 0;
         goto end;
     }
 
     kprintf("Receiving file...\n");
-    while (size > 0xF7D8)
+    dol_header_t hdr;
+    dolload_stream_t stream = { gecko_recv_read, &link, 0 };
+    if (!load_dol_stream(&stream, &hdr, size))
     {
-        usb_recvbuffer_safe(channel, (void *) pointer, 0xF7D8);
-        size -= 0xF7D8;
-        pointer += 0xF7D8;
+        kprintf("Timed out\n");
+        res = 0;
+        goto end;
     }
-    if(size)
-        usb_recvbuffer_safe(channel, (void *) pointer, size);
+
+record:
+    if (res)
+        boot_record.src = channel ? BOOTPROBE_USB_B : BOOTPROBE_USB_A;
 
 end:
     return res;
 }
 
+// receive a file from geckosend.py --install into the flash
+static const char *install_usb(void)
+{
+	static char status[96];
+	char name[LFS_NAME_MAX + 1];
+	s32 channel = usb_isgeckoalive(EXI_CHANNEL_1) ? EXI_CHANNEL_1 :
+				  usb_isgeckoalive(EXI_CHANNEL_0) ? EXI_CHANNEL_0 : -1;
+
+	if (channel < 0)
+		return "No USB Gecko found";
+
+	// a whole block of cache and a lookahead over the entire chip, the
+	// caller has given its reference back so the flash can be remounted
+	lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BULK, KUNAI_STORAGE_PROFILE);
+	if (!fs)
+		return "Couldn't mount the flash";
+
+	int err = kunai_install_gecko(fs, channel, name);
+	kunai_storage_put();
+
+	if (err == KUNAI_INSTALL_OK)
+		snprintf(status, sizeof(status), "Installed %s", name);
+	else
+		snprintf(status, sizeof(status), "Install failed (%d)", err);
+	return status;
+}
+
 extern u8 __xfb[];
 
 #define MIN_INDEX 0
-#define MAX_INDEX 3
-void draw_menu(void){
-	u32 jedec_id = kunai_get_jedecID();
-	cfg.block_count = (((1 << (jedec_id & 0xFFUL)) - KUNAI_OFFS) / cfg.block_size);
-
-	int err = lfs_mount(&lfs, &cfg);
-
-	// reformat if we can't mount the filesystem
-	// this should only happen on the first boot
-	if (err) {
-		lfs_format(&lfs, &cfg);
-		lfs_mount(&lfs, &cfg);
+#define MAX_INDEX 8
+#define PREFETCH_INDEX 8
+#define PREFETCH_PATH "swiss.dol"
+
+static const char *boot_src_names[] = { "usb b", "sdb", "usb a", "sda", "sd2", "flash" };
+
+static void print_boot_times(void)
+{
+	boottime_rec_t recs[4];
+	int n = boottime_load(recs, 4);
+
+	kprintf("\n\nLast boots, ms: mount/open/read/total");
+	for (int i = 0; i < n; i++) {
+		boottime_rec_t *r = &recs[i];
+		kprintf("\n#%u %s %u/%u/%u/%u", r->seq,
+				boot_src_names[MIN(r->src, BOOTPROBE_COUNT)],
+				r->stage_us[BOOTTIME_MOUNT] / 1000, r->stage_us[BOOTTIME_OPEN] / 1000,
+				r->stage_us[BOOTTIME_READ] / 1000, r->total_us / 1000);
+		kprintf("\n   %u reads, %u sectors, max %uus", r->disk_reads,
+				r->disk_sectors, r->disk_max_us);
 	}
-	// read current count
+	if (!n)
+		kprintf("\nNone recorded, needs a KUNAI_BOOTTIME_SAVE build");
+}
+
+// a file read whole into memory, for the prefetched menu payload
+typedef struct {
+    const u8 *data;
+    u32 size;
+    u32 pos;
+} mem_file_t;
+
+static int mem_payload_read(void *ctx, void *buf, u32 len)
+{
+    mem_file_t *f = ctx;
+    len = MIN(len, f->size - f->pos);
+    memcpy(buf, f->data + f->pos, len);
+    f->pos += len;
+    return len;
+}
+
+static int mem_dol_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    mem_file_t *f = ctx;
+    if (ofs > f->size || len > f->size - ofs)
+        return -1;
+    memcpy(buf, f->data + ofs, len);
+    return 0;
+}
+
+// the same as load_lfs, but from the buffer the menu prefetched
+static int load_prefetched(u8 *data, u32 size)
+{
+    mem_file_t f = { data, size, 0 };
+    payload_header_t hdr;
+    dol_header_t dol_hdr;
+    int elf = 0;
+
+    kprintf("Booting prefetched %s\n", PREFETCH_PATH);
+
+    u64 start = gettime();
+    if (!mem_dol_read(&f, 0, &hdr, sizeof(hdr)) && payload_check(&hdr, size))
+    {
+        f.pos = sizeof(hdr);
+        load_payload(&hdr, mem_payload_read, &f);
+    }
+    else if (!mem_dol_read(&f, 0, &dol_hdr, sizeof(dol_hdr)))
+    {
+        if (dolload_check(&dol_hdr, size))
+            dol = dolload_load(&dol_hdr, mem_dol_read, &f, 0);
+        else if ((elf = elfload_check((elf32_ehdr_t *) &dol_hdr, size)))
+            load_elf(&dol_hdr, sizeof(dol_hdr), size, mem_dol_read, &f);
+
+        // nothing placed, the buffer is the whole file already
+        if (!dol && !elf)
+        {
+            dol = data;
+            data = NULL;
+        }
+    }
+    boottime_add(BOOTTIME_READ, start);
+
+    free(data);
+    return dol != NULL;
+}
+
+// returns 1 with 'dol' loaded if a payload was booted from the menu
+int draw_menu(void){
+	static kunai_scrub_t scrub;
+	static kunai_prefetch_t prefetch;
+	uint8_t *boot = NULL;
+	uint32_t boot_size = 0;
 	uint32_t boot_count = 0;
-	lfs_file_open(&lfs, &lfs_file, "boot_count", LFS_O_RDWR | LFS_O_CREAT);
-	lfs_file_read(&lfs, &lfs_file, &boot_count, sizeof(boot_count));
 
-    // update boot count
-    boot_count += 1;
-    lfs_file_rewind(&lfs, &lfs_file);
-    lfs_file_write(&lfs, &lfs_file, &boot_count, sizeof(boot_count));
+	// reformats if we can't mount the filesystem, this should only happen
+	// on the first boot and never with a geometry made up from a bad ID read
+	lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, KUNAI_STORAGE_FORMAT);
 
-    // remember the storage is not updated until the file is closed successfully
-    lfs_file_close(&lfs, &lfs_file);
+	if (fs) {
+		// read current count
+		lfs_file_open(fs, &lfs_file, "boot_count", LFS_O_RDWR | LFS_O_CREAT);
+		lfs_file_read(fs, &lfs_file, &boot_count, sizeof(boot_count));
 
-    // release any resources we were using
-    lfs_unmount(&lfs);
+		// update boot count
+		boot_count += 1;
+		lfs_file_rewind(fs, &lfs_file);
+		lfs_file_write(fs, &lfs_file, &boot_count, sizeof(boot_count));
+
+		// remember the storage is not updated until the file is closed successfully
+		lfs_file_close(fs, &lfs_file);
+
+		// stay mounted and check the stored payloads while the menu is idle
+		kunai_scrub_start(&scrub, fs, KUNAI_SCRUB_BUDGET_US);
+	} else {
+		scrub.state = KUNAI_SCRUB_IDLE;
+	}
 
 	int8_t cursor_idx = 0;
+	// passthrough keeps the EXI bus locked and selected, nothing else may
+	// touch the flash until it is disabled again
+	int passthrough = 0;
+	const char *status = "";
+	static char status_buf[64];
+	int show_times = 0;
 		ClearScreen();
 
 		writeLine(0, 0, 640, 480, COL_HIGHLIGHT);
@@ -263,34 +657,105 @@ void draw_menu(void){
 		kprintf("\tBy\t ManCloud\n"
 				"\t\t seewood\n"
 				"\t\t derKevin\n\n");
-		kprintf("SPIFlash-JEDEC ID: 0x%06X\n", kunai_get_jedecID());
+		kprintf("SPIFlash-JEDEC ID: 0x%06X\n", kunai_storage_jedec());
 
 		kprintf("\n%s Deactivate KunaiGC", cursor_idx == 0 ? "*" : "");
 		kprintf("\n%s Reactivate KunaiGC", cursor_idx == 1 ? "*" : "");
 		kprintf("\n%s Enable Passthrough", cursor_idx == 2 ? "*" : "");
 		kprintf("\n%s Disable Passthrough", cursor_idx == 3 ? "*" : "");
+		kprintf("\n%s Send EXI trace to USB Gecko", cursor_idx == 4 ? "*" : "");
+		kprintf("\n%s Show boot times", cursor_idx == 5 ? "*" : "");
+		kprintf("\n%s Install from USB Gecko", cursor_idx == 6 ? "*" : "");
+		kprintf("\n%s Apply flash check fixes (%u)", cursor_idx == 7 ? "*" : "", scrub.fix_count);
+		kprintf("\n%s Boot %s from flash", cursor_idx == PREFETCH_INDEX ? "*" : "", PREFETCH_PATH);
 
 		kprintf("\n\nPress 'B' to return.");
 
 		kprintf("\n\nKunaiGC Menu Boot Count: %u", boot_count);
+		kprintf("\n%s", status);
+		if (show_times)
+			print_boot_times();
+		if (scrub.state == KUNAI_SCRUB_DONE) {
+			kprintf("\nFlash check: %u ok, %u new, %u weak, %u bad %s",
+					scrub.files_ok, scrub.files_unsigned, scrub.files_weak,
+					scrub.files_bad, scrub.last_bad);
+		}
+
+		// read the payload ahead while the cursor rests on its entry
+		if (cursor_idx != PREFETCH_INDEX)
+			kunai_prefetch_cancel(&prefetch);
+		else if (fs && !passthrough && prefetch.state == KUNAI_PREFETCH_IDLE)
+			kunai_prefetch_start(&prefetch, fs, PREFETCH_PATH, KUNAI_PREFETCH_BUDGET_US);
 
 		PAD_ScanPads();
 		u16 currBtns = PAD_ButtonsHeld(0);
 
 		while(currBtns == PAD_ButtonsHeld(0)) {
 			PAD_ScanPads();
+			// the flash check waits until the prefetch is through
+			if (!passthrough && !kunai_prefetch_step(&prefetch))
+				kunai_scrub_step(&scrub);
 			VIDEO_WaitVSync();
 		}
 
 		if(PAD_ButtonsHeld(0) & PAD_BUTTON_A) {
 			while(PAD_ButtonsHeld(0) & PAD_BUTTON_A) PAD_ScanPads();
-			switch (cursor_idx) {
+			// the flash actions below can't run through passthrough
+			if (passthrough && (cursor_idx == 6 || cursor_idx == 7 || cursor_idx == PREFETCH_INDEX))
+				status = "Disable passthrough first";
+			else switch (cursor_idx) {
+			// the storage hold re-enables the chip for its own accesses and
+			// leaves it the way it was asked for here once it is done
 			case 0: kunai_disable(); break;
 			case 1: kunai_reenable(); break;
-			case 2: kunai_enable_passthrough(); break;
-			case 3: kunai_disable_passthrough(); break;
+			case 2:
+				if (!passthrough) {
+					kunai_enable_passthrough();
+					passthrough = 1;
+				}
+				break;
+			case 3:
+				if (passthrough) {
+					kunai_disable_passthrough();
+					passthrough = 0;
+				}
+				break;
+			case 4:
+				if (exitrace_dump_gecko(EXI_CHANNEL_1) || exitrace_dump_gecko(EXI_CHANNEL_0))
+					status = "EXI trace sent to USB Gecko";
+				else
+					status = "No USB Gecko found";
+				break;
+			case 5: show_times = !show_times; break;
+			case 6:
+				if (fs) {
+					kunai_scrub_stop(&scrub);
+					kunai_storage_put();
+				}
+				status = install_usb();
+				// the install remounted with the bulk profile, back to the menu's
+				fs = kunai_storage_get(KUNAI_LFS_PROFILE_DEFAULT, KUNAI_STORAGE_PROFILE);
+				if (fs)
+					kunai_scrub_start(&scrub, fs, KUNAI_SCRUB_BUDGET_US);
+				break;
+			case 7: {
+				// programs the flash, so only on request and never from idle time
+				int failed = kunai_scrub_apply(&scrub);
+				snprintf(status_buf, sizeof(status_buf), "%u signed, %u rewritten, %d failed",
+						 scrub.files_signed, scrub.files_rewritten, failed);
+				status = status_buf;
+				break;
+			}
+			case PREFETCH_INDEX:
+				// reads whatever the idle frames didn't get to
+				boot = kunai_prefetch_take(&prefetch, &boot_size);
+				if (!boot)
+					status = "Couldn't read " PREFETCH_PATH " from flash";
+				break;
 			default: break;
 			}
+			if (boot)
+				break;
 		}
 
 		if (PAD_ButtonsHeld(0) & PAD_BUTTON_DOWN){
@@ -313,6 +778,56 @@ void draw_menu(void){
 
 
 	}
+
+	if (passthrough)
+		kunai_disable_passthrough();
+
+	if (fs) {
+		kunai_prefetch_cancel(&prefetch);
+		kunai_scrub_stop(&scrub);
+
+		// stays mounted for load_lfs, unmounted before the handoff
+		kunai_storage_put();
+	}
+
+	return boot && load_prefetched(boot, boot_size);
+}
+
+// USB Gecko source load_last() already waited on, the chain doesn't wait on
+// it a second time
+int last_usb_tried = BOOTPROBE_COUNT;
+
+// boot from where the last boot came from, without probing the other slots
+int load_last(void)
+{
+    bootlast_t last;
+
+    if (!bootlast_load(&last) || strcmp(last.path, path) != 0)
+        return 0;
+
+    kprintf("Trying last boot source\n");
+
+    switch (last.src)
+    {
+    case BOOTPROBE_USB_B: last_usb_tried = last.src; return load_usb('B');
+    case BOOTPROBE_SD_B:  return load_fat("sdb", &__io_gcsdb, last.src, &last);
+    case BOOTPROBE_USB_A: last_usb_tried = last.src; return load_usb('A');
+    case BOOTPROBE_SD_A:  return load_fat("sda", &__io_gcsda, last.src, &last);
+    case BOOTPROBE_SD2:   return load_fat("sd2", &__io_gcsd2, last.src, &last);
+    default:              return 0;
+    }
+}
+
+static int lfs_payload_read(void *ctx, void *buf, u32 len)
+{
+    return lfs_file_read(ctx, &lfs_file, buf, len);
+}
+
+static int lfs_dol_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    if (lfs_file_seek(ctx, &lfs_file, ofs, LFS_SEEK_SET) < 0)
+        return -1;
+    return lfs_file_read(ctx, &lfs_file, buf, len) == (lfs_ssize_t) len ? 0 : -1;
 }
 
 int load_lfs(const char * filePath)
@@ -321,41 +836,65 @@ int load_lfs(const char * filePath)
 
     kprintf("Trying lfs\n");
 
-    //update block_count regarding to flash chip
-    u32 jedec_id = kunai_get_jedecID();
-    cfg.block_count = (((1 << (jedec_id & 0xFFUL)) - KUNAI_OFFS) / cfg.block_size);
-
-	int err = lfs_mount(&lfs, &cfg);
-
-    if (err != LFS_ERR_OK)
+    // already mounted if the menu ran before
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+    if (!fs)
     {
         kprintf("Couldn't mount lfs\n");
         res = 0;
         goto end;
     }
 
-    kprintf("lfs mounted\n");
-
     kprintf("Reading %s\n", filePath);
-    if (lfs_file_open(&lfs, &lfs_file, filePath, LFS_O_RDWR) != LFS_ERR_OK)
+    if (lfs_file_open(fs, &lfs_file, filePath, LFS_O_RDWR) != LFS_ERR_OK)
     {
         kprintf("Failed to open file\n");
         res = 0;
-        goto unmount;
+        goto release;
     }
 
-    size_t size = lfs_file_size(&lfs, &lfs_file);
-    dol_alloc(size);
-    if (!dol)
+    size_t size = lfs_file_size(fs, &lfs_file);
+    payload_header_t hdr;
+    if (lfs_file_read(fs, &lfs_file, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+        payload_check(&hdr, size))
     {
-        res = 0;
-        goto unmount;
+        if (!load_payload(&hdr, lfs_payload_read, fs))
+            res = 0;
     }
-    lfs_file_read(&lfs, &lfs_file, dol, size);
-    lfs_file_close(&lfs, &lfs_file);
-unmount:
-    kprintf("Unmounting lfs\n");
-    lfs_unmount(&lfs);
+    else
+    {
+        // placed like a DOL or ELF from SD
+        dol_header_t dol_hdr;
+        int elf = 0;
+        u64 start = gettime();
+        if (!lfs_dol_read(fs, 0, &dol_hdr, sizeof(dol_hdr)))
+        {
+            if (dolload_check(&dol_hdr, size))
+                dol = dolload_load(&dol_hdr, lfs_dol_read, fs, 0);
+            else if ((elf = elfload_check((elf32_ehdr_t *) &dol_hdr, size)))
+                load_elf(&dol_hdr, sizeof(dol_hdr), size, lfs_dol_read, fs);
+        }
+        boottime_add(BOOTTIME_READ, start);
+
+        if (elf && !dol)
+            res = 0;
+        else if (!dol)
+        {
+            lfs_file_rewind(fs, &lfs_file);
+            dol_alloc(size);
+            if (!dol)
+                res = 0;
+            else
+            {
+                start = gettime();
+                lfs_file_read(fs, &lfs_file, dol, size);
+                boottime_add(BOOTTIME_READ, start);
+            }
+        }
+    }
+    lfs_file_close(fs, &lfs_file);
+release:
+    kunai_storage_put();
 end:
     return res;
 }
@@ -365,6 +904,8 @@ GXRModeObj *rmode = NULL;
 int main()
 {
 main_start:
+	boottime_begin();
+
 	VIDEO_Init ();		/*** ALWAYS CALL FIRST IN ANY LIBOGC PROJECT!
 					     Not only does it initialise the video
 					     subsystem, but also sets up the ogc os
@@ -447,7 +988,11 @@ main_start:
 
 
 	if (all_buttons_held & PAD_TRIGGER_Z) {
-		draw_menu();
+		if (draw_menu()) {
+			// flash boots aren't recorded
+			boot_record.src = BOOTPROBE_COUNT;
+			goto load;
+		}
 		while(all_buttons_held) {
 
 			PAD_ScanPads();
@@ -474,19 +1019,37 @@ main_start:
 
 	kprintf("\n\nKunaiLoader - based on iplboot\n");
 
+	boot_record.src = BOOTPROBE_COUNT;
+
 	if (all_buttons_held & PAD_BUTTON_START) {
 		if (load_lfs("swiss.dol")) goto load;
 	}
 
-	if (load_usb('B')) goto load;
+	if (load_last()) goto record;
+
+	// detect all slots at once, then load from the first one present
+	bootprobe_start();
+
+	if (bootprobe_present(BOOTPROBE_USB_B) && last_usb_tried != BOOTPROBE_USB_B && load_usb('B')) goto record;
 
-	if (load_fat("sdb", &__io_gcsdb)) goto load;
+	if (bootprobe_present(BOOTPROBE_SD_B) && load_fat("sdb", &__io_gcsdb, BOOTPROBE_SD_B, NULL)) goto record;
 
-	if (load_usb('A')) goto load;
+	if (bootprobe_present(BOOTPROBE_USB_A) && last_usb_tried != BOOTPROBE_USB_A && load_usb('A')) goto record;
 
-	if (load_fat("sda", &__io_gcsda)) goto load;
+	if (bootprobe_present(BOOTPROBE_SD_A) && load_fat("sda", &__io_gcsda, BOOTPROBE_SD_A, NULL)) goto record;
 
-	if (load_fat("sd2", &__io_gcsd2)) goto load;
+	if (bootprobe_present(BOOTPROBE_SD2) && load_fat("sd2", &__io_gcsd2, BOOTPROBE_SD2, NULL)) goto record;
+
+	record:
+	// shuts down the cards the probe started and nobody used
+	bootprobe_finish();
+
+	if (dol && boot_record.src < BOOTPROBE_COUNT)
+	{
+		boot_record.magic = BOOTLAST_MAGIC;
+		strncpy(boot_record.path, path, BOOTLAST_PATH_MAX - 1);
+		bootlast_store(&boot_record);
+	}
 
 	load:
 	// Wait to exit while the d-pad down direction is held.
@@ -504,9 +1067,16 @@ main_start:
 
 	if (dol)
 	{
+		u64 start = gettime();
 		memcpy((void *) STUB_ADDR, stub, stub_size);
 		DCStoreRange((void *) STUB_ADDR, stub_size);
+		boottime_add(BOOTTIME_HANDOFF, start);
+
+		// boot_record.src is still BOOTPROBE_COUNT for flash boots,
+		// only saved in KUNAI_BOOTTIME_SAVE builds
+		boottime_finish(boot_record.src);
 
+		kunai_storage_shutdown();
 		SYS_ResetSystem(SYS_SHUTDOWN, 0, FALSE);
 		SYS_SwitchFiber((intptr_t) dol, 0,
 				(intptr_t) NULL, 0,
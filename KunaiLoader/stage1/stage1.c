@@ -0,0 +1,247 @@
+/*
+ * stage1.c
+ *
+ * No libogc and no C library are linked, the EXI registers of channel 0 are
+ * driven directly. The flash is selected once and read front to back: the
+ * payload header, then every chunk's length and data. Whole cache lines go
+ * by DMA, the rest by immediate transfers. The DMA of an LZ4 chunk runs
+ * while the chunk before it is decoded, into the other chunk buffer.
+ */
+
+#include <string.h>
+
+#include "stage1.h"
+#include "payload/payload.h"
+#include "payload/lz4block.h"
+#include "spiflash/spiflash.h"
+#include "stub/stub.h"
+#include "lfs/lfs_util.h"
+
+#define EXI_REG		((volatile u32 *) 0xCC006800)
+#define EXI_CSR		0
+#define EXI_MAR		1
+#define EXI_LEN		2
+#define EXI_CR		3
+#define EXI_DATA	4
+
+#define EXI_CSR_KEEP	0x405	// interrupt masks, kept like libogc does
+#define EXI_CSR_DEV1	0x100
+#define EXI_CSR_ROMDIS	0x2000	// flash reads bypass the descrambler
+#define EXI_CLK_8MHZ	3
+#define EXI_CLK_32MHZ	5
+
+#define EXI_CR_TSTART	1
+#define EXI_CR_DMA	2
+#define EXI_CR_READ	(0 << 2)
+#define EXI_CR_WRITE	(1 << 2)
+
+#define PI_RESET	((volatile u32 *) 0xCC003024)
+
+void stage1_jump(void *dol, u32 stub, u32 stack) __attribute__((noreturn));
+
+static u8 chunks[2][PAYLOAD_CHUNK_MAX] ATTRIBUTE_ALIGN(32);
+
+// the LZ4 decoder's copies
+void *memcpy(void *dst, const void *src, size_t n) {
+    u8 *d = dst;
+    const u8 *s = src;
+    while (n--)
+        *d++ = *s++;
+    return dst;
+}
+
+static void exi_select(int clk) {
+    EXI_REG[EXI_CSR] = (EXI_REG[EXI_CSR] & EXI_CSR_KEEP) | EXI_CSR_ROMDIS |
+                       EXI_CSR_DEV1 | clk << 4;
+}
+
+static void exi_deselect(void) {
+    EXI_REG[EXI_CSR] = (EXI_REG[EXI_CSR] & EXI_CSR_KEEP) | EXI_CSR_ROMDIS;
+}
+
+// up to 4 bytes, left aligned like libogc's EXI_Imm
+static u32 exi_imm(u32 data, u32 len, u32 rw) {
+    EXI_REG[EXI_DATA] = data;
+    EXI_REG[EXI_CR] = (len - 1) << 4 | rw | EXI_CR_TSTART;
+    while (EXI_REG[EXI_CR] & EXI_CR_TSTART);
+    return EXI_REG[EXI_DATA];
+}
+
+// whole cache lines, the DMA writes behind the data cache. Only started,
+// the CPU is free until exi_dma_wait().
+static void exi_dma_start(u8 *buf, u32 len) {
+    for (u32 i = 0; i < len; i += 32)
+        asm volatile("dcbi 0, %0" : : "r" (buf + i) : "memory");
+    asm volatile("sync");
+
+    EXI_REG[EXI_MAR] = (u32) buf & 0x03FFFFE0;
+    EXI_REG[EXI_LEN] = len;
+    EXI_REG[EXI_CR] = EXI_CR_DMA | EXI_CR_READ | EXI_CR_TSTART;
+}
+
+static void exi_dma_wait(void) {
+    while (EXI_REG[EXI_CR] & EXI_CR_TSTART);
+}
+
+static void flash_read_imm(u8 *p, u32 len) {
+    u32 val = exi_imm(0, len, EXI_CR_READ);
+    for (u32 i = 0; i < len; i++)
+        p[i] = val >> (24 - 8 * i);
+}
+
+// the bytes after the DMA of flash_read_start()
+static u8 *tail;
+static u32 tail_len;
+
+// Like spiflash_read_bulk(), but returns with the DMA still running.
+// Nothing else may go over EXI before flash_read_end().
+static void flash_read_start(void *buf, u32 size) {
+    u8 *p = buf;
+    u32 head = (-(u32) p) & 31;
+    u32 len;
+
+    if (head > size)
+        head = size;
+    size -= head;
+    for (; head; head -= len, p += len) {
+        len = head < 4 ? head : 4;
+        flash_read_imm(p, len);
+    }
+
+    len = size & ~31;
+    if (len)
+        exi_dma_start(p, len);
+    tail = p + len;
+    tail_len = size - len;
+}
+
+static void flash_read_end(void) {
+    u32 len;
+
+    exi_dma_wait();
+    for (; tail_len; tail_len -= len, tail += len) {
+        len = tail_len < 4 ? tail_len : 4;
+        flash_read_imm(tail, len);
+    }
+}
+
+static void flash_read(void *buf, u32 size) {
+    flash_read_start(buf, size);
+    flash_read_end();
+}
+
+// a KunaiGC command, 1 << 24 enables it like kunai_reenable(), 6 << 24
+// disables it like kunai_disable()
+static void kunai_cmd(u32 data) {
+    exi_select(EXI_CLK_8MHZ);
+    exi_imm(0xC0000000, 4, EXI_CR_WRITE);
+    exi_imm(data, 4, EXI_CR_WRITE);
+    exi_deselect();
+}
+
+// a fast read goes on for as long as the flash stays selected
+static void flash_open(u32 addr) {
+    // enabled like kunai_hold() does before every flash access
+    kunai_cmd(1 << 24);
+
+    exi_select(EXI_CLK_32MHZ);
+    exi_imm(0x80000000, 4, EXI_CR_WRITE);	// passthrough, see kunai_enable_passthrough()
+    exi_imm((u32) W25Q80BV_CMD_READ_FAST << 24 | addr, 4, EXI_CR_WRITE);
+    exi_imm(0, 1, EXI_CR_READ);
+}
+
+static int read_stage2(u8 *dst) {
+    payload_header_t hdr;
+    u32 crc = 0xFFFFFFFF;
+    u32 pos = 0;
+
+    flash_read(&hdr, sizeof(hdr));
+    if (hdr.magic != PAYLOAD_MAGIC || hdr.version != PAYLOAD_VERSION ||
+        !hdr.raw_size || hdr.raw_size > STAGE2_RAW_MAX)
+        return -1;
+
+    if (hdr.codec == PAYLOAD_CODEC_STORED) {
+        flash_read(dst, hdr.raw_size);
+        crc = lfs_crc(crc, dst, hdr.raw_size);
+    } else if (hdr.codec == PAYLOAD_CODEC_LZ4 && hdr.chunk_size &&
+               hdr.chunk_size <= PAYLOAD_CHUNK_MAX) {
+        // the chunk read in full and not decoded yet, and where it goes
+        u8 *in = NULL;
+        u32 in_len = 0, in_pos = 0, in_out = 0;
+        int next = 0;
+
+        for (;;) {
+            u32 out_len = hdr.raw_size - pos < hdr.chunk_size ? hdr.raw_size - pos : hdr.chunk_size;
+            u32 len = 0;
+
+            // start reading the next chunk
+            if (pos < hdr.raw_size) {
+                flash_read(&len, sizeof(len));
+                if (len & PAYLOAD_CHUNK_STORED) {
+                    if ((len & ~PAYLOAD_CHUNK_STORED) != out_len)
+                        return -1;
+                } else {
+                    if (len > hdr.chunk_size)
+                        return -1;
+                    flash_read_start(chunks[next], len);
+                }
+            }
+
+            // and decode the one before while it comes in
+            if (in) {
+                if (lz4_decode_block(in, in_len, dst, dst + in_pos, dst + in_pos + in_out) != PAYLOAD_OK) {
+                    flash_read_end();
+                    return -1;
+                }
+                // while the chunk is still in the data cache
+                crc = lfs_crc(crc, dst + in_pos, in_out);
+                in = NULL;
+            }
+
+            if (pos >= hdr.raw_size)
+                break;
+
+            if (len & PAYLOAD_CHUNK_STORED) {
+                flash_read(dst + pos, out_len);
+                crc = lfs_crc(crc, dst + pos, out_len);
+            } else {
+                flash_read_end();
+                in = chunks[next];
+                in_len = len;
+                in_pos = pos;
+                in_out = out_len;
+                next ^= 1;
+            }
+            pos += out_len;
+        }
+    } else {
+        return -1;
+    }
+
+    return ~crc == hdr.raw_crc ? 0 : -1;
+}
+
+void stage1_main(void) {
+    u8 *dol = (u8 *) STAGE2_DOL_ADDR;
+    int err;
+
+    flash_open(STAGE2_FLASH_OFFS);
+    err = read_stage2(dol);
+    exi_deselect();
+
+    if (err) {
+        // with the KunaiGC off the reset ends up in the Nintendo IPL, like
+        // when the loader finds nothing to boot
+        kunai_cmd(6 << 24);
+        *PI_RESET = 3;
+        *PI_RESET = 0;
+        for (;;);
+    }
+
+    memcpy((void *) STUB_ADDR, stub, stub_size);
+    for (int i = 0; i < stub_size; i += 32)
+        asm volatile("dcbst 0, %0; sync; icbi 0, %0" : : "r" (STUB_ADDR + i) : "memory");
+    asm volatile("sync; isync");
+
+    stage1_jump(dol, STUB_ADDR, STUB_STACK);
+}
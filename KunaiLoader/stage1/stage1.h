@@ -0,0 +1,33 @@
+/*
+ * stage1.h
+ *
+ * Two-stage boot. The bootrom reads the IPL through the descrambler, slowly,
+ * so instead of the whole loader it only gets stage 1: at most 14K (checked
+ * by stage1.ld) that select the flash over passthrough and read the loader
+ * (stage 2), packed by kpack.py, with EXI DMA from a fixed offset. Stage 2
+ * is unpacked, checked against its CRC and handed to the stub like any other
+ * DOL. If it doesn't check out the KunaiGC is switched off and the console
+ * reset into the Nintendo IPL.
+ *
+ * Flash layout, buildtools/dol2ipl.py writes the part from 0x800 on:
+ *
+ *   0x00800  stage 1, as a .vgc
+ *   0x04000  stage 2, a payload container (source/payload/payload.h)
+ *   0x40000  LittleFS (KUNAI_OFFS)
+ */
+
+#ifndef STAGE1_H_
+#define STAGE1_H_
+
+#define STAGE2_FLASH_OFFS	0x4000
+#define STAGE2_FLASH_END	(256 * 1024)
+
+// stage 2 is unpacked here, the stub moves it to its load address
+#define STAGE2_DOL_ADDR		0x80100000
+#define STAGE2_RAW_MAX		(16 * 1024 * 1024)
+
+// as in the loader
+#define STUB_ADDR		0x80001000
+#define STUB_STACK		0x80003000
+
+#endif /* STAGE1_H_ */
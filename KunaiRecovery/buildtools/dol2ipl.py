@@ -4,6 +4,11 @@ import math
 import struct
 import sys
 
+# two-stage boot flash layout, see KunaiLoader/stage1/stage1.h
+STAGE1_FLASH_OFFS = 0x800
+STAGE2_FLASH_OFFS = 0x4000
+STAGE2_FLASH_END = 256 * 1024
+
 # bootrom descrambler reversed by segher
 def scramble(data, *, qoobsx=False):
     acc = 0
@@ -76,9 +81,18 @@ def flatten_dol(data):
     # Entry point, load address, memory image
     return header[56], dol_min, img
 
+def viper_image(entry, load, img):
+    if entry != 0x81300000 or load != 0x01300000:
+        print("Invalid entry point and base address (must be 0x81300000)")
+        return None
+
+    header = b"KUNAIGC\x00\x02".ljust(16, b"\x00") + b"KunaiRecovery".ljust(16, b"\x00")
+    return header + scramble(bytearray(0x720) + img)[0x720:]
+
 def main():
-    if len(sys.argv) != 4:
-        print(f"Usage: {sys.argv[0]} <original IPL> <executable> <output>")
+    if len(sys.argv) not in (4, 5):
+        print(f"Usage: {sys.argv[0]} <original IPL> <executable> <output> [stage 2]")
+        return -1
 
     with open(sys.argv[1], "rb") as f:
         ipl = bytearray(f.read())
@@ -128,12 +142,37 @@ def main():
         out += bytearray(npages * 0x10000 - len(out))
 
     elif sys.argv[3].endswith(".vgc"):
-        if entry != 0x81300000 or load != 0x01300000:
-            print("Invalid entry point and base address (must be 0x81300000)")
+        out = viper_image(entry, load, img)
+        if out is None:
+            return -1
+
+    elif sys.argv[3].endswith(".bin"):
+        # Two-stage boot, flashed at STAGE1_FLASH_OFFS: the executable is
+        # stage 1 and packed like a .vgc, the packed loader follows at the
+        # offset stage 1 reads it from
+        if len(sys.argv) != 5:
+            print("A two-stage image needs the packed stage 2")
+            return -1
+
+        out = viper_image(entry, load, img)
+        if out is None:
+            return -1
+
+        with open(sys.argv[4], "rb") as f:
+            stage2 = f.read()
+
+        print(f"Stage 1:       {len(out)} bytes")
+        print(f"Stage 2:       {len(stage2)} bytes at 0x{STAGE2_FLASH_OFFS:X}")
+
+        if len(out) > STAGE2_FLASH_OFFS - STAGE1_FLASH_OFFS:
+            print("Stage 1 too big")
+            return -1
+        if len(stage2) > STAGE2_FLASH_END - STAGE2_FLASH_OFFS:
+            print("Stage 2 too big")
             return -1
 
-        header = b"KUNAIGC\x00\x02".ljust(16, b"\x00") + b"KunaiRecovery".ljust(16, b"\x00")
-        out = header + scramble(bytearray(0x720) + img)[0x720:]
+        # erased flash in between
+        out = out.ljust(STAGE2_FLASH_OFFS - STAGE1_FLASH_OFFS, b"\xFF") + stage2
 
     elif sys.argv[3].endswith(".qbsx"):
         header = bytearray(b"iplboot".ljust(256, b"\x00"))
@@ -3,6 +3,7 @@
 #include "ffshim.h"
 
 const DISC_INTERFACE *iface = NULL;
+int iface_started;
 
 DSTATUS disk_status(BYTE pdrv)
 {
@@ -20,10 +21,15 @@ DSTATUS disk_initialize(BYTE pdrv)
 {
     (void) pdrv;
 
+    sectorcache_flush();
+
+    int started = iface_started;
+    iface_started = 0;
+
     if (iface == NULL)
         goto noinit;
 
-    if (!iface->startup())
+    if (!started && !iface->startup())
         goto noinit;
 
     if (!iface->isInserted())
@@ -45,7 +51,7 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
     if (iface == NULL)
         return RES_NOTRDY;
 
-    if (iface->readSectors(sector, count, buff))
+    if (sectorcache_read(iface, sector, count, buff))
         return RES_OK;
     else
         return RES_ERROR;
@@ -1,14 +0,0 @@
-/*
-  This file was autogenerated by raw2c.
-Visit http://www.devkitpro.org
-*/
-
-//---------------------------------------------------------------------------------
-#ifndef _stub_h_
-#define _stub_h_
-//---------------------------------------------------------------------------------
-extern const unsigned char stub[];
-extern const int stub_size;
-//---------------------------------------------------------------------------------
-#endif //_stub_h_
-//---------------------------------------------------------------------------------
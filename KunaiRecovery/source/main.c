@@ -9,8 +9,14 @@
 #include <ogc/system.h>
 #include "etc/ffshim.h"
 #include "fatfs/ff.h"
-
-#include "etc/stub.h"
+#include "fatboot/fatboot.h"
+#include "payload/payload.h"
+#include "dolload/dolload.h"
+#include "elfload/elfload.h"
+#include "geckolink/geckolink.h"
+#include "bootprobe/bootprobe.h"
+
+#include "stub/stub.h"
 #define STUB_ADDR  0x80001000
 #define STUB_STACK 0x80003000
 
@@ -22,14 +28,13 @@ u32 retraceCount;
 #include "gfx/gfx.h"
 #include "spiflash/spiflash.h"
 #include "kunaigc/kunaigc.h"
+#include "kunaigc/kunaistorage.h"
 #define KUNAI_VERSION "1.0"
 
 u8 *dol = NULL;
 char *path = "KUNAIGC/recovery.dol";
 
-extern lfs_t lfs;
 extern lfs_file_t lfs_file;
-extern struct lfs_config cfg;
 
 void dol_alloc(int size)
 {
@@ -44,7 +49,8 @@ void dol_alloc(int size)
         return;
     }
 
-    dol = (u8 *) memalign(32, size);
+    // whole sectors, fatboot_read reads the last one straight into it
+    dol = (u8 *) memalign(32, FATBOOT_BUF_SIZE(size));
 
     if (!dol)
     {
@@ -52,6 +58,53 @@ void dol_alloc(int size)
     }
 }
 
+// decode a payload container into a freshly allocated dol
+int load_payload(const payload_header_t *hdr, payload_read_fn read, void *ctx)
+{
+    kprintf("Payload is %s, %u bytes unpacked\n", payload_codec_name(hdr->codec),
+            hdr->raw_size);
+
+    dol_alloc(hdr->raw_size);
+    if (!dol)
+        return 0;
+
+    int err = payload_load(hdr, read, ctx, dol);
+    if (err != PAYLOAD_OK)
+    {
+        kprintf("Failed to unpack payload (%d)\n", err);
+        free(dol);
+        dol = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// an ELF is placed like a DOL, there is no reading it whole instead
+static int load_elf(const dol_header_t *head, u32 head_len, u32 size,
+                    dolload_read_fn read, void *ctx)
+{
+    int err;
+
+    kprintf("Loading ELF\n");
+    dol = elfload_load(head, head_len, size, read, ctx, &err);
+    if (!dol)
+        kprintf("Failed to load ELF (%d)\n", err);
+    return dol != NULL;
+}
+
+static int fat_payload_read(void *ctx, void *buf, u32 len)
+{
+    UINT got;
+    if (f_read(ctx, buf, len, &got) != FR_OK)
+        return -1;
+    return got;
+}
+
+static int fat_dol_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    return fatboot_pread(ctx, ofs, buf, len) == FR_OK ? 0 : -1;
+}
+
 int load_fat(const char *slot_name, const DISC_INTERFACE *iface_)
 {
     int res = 1;
@@ -60,6 +113,8 @@ int load_fat(const char *slot_name, const DISC_INTERFACE *iface_)
 
     FATFS fs;
     iface = iface_;
+    // a card the probe found is still up, it isn't initialised again
+    iface_started = bootprobe_take(iface_);
     if (f_mount(&fs, "", 1) != FR_OK)
     {
         kprintf("Couldn't mount %s\n", slot_name);
@@ -81,14 +136,57 @@ int load_fat(const char *slot_name, const DISC_INTERFACE *iface_)
     }
 
     size_t size = f_size(&file);
-    dol_alloc(size);
+    payload_header_t hdr;
+    UINT got;
+    if (f_read(&file, &hdr, sizeof(hdr), &got) == FR_OK && got == sizeof(hdr) &&
+        payload_check(&hdr, size))
+    {
+        if (!load_payload(&hdr, fat_payload_read, &file))
+        {
+            f_close(&file);
+            res = 0;
+            goto unmount;
+        }
+    }
+    else
+    {
+        // a plain DOL or ELF, sections that land in free memory are read
+        // straight to their address, the rest is staged for the stub. There
+        // is no copy left to overlap with the next read (fatbench: dol_us
+        // is within 0.2% of one fatboot_read of the file), and libogc's SD
+        // driver waits out every DMA in EXI_Sync anyway.
+        dol_header_t dol_hdr;
+        int elf = 0;
+        fatboot_map(&file);
+        if (fatboot_pread(&file, 0, &dol_hdr, sizeof(dol_hdr)) == FR_OK)
+        {
+            if (dolload_check(&dol_hdr, size))
+                dol = dolload_load(&dol_hdr, fat_dol_read, &file, 0);
+            else if ((elf = elfload_check((elf32_ehdr_t *) &dol_hdr, size)))
+                load_elf(&dol_hdr, sizeof(dol_hdr), size, fat_dol_read, &file);
+        }
+        if (elf && !dol)
+        {
+            f_close(&file);
+            res = 0;
+            goto unmount;
+        }
+    }
     if (!dol)
     {
-        res = 0;
-        goto unmount;
+        // not a DOL or it doesn't split, read it in one go
+        f_lseek(&file, 0);
+        dol_alloc(size);
+        if (!dol)
+        {
+            res = 0;
+            goto unmount;
+        }
+        fatboot_read(&file, dol, size);
     }
-    UINT _;
-    f_read(&file, dol, size, &_);
+    kprintf("Sector cache: %u hits, %u misses, %u bypassed\n",
+            sectorcache_stats.hits, sectorcache_stats.misses,
+            sectorcache_stats.bypassed);
     f_close(&file);
 
 unmount:
@@ -112,10 +210,133 @@ unsigned int convert_int(unsigned int in)
     return out;
 }
 
-#define PC_READY 0x80
-#define PC_OK    0x81
-#define GC_READY 0x88
-#define GC_OK    0x89
+static int gecko_payload_read(void *ctx, void *buf, u32 len)
+{
+    geckolink_t *link = ctx;
+    u32 left = link->xfer.size - link->done;
+    if (len > left)
+        len = left;
+    return len ? geckolink_read(link, buf, len) : 0;
+}
+
+static int gecko_recv_read(void *ctx, void *buf, u32 len)
+{
+    return geckolink_recv(ctx, buf, len) == GECKOLINK_OK ? (int) len : -1;
+}
+
+// Undo a load that failed a later check. A placed DOL isn't on the heap,
+// giving the arena back is all there is to free.
+static void drop_dol(void *arena_hi)
+{
+    if (SYS_GetArenaHi() != arena_hi)
+        SYS_SetArenaHi(arena_hi);
+    else
+        free(dol);
+    dol = NULL;
+}
+
+// Load a DOL or ELF of 'size' bytes from a stream, the first s->pos bytes of it
+// are already in 'hdr'. Sections are placed as they come in and the rest of
+// the file is read and dropped. A DOL that doesn't split is read whole, as
+// long as nothing past the header was consumed yet.
+static int load_dol_stream(dolload_stream_t *s, dol_header_t *hdr, u32 size)
+{
+    u8 *head = (u8 *) hdr;
+    u32 want = size < sizeof(*hdr) ? size : sizeof(*hdr);
+
+    if (dolload_stream_read(s, s->pos, head + s->pos, want - s->pos))
+        return 0;
+
+    if (dolload_check(hdr, size))
+    {
+        void *arena_hi = SYS_GetArenaHi();
+        dol = dolload_load(hdr, dolload_stream_read, s, 0);
+        if (dol && !dolload_stream_skip(s, size))
+            return 1;
+        if (dol || s->pos != want)
+        {
+            drop_dol(arena_hi);
+            return 0;
+        }
+    }
+    else if (elfload_check((elf32_ehdr_t *) hdr, size))
+    {
+        void *arena_hi = SYS_GetArenaHi();
+        if (load_elf(hdr, want, size, dolload_stream_read, s) &&
+            !dolload_stream_skip(s, size))
+            return 1;
+        if (dol)
+            drop_dol(arena_hi);
+        return 0;
+    }
+
+    dol_alloc(size);
+    if (!dol)
+        return 0;
+    memcpy(dol, head, want);
+    if (dolload_stream_read(s, want, dol + want, size - want))
+    {
+        free(dol);
+        dol = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// receive the file of a framed transfer, payload containers are unpacked
+// and DOL sections placed frame by frame as they come in
+static int load_usb_framed(geckolink_t *link)
+{
+    int err = geckolink_begin(link);
+    if (err != GECKOLINK_OK)
+    {
+        kprintf("Bad transfer header (%d)\n", err);
+        geckolink_end(link);
+        return 0;
+    }
+
+    if (link->xfer.mode != GECKOLINK_MODE_BOOT)
+    {
+        kprintf("Not a boot transfer\n");
+        geckolink_end(link);
+        return 0;
+    }
+
+    u32 size = link->xfer.size;
+    kprintf("Receiving %s, %u bytes\n", link->xfer.name, size);
+
+    // the payload header is the shorter one, both start the file
+    dol_header_t hdr;
+    payload_header_t *payload = (payload_header_t *) &hdr;
+    u32 head = size < sizeof(*payload) ? size : sizeof(*payload);
+    void *arena_hi = SYS_GetArenaHi();
+    err = geckolink_read(link, &hdr, head);
+    if (err >= 0 && payload_check(payload, size))
+    {
+        if (!load_payload(payload, gecko_payload_read, link))
+            err = GECKOLINK_ERR_PROTO;
+    }
+    else if (err >= 0)
+    {
+        dolload_stream_t stream = { gecko_payload_read, link, head };
+        if (!load_dol_stream(&stream, &hdr, size))
+            err = GECKOLINK_ERR_PROTO;
+    }
+
+    // the end check runs either way, it releases the frame buffers and
+    // catches a bad CRC only after the sections were placed
+    int ended = geckolink_end(link);
+    if (err >= 0)
+        err = ended;
+    if (err != GECKOLINK_OK)
+    {
+        kprintf("Transfer failed (%d)\n", err);
+        if (dol)
+            drop_dol(arena_hi);
+        return 0;
+    }
+    return 1;
+}
 
 int load_usb(char slot)
 {
@@ -135,103 +356,128 @@ int load_usb(char slot)
         break;
     }
 
-    if (!usb_isgeckoalive(channel))
+    geckolink_t link;
+    int peer = geckolink_connect(&link, channel);
+    if (peer == GECKOLINK_ERR_ABSENT)
     {
         kprintf("Not present\n");
         res = 0;
         goto end;
     }
+    if (peer == GECKOLINK_ERR_TIMEOUT)
+    {
+        kprintf("No sender\n");
+        res = 0;
+        goto end;
+    }
 
-    usb_flush(channel);
-
-    char data;
-
-    kprintf("Sending ready\n");
-    data = GC_READY;
-    usb_sendbuffer_safe(channel, &data, 1);
-
-    kprintf("Waiting for ack...\n");
-    while ((data != PC_READY) && (data != PC_OK))
-        usb_recvbuffer_safe(channel, &data, 1);
-
-    if(data == PC_READY)
+    if (peer == GECKOLINK_FRAMED)
     {
-        kprintf("Respond with OK\n");
-        // Sometimes the PC can fail to receive the byte, this helps
-        usleep(100000);
-        data = GC_OK;
-        usb_sendbuffer_safe(channel, &data, 1);
+        res = load_usb_framed(&link);
+        goto end;
     }
 
     kprintf("Getting DOL size\n");
     int size;
-    usb_recvbuffer_safe(channel, &size, 4);
+    if (geckolink_recv(&link, &size, 4) != GECKOLINK_OK)
+    {
+        kprintf("Timed out\n");
+        res = 0;
+        goto end;
+    }
     size = convert_int(size);
-
-    dol_alloc(size);
-    unsigned char* pointer = dol;
-
-    if(!dol)
+    if (size <= 0)
     {
+        kprintf("Empty DOL\n");
         res = 0;
         goto end;
     }
 
     kprintf("Receiving file...\n");
-    while (size > 0xF7D8)
+    dol_header_t hdr;
+    dolload_stream_t stream = { gecko_recv_read, &link, 0 };
+    if (!load_dol_stream(&stream, &hdr, size))
     {
-        usb_recvbuffer_safe(channel, (void *) pointer, 0xF7D8);
-        size -= 0xF7D8;
-        pointer += 0xF7D8;
+        kprintf("Timed out\n");
+        res = 0;
+        goto end;
     }
-    if(size)
-        usb_recvbuffer_safe(channel, (void *) pointer, size);
 
 end:
     return res;
 }
 
+static int lfs_payload_read(void *ctx, void *buf, u32 len)
+{
+    return lfs_file_read(ctx, &lfs_file, buf, len);
+}
+
+static int lfs_dol_read(void *ctx, u32 ofs, void *buf, u32 len)
+{
+    if (lfs_file_seek(ctx, &lfs_file, ofs, LFS_SEEK_SET) < 0)
+        return -1;
+    return lfs_file_read(ctx, &lfs_file, buf, len) == (lfs_ssize_t) len ? 0 : -1;
+}
+
 int load_lfs(const char * filePath)
 {
     int res = 1;
 
     kprintf("Trying lfs\n");
 
-    //update block_count regarding to flash chip
-    u32 jedec_id = kunai_get_jedecID();
-    cfg.block_count = (((1 << (jedec_id & 0xFFUL)) - KUNAI_OFFS) / cfg.block_size);
-
-	int err = lfs_mount(&lfs, &cfg);
-
-    if (err != LFS_ERR_OK)
+    // mounted on first use, stays mounted until the handoff
+    lfs_t *fs = kunai_storage_get(KUNAI_LFS_PROFILE_BOOT, 0);
+    if (!fs)
     {
         kprintf("Couldn't mount lfs\n");
         res = 0;
         goto end;
     }
 
-    kprintf("lfs mounted\n");
-
     kprintf("Reading %s\n", filePath);
-    if (lfs_file_open(&lfs, &lfs_file, filePath, LFS_O_RDWR) != LFS_ERR_OK)
+    if (lfs_file_open(fs, &lfs_file, filePath, LFS_O_RDWR) != LFS_ERR_OK)
     {
         kprintf("Failed to open file\n");
         res = 0;
-        goto unmount;
+        goto release;
     }
 
-    size_t size = lfs_file_size(&lfs, &lfs_file);
-    dol_alloc(size);
-    if (!dol)
+    size_t size = lfs_file_size(fs, &lfs_file);
+    payload_header_t hdr;
+    if (lfs_file_read(fs, &lfs_file, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+        payload_check(&hdr, size))
     {
-        res = 0;
-        goto unmount;
+        if (!load_payload(&hdr, lfs_payload_read, fs))
+            res = 0;
     }
-    lfs_file_read(&lfs, &lfs_file, dol, size);
-    lfs_file_close(&lfs, &lfs_file);
-unmount:
-    kprintf("Unmounting lfs\n");
-    lfs_unmount(&lfs);
+    else
+    {
+        // placed like a DOL or ELF from SD
+        dol_header_t dol_hdr;
+        int elf = 0;
+        if (!lfs_dol_read(fs, 0, &dol_hdr, sizeof(dol_hdr)))
+        {
+            if (dolload_check(&dol_hdr, size))
+                dol = dolload_load(&dol_hdr, lfs_dol_read, fs, 0);
+            else if ((elf = elfload_check((elf32_ehdr_t *) &dol_hdr, size)))
+                load_elf(&dol_hdr, sizeof(dol_hdr), size, lfs_dol_read, fs);
+        }
+
+        if (elf && !dol)
+            res = 0;
+        else if (!dol)
+        {
+            lfs_file_rewind(fs, &lfs_file);
+            dol_alloc(size);
+            if (!dol)
+                res = 0;
+            else
+                lfs_file_read(fs, &lfs_file, dol, size);
+        }
+    }
+    lfs_file_close(fs, &lfs_file);
+release:
+    kunai_storage_put();
 end:
     return res;
 }
@@ -333,20 +579,26 @@ int main()
 
 	if (all_buttons_held & PAD_TRIGGER_Z) {
 
-		if (load_usb('B')) goto load;
+		// detect all slots at once, then load from the first one present
+		bootprobe_start();
+
+		if (bootprobe_present(BOOTPROBE_USB_B) && load_usb('B')) goto load;
 
-		if (load_fat("sdb", &__io_gcsdb)) goto load;
+		if (bootprobe_present(BOOTPROBE_SD_B) && load_fat("sdb", &__io_gcsdb)) goto load;
 
-		if (load_usb('A')) goto load;
+		if (bootprobe_present(BOOTPROBE_USB_A) && load_usb('A')) goto load;
 
-		if (load_fat("sda", &__io_gcsda)) goto load;
+		if (bootprobe_present(BOOTPROBE_SD_A) && load_fat("sda", &__io_gcsda)) goto load;
 
-		if (load_fat("sd2", &__io_gcsd2)) goto load;
+		if (bootprobe_present(BOOTPROBE_SD2) && load_fat("sd2", &__io_gcsd2)) goto load;
 	}
 
 	if (load_lfs("KunaiLoader.dol")) goto load;
 
 	load:
+	// shuts down the cards the probe started and nobody used
+	bootprobe_finish();
+
 	// Wait to exit while the d-pad down direction is held.
 	while ((all_buttons_held & PAD_BUTTON_DOWN))
 	{
@@ -365,6 +617,7 @@ int main()
 		memcpy((void *) STUB_ADDR, stub, stub_size);
 		DCStoreRange((void *) STUB_ADDR, stub_size);
 
+		kunai_storage_shutdown();
 		SYS_ResetSystem(SYS_SHUTDOWN, 0, FALSE);
 		SYS_SwitchFiber((intptr_t) dol, 0,
 				(intptr_t) NULL, 0,